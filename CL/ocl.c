@@ -141,6 +141,44 @@ static ocl_program_t ocl_compile_program(ocl_context_t* c,
     return (ocl_program_t)p;
 }
 
+// Returns null instead of failing when driver rejects the binary
+// (e.g. it was produced by different driver version or is corrupted).
+
+static ocl_program_t ocl_load_program(ocl_context_t* c,
+        const void* binary, size_t bytes, const char* options) {
+    cl_device_id device_id = (cl_device_id)ocl.devices[c->ix].id;
+    const unsigned char* data = (const unsigned char*)binary;
+    cl_int status = 0;
+    cl_int r = 0;
+    cl_program p = clCreateProgramWithBinary(c->c, 1, &device_id, &bytes,
+        &data, &status, &r);
+    if (p != null && (r != 0 || status != 0)) {
+        call(clReleaseProgram(p));
+        p = null;
+    }
+    if (p != null) {
+        r = clBuildProgram(p, 1, &device_id, options, null, null);
+        if (r != 0) {
+            call(clReleaseProgram(p));
+            p = null;
+        }
+    }
+    return (ocl_program_t)p;
+}
+
+static size_t ocl_program_binary(ocl_program_t p, void* binary, size_t bytes) {
+    size_t size = 0; // program is built for exactly one device
+    call(clGetProgramInfo((cl_program)p, CL_PROGRAM_BINARY_SIZES,
+        sizeof(size), &size, null));
+    if (binary != null) {
+        fatal_if(bytes < size, "bytes: %lld < %lld", (int64_t)bytes, (int64_t)size);
+        unsigned char* data = (unsigned char*)binary;
+        call(clGetProgramInfo((cl_program)p, CL_PROGRAM_BINARIES,
+            sizeof(data), &data, null));
+    }
+    return size;
+}
+
 static void ocl_release_program(ocl_program_t p) {
     call(clReleaseProgram((cl_program)p));
 }
@@ -224,6 +262,37 @@ static void ocl_wait(ocl_event_t* events, int count) {
     call(clWaitForEvents(count, (cl_event*)events));
 }
 
+static bool ocl_poll(ocl_event_t e) {
+    cl_int status = 0;
+    call(clGetEventInfo((cl_event)e, CL_EVENT_COMMAND_EXECUTION_STATUS,
+        sizeof(status), &status, null));
+    fatal_if(status < 0, "%s", ocl.error(status)); // command failed
+    return status == CL_COMPLETE;
+}
+
+typedef struct ocl_notify_s {
+    void (*callback)(void* that);
+    void* that;
+} ocl_notify_t;
+
+static void CL_CALLBACK ocl_notify_callback(cl_event e, cl_int status,
+        void* user_data) {
+    ocl_notify_t n = *(ocl_notify_t*)user_data;
+    free(user_data);
+    (void)e;
+    fatal_if(status < 0, "%s", ocl.error(status));
+    n.callback(n.that);
+}
+
+static void ocl_notify(ocl_event_t e, void (*callback)(void* that),
+        void* that) {
+    ocl_notify_t* n = (ocl_notify_t*)malloc(sizeof(ocl_notify_t));
+    fatal_if(n == null, "out of memory");
+    n->callback = callback;
+    n->that = that;
+    call(clSetEventCallback((cl_event)e, CL_COMPLETE, ocl_notify_callback, n));
+}
+
 static void ocl_retain_event(ocl_event_t e) {
     call(clRetainEvent((cl_event)e));
 }
@@ -363,6 +432,7 @@ static void ocl_init(void) {
                 d->platform = platforms[i];
                 get_str(CL_DEVICE_NAME, d->name);
                 get_str(CL_DEVICE_VENDOR, d->vendor);
+                get_str(CL_DRIVER_VERSION, d->driver);
                 char text[4096];
                 get_str(CL_DEVICE_VERSION, text); // e.g. "OpenCL 3.0 CUDA"
                 int minor = 0; // sscanf wants type "int" not "int32_t"
@@ -453,6 +523,7 @@ static void ocl_dump(int ix) {
     const ocl_device_t* d = &ocl.devices[ix];
     traceln("Device name:     %s OpenCL %d.%d C %d.%d", d->name,
         d->version_major, d->version_minor, d->c_version_major, d->c_version_minor);
+    traceln("driver:           %s", d->driver);
     traceln("compute_units:    %lld @ %lldMHz", d->compute_units, d->clock_frequency);
     traceln("global_memory:    %lldMB", d->global_memory / MB);
     traceln("local_memory:     %lldMB", d->local_memory / MB);
@@ -476,10 +547,14 @@ ocl_if ocl = {
     .map = ocl_map,
     .unmap = ocl_unmap,
     .compile_program = ocl_compile_program,
+    .load_program = ocl_load_program,
+    .program_binary = ocl_program_binary,
     .create_kernel = ocl_create_kernel,
     .kernel_info = ocl_kernel_info,
     .enqueue_range_kernel = ocl_enqueue_range_kernel,
     .wait = ocl_wait,
+    .poll = ocl_poll,
+    .notify = ocl_notify,
     .profile_add = ocl_profile_add,
     .profile = ocl_profile,
     .retain_event = ocl_retain_event,
@@ -52,6 +52,7 @@ typedef struct ocl_device_s {
     ocl_device_id_t id; // device id
     char  name[128];
     char  vendor[128];
+    char  driver[128];  // driver version
     int32_t version_major;    // OpenCL version
     int32_t version_minor;
     int32_t c_version_major;  // OpenCL kernel .cl C language version
@@ -172,6 +173,12 @@ typedef struct ocl_if {
     void (*unmap)(ocl_context_t* c, ocl_memory_t m, const void* address);
     ocl_program_t (*compile_program)(ocl_context_t* c, const char* code,
         size_t bytes, const char* options);
+    // load_program() builds program from binary previously obtained
+    // via program_binary() and returns null if the binary is rejected
+    ocl_program_t (*load_program)(ocl_context_t* c, const void* binary,
+        size_t bytes, const char* options);
+    // returns size of program binary, copies it if binary != null
+    size_t (*program_binary)(ocl_program_t p, void* binary, size_t bytes);
     ocl_kernel_t (*create_kernel)(ocl_program_t p, const char* name);
     void (*kernel_info)(ocl_context_t* c, ocl_kernel_t kernel,
         ocl_kernel_info_t* info);
@@ -180,6 +187,9 @@ typedef struct ocl_if {
         size_t groups, size_t items,
         int argc, ocl_arg_t argv[]);
     void (*wait)(ocl_event_t* events, int count);
+    bool (*poll)(ocl_event_t e); // true if the command has completed
+    // callback(that) is called on OpenCL driver thread when command completes
+    void (*notify)(ocl_event_t e, void (*callback)(void* that), void* that);
     // appends queued event to array of profiling events;
     ocl_profiling_t* (*profile_add)(ocl_context_t* c, ocl_event_t e);
     // must wait(&p->e, 1) or call .finish() before calling profile(p)
@@ -0,0 +1,1176 @@
+#include <math.h>
+#include <immintrin.h>
+#include "blas1.h"
+#include "isa.h"
+
+// Portable kernels take strides and are used for strided vectors, when
+// the CPU lacks AVX2 and for the tails of SIMD kernels. Element-wise
+// operations use fma() in both scalar and SIMD code so the results do
+// not depend on the kernel or on the position of the element.
+
+#define f32x8_t  __m256
+#define f32x16_t __m512
+#define f64x4_t  __m256d
+#define f64x8_t  __m512d
+
+enum {
+    blas1_block = 4 * 1024,  // fp32_t sums are flushed to fp64_t per block
+    blas1_chunk = 1 << 30    // iamax int32_t lane indices
+};
+
+// Blue's algorithm constants for fp64_t (see LAPACK dnrm2.f90):
+// squares of |x| < tsml are accumulated scaled up by ssml, squares of
+// |x| > tbig scaled down by sbig, everything else unscaled.
+static const fp64_t blas1_tsml = 1.4916681462400413e-154; // 2^-511
+static const fp64_t blas1_tbig = 1.997919072202235e+146;  // 2^486
+static const fp64_t blas1_ssml = 4.4989137945431964e+161; // 2^537
+static const fp64_t blas1_sbig = 1.1113793747425387e-162; // 2^-538
+
+typedef struct avx2_if { // contiguous vectors, null if not supported by CPU
+    void    (*init)(void);
+    void    (*axpy16)(fp32_t a, const fp16_t* x, fp16_t* y, int64_t n);
+    void    (*axpy32)(fp32_t a, const fp32_t* x, fp32_t* y, int64_t n);
+    void    (*axpy64)(fp64_t a, const fp64_t* x, fp64_t* y, int64_t n);
+    void    (*scal16)(fp32_t a, fp16_t* x, int64_t n);
+    void    (*scal32)(fp32_t a, fp32_t* x, int64_t n);
+    void    (*scal64)(fp64_t a, fp64_t* x, int64_t n);
+    fp64_t  (*asum16)(const fp16_t* x, int64_t n);
+    fp64_t  (*asum32)(const fp32_t* x, int64_t n);
+    fp64_t  (*asum64)(const fp64_t* x, int64_t n);
+    fp64_t  (*nrm2_16)(const fp16_t* x, int64_t n);
+    fp64_t  (*nrm2_32)(const fp32_t* x, int64_t n);
+    fp64_t  (*nrm2_64)(const fp64_t* x, int64_t n);
+    int64_t (*iamax16)(const fp16_t* x, int64_t n);
+    int64_t (*iamax32)(const fp32_t* x, int64_t n);
+    int64_t (*iamax64)(const fp64_t* x, int64_t n);
+    void    (*rot16)(fp32_t c, fp32_t s, fp16_t* x, fp16_t* y, int64_t n);
+    void    (*rot32)(fp32_t c, fp32_t s, fp32_t* x, fp32_t* y, int64_t n);
+    void    (*rot64)(fp64_t c, fp64_t s, fp64_t* x, fp64_t* y, int64_t n);
+    void    (*swap)(void* x, void* y, int64_t bytes);
+} avx2_if;
+
+typedef struct avx512_if { // fp16_t stays with AVX2 F16C kernels
+    void    (*init)(void);
+    void    (*axpy32)(fp32_t a, const fp32_t* x, fp32_t* y, int64_t n);
+    void    (*axpy64)(fp64_t a, const fp64_t* x, fp64_t* y, int64_t n);
+    void    (*scal32)(fp32_t a, fp32_t* x, int64_t n);
+    void    (*scal64)(fp64_t a, fp64_t* x, int64_t n);
+    fp64_t  (*asum32)(const fp32_t* x, int64_t n);
+    fp64_t  (*asum64)(const fp64_t* x, int64_t n);
+    fp64_t  (*nrm2_32)(const fp32_t* x, int64_t n);
+    fp64_t  (*nrm2_64)(const fp64_t* x, int64_t n);
+    int64_t (*iamax32)(const fp32_t* x, int64_t n);
+    int64_t (*iamax64)(const fp64_t* x, int64_t n);
+    void    (*rot32)(fp32_t c, fp32_t s, fp32_t* x, fp32_t* y, int64_t n);
+    void    (*rot64)(fp64_t c, fp64_t s, fp64_t* x, fp64_t* y, int64_t n);
+} avx512_if;
+
+static void avx2_init(void);
+static void avx512_init(void);
+
+static avx2_if   avx2   = { .init = avx2_init };
+static avx512_if avx512 = { .init = avx512_init };
+
+static void blas1_init(void) {
+    static bool init;
+    if (!init) { avx2.init(); avx512.init(); init = true; }
+}
+
+// portable:
+
+static void cpu_axpy16(fp32_t a, const fp16_t* x, int64_t sx,
+        fp16_t* y, int64_t sy, int64_t n) {
+    for (int64_t i = 0; i < n; i++) {
+        y[i * sy] = fp32to16(fmaf(a, fp16to32(x[i * sx]), fp16to32(y[i * sy])));
+    }
+}
+
+static void cpu_axpy32(fp32_t a, const fp32_t* x, int64_t sx,
+        fp32_t* y, int64_t sy, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { y[i * sy] = fmaf(a, x[i * sx], y[i * sy]); }
+}
+
+static void cpu_axpy64(fp64_t a, const fp64_t* x, int64_t sx,
+        fp64_t* y, int64_t sy, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { y[i * sy] = fma(a, x[i * sx], y[i * sy]); }
+}
+
+static void cpu_scal16(fp32_t a, fp16_t* x, int64_t s, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { x[i * s] = fp32to16(a * fp16to32(x[i * s])); }
+}
+
+static void cpu_scal32(fp32_t a, fp32_t* x, int64_t s, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { x[i * s] *= a; }
+}
+
+static void cpu_scal64(fp64_t a, fp64_t* x, int64_t s, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { x[i * s] *= a; }
+}
+
+static fp64_t cpu_asum16(const fp16_t* x, int64_t s, int64_t n) {
+    fp64_t sum = 0;
+    for (int64_t i = 0; i < n; i++) { sum += fabsf(fp16to32(x[i * s])); }
+    return sum;
+}
+
+static fp64_t cpu_asum32(const fp32_t* x, int64_t s, int64_t n) {
+    fp64_t sum = 0;
+    for (int64_t i = 0; i < n; i++) { sum += fabsf(x[i * s]); }
+    return sum;
+}
+
+static fp64_t cpu_asum64(const fp64_t* x, int64_t s, int64_t n) {
+    fp64_t sum = 0;
+    for (int64_t i = 0; i < n; i++) { sum += fabs(x[i * s]); }
+    return sum;
+}
+
+// sums of squares: fp32_t squares are exact in fp64_t and fp64_t
+// can hold sum of up to 2^53 of them without overflow
+
+static fp64_t cpu_ssq16(const fp16_t* x, int64_t s, int64_t n) {
+    fp64_t sum = 0;
+    for (int64_t i = 0; i < n; i++) {
+        const fp64_t v = fp16to32(x[i * s]);
+        sum += v * v;
+    }
+    return sum;
+}
+
+static fp64_t cpu_ssq32(const fp32_t* x, int64_t s, int64_t n) {
+    fp64_t sum = 0;
+    for (int64_t i = 0; i < n; i++) {
+        const fp64_t v = x[i * s];
+        sum += v * v;
+    }
+    return sum;
+}
+
+// a[0], a[1], a[2] small, medium and big accumulators of Blue's algorithm
+
+static void cpu_blue(const fp64_t* x, int64_t s, int64_t n, fp64_t a[3]) {
+    for (int64_t i = 0; i < n; i++) {
+        const fp64_t v = fabs(x[i * s]);
+        if (v > blas1_tbig) {
+            a[2] += (v * blas1_sbig) * (v * blas1_sbig);
+        } else if (v < blas1_tsml) {
+            a[0] += (v * blas1_ssml) * (v * blas1_ssml);
+        } else {
+            a[1] += v * v; // and NaNs
+        }
+    }
+}
+
+static fp64_t blas1_blue(const fp64_t a[3]) {
+    const fp64_t sml = a[0], med = a[1], big = a[2];
+    if (big > 0) { // medium values only matter when they are NaNs
+        const fp64_t sum = med > 0 || isnan(med) ?
+            big + (med * blas1_sbig) * blas1_sbig : big;
+        return sqrt(sum) / blas1_sbig;
+    } else if (sml > 0) {
+        if (med > 0 || isnan(med)) {
+            const fp64_t ym = sqrt(med);
+            const fp64_t ys = sqrt(sml) / blas1_ssml;
+            const fp64_t ymin = ys > ym ? ym : ys;
+            const fp64_t ymax = ys > ym ? ys : ym;
+            return ymax * sqrt(1 + (ymin / ymax) * (ymin / ymax));
+        }
+        return sqrt(sml) / blas1_ssml;
+    } else {
+        return sqrt(med);
+    }
+}
+
+static fp64_t cpu_nrm2_16(const fp16_t* x, int64_t s, int64_t n) {
+    return sqrt(cpu_ssq16(x, s, n));
+}
+
+static fp64_t cpu_nrm2_32(const fp32_t* x, int64_t s, int64_t n) {
+    return sqrt(cpu_ssq32(x, s, n));
+}
+
+static fp64_t cpu_nrm2_64(const fp64_t* x, int64_t s, int64_t n) {
+    fp64_t a[3] = {0};
+    cpu_blue(x, s, n, a);
+    return blas1_blue(a);
+}
+
+static int64_t cpu_iamax16(const fp16_t* x, int64_t s, int64_t n) {
+    int64_t k = n > 0 ? 0 : -1;
+    fp32_t max = -1;
+    for (int64_t i = 0; i < n; i++) {
+        const fp32_t v = fabsf(fp16to32(x[i * s]));
+        if (v > max) { max = v; k = i; }
+    }
+    return k;
+}
+
+static int64_t cpu_iamax32(const fp32_t* x, int64_t s, int64_t n) {
+    int64_t k = n > 0 ? 0 : -1;
+    fp32_t max = -1;
+    for (int64_t i = 0; i < n; i++) {
+        const fp32_t v = fabsf(x[i * s]);
+        if (v > max) { max = v; k = i; }
+    }
+    return k;
+}
+
+static int64_t cpu_iamax64(const fp64_t* x, int64_t s, int64_t n) {
+    int64_t k = n > 0 ? 0 : -1;
+    fp64_t max = -1;
+    for (int64_t i = 0; i < n; i++) {
+        const fp64_t v = fabs(x[i * s]);
+        if (v > max) { max = v; k = i; }
+    }
+    return k;
+}
+
+static void cpu_rot16(fp32_t c, fp32_t s, fp16_t* x, int64_t sx,
+        fp16_t* y, int64_t sy, int64_t n) {
+    for (int64_t i = 0; i < n; i++) {
+        const fp32_t xi = fp16to32(x[i * sx]);
+        const fp32_t yi = fp16to32(y[i * sy]);
+        x[i * sx] = fp32to16(fmaf(c, xi, s * yi));
+        y[i * sy] = fp32to16(fmaf(c, yi, -(s * xi)));
+    }
+}
+
+static void cpu_rot32(fp32_t c, fp32_t s, fp32_t* x, int64_t sx,
+        fp32_t* y, int64_t sy, int64_t n) {
+    for (int64_t i = 0; i < n; i++) {
+        const fp32_t xi = x[i * sx];
+        const fp32_t yi = y[i * sy];
+        x[i * sx] = fmaf(c, xi, s * yi);
+        y[i * sy] = fmaf(c, yi, -(s * xi));
+    }
+}
+
+static void cpu_rot64(fp64_t c, fp64_t s, fp64_t* x, int64_t sx,
+        fp64_t* y, int64_t sy, int64_t n) {
+    for (int64_t i = 0; i < n; i++) {
+        const fp64_t xi = x[i * sx];
+        const fp64_t yi = y[i * sy];
+        x[i * sx] = fma(c, xi, s * yi);
+        y[i * sy] = fma(c, yi, -(s * xi));
+    }
+}
+
+// m[0..lanes-1] lane maxima, ix[] their indices relative to base,
+// lanes that saw only NaNs have maximum -1. Earlier max wins ties.
+
+static void blas1_iamax_lanes(const fp64_t* m, const int64_t* ix, int lanes,
+        int64_t base, fp64_t* max, int64_t* k) {
+    fp64_t lm = -1;
+    int64_t li = INT64_MAX;
+    for (int i = 0; i < lanes; i++) {
+        if (m[i] > lm || (m[i] == lm && ix[i] < li)) { lm = m[i]; li = ix[i]; }
+    }
+    if (lm > *max) { *max = lm; *k = base + li; }
+}
+
+// avx2:
+
+#define avx2_ld16(p) _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(p)))
+#define avx2_ld32(p) _mm256_loadu_ps(p)
+#define avx2_st16(p, v) _mm_storeu_si128((__m128i*)(p), \
+    _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT))
+#define avx2_st32(p, v) _mm256_storeu_ps(p, v)
+
+isa_target("avx2")
+static inline f32x8_t avx2_abs_f32(f32x8_t v) {
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+}
+
+isa_target("avx2")
+static inline f64x4_t avx2_abs_f64(f64x4_t v) {
+    return _mm256_andnot_pd(_mm256_set1_pd(-0.0), v);
+}
+
+isa_target("avx2")
+static inline fp64_t avx2_sum_f64x4(f64x4_t v) {
+    __m128d f64x2 = _mm_add_pd(_mm256_castpd256_pd128(v),
+                               _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_hadd_pd(f64x2, f64x2));
+}
+
+isa_target("avx2")
+static inline fp64_t avx2_sum_f32x8(f32x8_t v) {
+    return avx2_sum_f64x4(_mm256_add_pd(
+        _mm256_cvtps_pd(_mm256_castps256_ps128(v)),
+        _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1))));
+}
+
+// The fp16_t and fp32_t AVX2 kernels differ only in loads and stores:
+
+#define avx2_axpy_f32x8(ld, st) do {                                    \
+    const f32x8_t va = _mm256_set1_ps(a);                               \
+    for (; n >= 8; n -= 8, x += 8, y += 8) {                            \
+        st(y, _mm256_fmadd_ps(va, ld(x), ld(y)));                       \
+    }                                                                   \
+} while (0)
+
+#define avx2_scal_f32x8(ld, st) do {                                    \
+    const f32x8_t va = _mm256_set1_ps(a);                               \
+    for (; n >= 8; n -= 8, x += 8) { st(x, _mm256_mul_ps(va, ld(x))); } \
+} while (0)
+
+#define avx2_rot_f32x8(ld, st) do {                                     \
+    const f32x8_t vc = _mm256_set1_ps(c);                               \
+    const f32x8_t vs = _mm256_set1_ps(s);                               \
+    for (; n >= 8; n -= 8, x += 8, y += 8) {                            \
+        const f32x8_t xi = ld(x);                                       \
+        const f32x8_t yi = ld(y);                                       \
+        st(x, _mm256_fmadd_ps(vc, xi, _mm256_mul_ps(vs, yi)));          \
+        st(y, _mm256_fmsub_ps(vc, yi, _mm256_mul_ps(vs, xi)));          \
+    }                                                                   \
+} while (0)
+
+#define avx2_asum_f32x8(ld) do {                                        \
+    while (n >= 8) {                                                    \
+        f32x8_t acc = _mm256_setzero_ps();                              \
+        int64_t k = min(n, (int64_t)blas1_block) & ~7LL;                \
+        n -= k;                                                         \
+        for (; k > 0; k -= 8, x += 8) {                                 \
+            acc = _mm256_add_ps(acc, avx2_abs_f32(ld(x)));              \
+        }                                                               \
+        sum += avx2_sum_f32x8(acc);                                     \
+    }                                                                   \
+} while (0)
+
+#define avx2_ssq_f32x8(ld) do {                                         \
+    f64x4_t a0 = _mm256_setzero_pd();                                   \
+    f64x4_t a1 = _mm256_setzero_pd();                                   \
+    for (; n >= 8; n -= 8, x += 8) {                                    \
+        const f32x8_t v = ld(x);                                        \
+        const f64x4_t lo = _mm256_cvtps_pd(_mm256_castps256_ps128(v));  \
+        const f64x4_t hi = _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)); \
+        a0 = _mm256_fmadd_pd(lo, lo, a0);                               \
+        a1 = _mm256_fmadd_pd(hi, hi, a1);                               \
+    }                                                                   \
+    sum += avx2_sum_f64x4(_mm256_add_pd(a0, a1));                       \
+} while (0)
+
+// iamax lanes keep the running maximum and int32_t index of it. NaNs
+// never compare greater and lanes start at -1.
+
+#define avx2_iamax_f32x8(ld) do {                                       \
+    while (n - i >= 8) {                                                \
+        const int64_t k = min((n - i) & ~7LL, (int64_t)blas1_chunk);    \
+        f32x8_t vm = _mm256_set1_ps(-1);                                \
+        __m256i vi = _mm256_setzero_si256();                            \
+        __m256i ix = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);         \
+        for (int64_t j = 0; j < k; j += 8) {                            \
+            const f32x8_t v = avx2_abs_f32(ld(x + i + j));              \
+            const f32x8_t gt = _mm256_cmp_ps(v, vm, _CMP_GT_OQ);        \
+            vm = _mm256_blendv_ps(vm, v, gt);                           \
+            vi = _mm256_castps_si256(_mm256_blendv_ps(                  \
+                _mm256_castsi256_ps(vi), _mm256_castsi256_ps(ix), gt)); \
+            ix = _mm256_add_epi32(ix, _mm256_set1_epi32(8));            \
+        }                                                               \
+        fp32_t lm[8];                                                   \
+        int32_t li[8];                                                  \
+        _mm256_storeu_ps(lm, vm);                                       \
+        _mm256_storeu_si256((__m256i*)li, vi);                          \
+        fp64_t m[8];                                                    \
+        int64_t ixs[8];                                                 \
+        for (int l = 0; l < 8; l++) { m[l] = lm[l]; ixs[l] = li[l]; }   \
+        blas1_iamax_lanes(m, ixs, 8, i, &max, &best);                   \
+        i += k;                                                         \
+    }                                                                   \
+} while (0)
+
+isa_target("avx2,fma,f16c")
+static void avx2_axpy16(fp32_t a, const fp16_t* x, fp16_t* y, int64_t n) {
+    avx2_axpy_f32x8(avx2_ld16, avx2_st16);
+    cpu_axpy16(a, x, 1, y, 1, n);
+}
+
+isa_target("avx2,fma")
+static void avx2_axpy32(fp32_t a, const fp32_t* x, fp32_t* y, int64_t n) {
+    avx2_axpy_f32x8(avx2_ld32, avx2_st32);
+    cpu_axpy32(a, x, 1, y, 1, n);
+}
+
+isa_target("avx2,fma")
+static void avx2_axpy64(fp64_t a, const fp64_t* x, fp64_t* y, int64_t n) {
+    const f64x4_t va = _mm256_set1_pd(a);
+    for (; n >= 4; n -= 4, x += 4, y += 4) {
+        _mm256_storeu_pd(y, _mm256_fmadd_pd(va, _mm256_loadu_pd(x),
+                                            _mm256_loadu_pd(y)));
+    }
+    cpu_axpy64(a, x, 1, y, 1, n);
+}
+
+isa_target("avx2,f16c")
+static void avx2_scal16(fp32_t a, fp16_t* x, int64_t n) {
+    avx2_scal_f32x8(avx2_ld16, avx2_st16);
+    cpu_scal16(a, x, 1, n);
+}
+
+isa_target("avx2")
+static void avx2_scal32(fp32_t a, fp32_t* x, int64_t n) {
+    avx2_scal_f32x8(avx2_ld32, avx2_st32);
+    cpu_scal32(a, x, 1, n);
+}
+
+isa_target("avx2")
+static void avx2_scal64(fp64_t a, fp64_t* x, int64_t n) {
+    const f64x4_t va = _mm256_set1_pd(a);
+    for (; n >= 4; n -= 4, x += 4) {
+        _mm256_storeu_pd(x, _mm256_mul_pd(va, _mm256_loadu_pd(x)));
+    }
+    cpu_scal64(a, x, 1, n);
+}
+
+isa_target("avx2,f16c")
+static fp64_t avx2_asum16(const fp16_t* x, int64_t n) {
+    fp64_t sum = 0;
+    avx2_asum_f32x8(avx2_ld16);
+    return sum + cpu_asum16(x, 1, n);
+}
+
+isa_target("avx2")
+static fp64_t avx2_asum32(const fp32_t* x, int64_t n) {
+    fp64_t sum = 0;
+    avx2_asum_f32x8(avx2_ld32);
+    return sum + cpu_asum32(x, 1, n);
+}
+
+isa_target("avx2")
+static fp64_t avx2_asum64(const fp64_t* x, int64_t n) {
+    f64x4_t a0 = _mm256_setzero_pd();
+    f64x4_t a1 = _mm256_setzero_pd();
+    for (; n >= 8; n -= 8, x += 8) {
+        a0 = _mm256_add_pd(a0, avx2_abs_f64(_mm256_loadu_pd(x)));
+        a1 = _mm256_add_pd(a1, avx2_abs_f64(_mm256_loadu_pd(x + 4)));
+    }
+    return avx2_sum_f64x4(_mm256_add_pd(a0, a1)) + cpu_asum64(x, 1, n);
+}
+
+isa_target("avx2,fma,f16c")
+static fp64_t avx2_nrm2_16(const fp16_t* x, int64_t n) {
+    fp64_t sum = 0;
+    avx2_ssq_f32x8(avx2_ld16);
+    return sqrt(sum + cpu_ssq16(x, 1, n));
+}
+
+isa_target("avx2,fma")
+static fp64_t avx2_nrm2_32(const fp32_t* x, int64_t n) {
+    fp64_t sum = 0;
+    avx2_ssq_f32x8(avx2_ld32);
+    return sqrt(sum + cpu_ssq32(x, 1, n));
+}
+
+// Blue's accumulators with lanes selected by comparison masks: NaNs
+// fail both comparisons and go to the medium accumulator like in
+// cpu_blue().
+
+isa_target("avx2,fma")
+static fp64_t avx2_nrm2_64(const fp64_t* x, int64_t n) {
+    const f64x4_t tsml = _mm256_set1_pd(blas1_tsml);
+    const f64x4_t tbig = _mm256_set1_pd(blas1_tbig);
+    const f64x4_t ssml = _mm256_set1_pd(blas1_ssml);
+    const f64x4_t sbig = _mm256_set1_pd(blas1_sbig);
+    f64x4_t sml = _mm256_setzero_pd();
+    f64x4_t med = _mm256_setzero_pd();
+    f64x4_t big = _mm256_setzero_pd();
+    for (; n >= 4; n -= 4, x += 4) {
+        const f64x4_t v = avx2_abs_f64(_mm256_loadu_pd(x));
+        const f64x4_t is_big = _mm256_cmp_pd(v, tbig, _CMP_GT_OQ);
+        const f64x4_t is_sml = _mm256_cmp_pd(v, tsml, _CMP_LT_OQ);
+        const f64x4_t b = _mm256_mul_pd(_mm256_and_pd(v, is_big), sbig);
+        const f64x4_t s = _mm256_mul_pd(_mm256_and_pd(v, is_sml), ssml);
+        const f64x4_t m = _mm256_andnot_pd(_mm256_or_pd(is_big, is_sml), v);
+        big = _mm256_fmadd_pd(b, b, big);
+        sml = _mm256_fmadd_pd(s, s, sml);
+        med = _mm256_fmadd_pd(m, m, med);
+    }
+    fp64_t a[3] = { avx2_sum_f64x4(sml), avx2_sum_f64x4(med),
+                    avx2_sum_f64x4(big) };
+    cpu_blue(x, 1, n, a);
+    return blas1_blue(a);
+}
+
+isa_target("avx2,f16c")
+static int64_t avx2_iamax16(const fp16_t* x, int64_t n) {
+    int64_t best = n > 0 ? 0 : -1, i = 0;
+    fp64_t max = -1;
+    avx2_iamax_f32x8(avx2_ld16);
+    const int64_t k = cpu_iamax16(x + i, 1, n - i);
+    if (k >= 0 && fabsf(fp16to32(x[i + k])) > max) { best = i + k; }
+    return best;
+}
+
+isa_target("avx2")
+static int64_t avx2_iamax32(const fp32_t* x, int64_t n) {
+    int64_t best = n > 0 ? 0 : -1, i = 0;
+    fp64_t max = -1;
+    avx2_iamax_f32x8(avx2_ld32);
+    const int64_t k = cpu_iamax32(x + i, 1, n - i);
+    if (k >= 0 && fabsf(x[i + k]) > max) { best = i + k; }
+    return best;
+}
+
+// fp64_t lanes keep indices as fp64_t that is exact up to 2^53
+
+isa_target("avx2")
+static int64_t avx2_iamax64(const fp64_t* x, int64_t n) {
+    int64_t best = n > 0 ? 0 : -1, i = 0;
+    fp64_t max = -1;
+    if (n >= 4) {
+        f64x4_t vm = _mm256_set1_pd(-1);
+        f64x4_t vi = _mm256_setzero_pd();
+        f64x4_t ix = _mm256_setr_pd(0, 1, 2, 3);
+        for (; n - i >= 4; i += 4) {
+            const f64x4_t v = avx2_abs_f64(_mm256_loadu_pd(x + i));
+            const f64x4_t gt = _mm256_cmp_pd(v, vm, _CMP_GT_OQ);
+            vm = _mm256_blendv_pd(vm, v, gt);
+            vi = _mm256_blendv_pd(vi, ix, gt);
+            ix = _mm256_add_pd(ix, _mm256_set1_pd(4));
+        }
+        fp64_t m[4], li[4];
+        int64_t ixs[4];
+        _mm256_storeu_pd(m, vm);
+        _mm256_storeu_pd(li, vi);
+        for (int l = 0; l < 4; l++) { ixs[l] = (int64_t)li[l]; }
+        blas1_iamax_lanes(m, ixs, 4, 0, &max, &best);
+    }
+    const int64_t k = cpu_iamax64(x + i, 1, n - i);
+    if (k >= 0 && fabs(x[i + k]) > max) { best = i + k; }
+    return best;
+}
+
+isa_target("avx2,fma,f16c")
+static void avx2_rot16(fp32_t c, fp32_t s, fp16_t* x, fp16_t* y, int64_t n) {
+    avx2_rot_f32x8(avx2_ld16, avx2_st16);
+    cpu_rot16(c, s, x, 1, y, 1, n);
+}
+
+isa_target("avx2,fma")
+static void avx2_rot32(fp32_t c, fp32_t s, fp32_t* x, fp32_t* y, int64_t n) {
+    avx2_rot_f32x8(avx2_ld32, avx2_st32);
+    cpu_rot32(c, s, x, 1, y, 1, n);
+}
+
+isa_target("avx2,fma")
+static void avx2_rot64(fp64_t c, fp64_t s, fp64_t* x, fp64_t* y, int64_t n) {
+    const f64x4_t vc = _mm256_set1_pd(c);
+    const f64x4_t vs = _mm256_set1_pd(s);
+    for (; n >= 4; n -= 4, x += 4, y += 4) {
+        const f64x4_t xi = _mm256_loadu_pd(x);
+        const f64x4_t yi = _mm256_loadu_pd(y);
+        _mm256_storeu_pd(x, _mm256_fmadd_pd(vc, xi, _mm256_mul_pd(vs, yi)));
+        _mm256_storeu_pd(y, _mm256_fmsub_pd(vc, yi, _mm256_mul_pd(vs, xi)));
+    }
+    cpu_rot64(c, s, x, 1, y, 1, n);
+}
+
+// swap of contiguous vectors is the same for all element types
+
+isa_target("avx2")
+static void avx2_swap(void* x, void* y, int64_t bytes) {
+    uint8_t* a = (uint8_t*)x;
+    uint8_t* b = (uint8_t*)y;
+    for (; bytes >= 32; bytes -= 32, a += 32, b += 32) {
+        const __m256i va = _mm256_loadu_si256((const __m256i*)a);
+        const __m256i vb = _mm256_loadu_si256((const __m256i*)b);
+        _mm256_storeu_si256((__m256i*)a, vb);
+        _mm256_storeu_si256((__m256i*)b, va);
+    }
+    for (; bytes > 0; bytes--, a++, b++) { uint8_t t = *a; *a = *b; *b = t; }
+}
+
+// avx512: tails are masked loads and stores
+
+isa_target("avx512f")
+static inline __mmask16 avx512_mask16(int64_t n) {
+    return n >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << n) - 1);
+}
+
+isa_target("avx512f")
+static inline __mmask8 avx512_mask8(int64_t n) {
+    return n >= 8 ? (__mmask8)0xFF : (__mmask8)((1u << n) - 1);
+}
+
+isa_target("avx512f")
+static void avx512_axpy32(fp32_t a, const fp32_t* x, fp32_t* y, int64_t n) {
+    const f32x16_t va = _mm512_set1_ps(a);
+    for (; n > 0; n -= 16, x += 16, y += 16) {
+        const __mmask16 k = avx512_mask16(n);
+        _mm512_mask_storeu_ps(y, k, _mm512_fmadd_ps(va,
+            _mm512_maskz_loadu_ps(k, x), _mm512_maskz_loadu_ps(k, y)));
+    }
+}
+
+isa_target("avx512f")
+static void avx512_axpy64(fp64_t a, const fp64_t* x, fp64_t* y, int64_t n) {
+    const f64x8_t va = _mm512_set1_pd(a);
+    for (; n > 0; n -= 8, x += 8, y += 8) {
+        const __mmask8 k = avx512_mask8(n);
+        _mm512_mask_storeu_pd(y, k, _mm512_fmadd_pd(va,
+            _mm512_maskz_loadu_pd(k, x), _mm512_maskz_loadu_pd(k, y)));
+    }
+}
+
+isa_target("avx512f")
+static void avx512_scal32(fp32_t a, fp32_t* x, int64_t n) {
+    const f32x16_t va = _mm512_set1_ps(a);
+    for (; n > 0; n -= 16, x += 16) {
+        const __mmask16 k = avx512_mask16(n);
+        _mm512_mask_storeu_ps(x, k, _mm512_mul_ps(va, _mm512_maskz_loadu_ps(k, x)));
+    }
+}
+
+isa_target("avx512f")
+static void avx512_scal64(fp64_t a, fp64_t* x, int64_t n) {
+    const f64x8_t va = _mm512_set1_pd(a);
+    for (; n > 0; n -= 8, x += 8) {
+        const __mmask8 k = avx512_mask8(n);
+        _mm512_mask_storeu_pd(x, k, _mm512_mul_pd(va, _mm512_maskz_loadu_pd(k, x)));
+    }
+}
+
+// upper 8 of 16 fp32_t lanes (AVX512DQ has _mm512_extractf32x8_ps())
+isa_target("avx512f")
+static inline __m256 avx512_upper_f32x8(f32x16_t v) {
+    return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+}
+
+isa_target("avx512f")
+static fp64_t avx512_asum32(const fp32_t* x, int64_t n) {
+    fp64_t sum = 0;
+    while (n > 0) {
+        f32x16_t acc = _mm512_setzero_ps();
+        int64_t k = min(n, (int64_t)blas1_block);
+        n -= k;
+        for (; k > 0; k -= 16, x += 16) {
+            acc = _mm512_add_ps(acc, _mm512_abs_ps(
+                _mm512_maskz_loadu_ps(avx512_mask16(k), x)));
+        }
+        sum += _mm512_reduce_add_pd(_mm512_add_pd(
+            _mm512_cvtps_pd(_mm512_castps512_ps256(acc)),
+            _mm512_cvtps_pd(avx512_upper_f32x8(acc))));
+    }
+    return sum;
+}
+
+isa_target("avx512f")
+static fp64_t avx512_asum64(const fp64_t* x, int64_t n) {
+    f64x8_t acc = _mm512_setzero_pd();
+    for (; n > 0; n -= 8, x += 8) {
+        acc = _mm512_add_pd(acc, _mm512_abs_pd(
+            _mm512_maskz_loadu_pd(avx512_mask8(n), x)));
+    }
+    return _mm512_reduce_add_pd(acc);
+}
+
+isa_target("avx512f")
+static fp64_t avx512_nrm2_32(const fp32_t* x, int64_t n) {
+    f64x8_t a0 = _mm512_setzero_pd();
+    f64x8_t a1 = _mm512_setzero_pd();
+    for (; n > 0; n -= 16, x += 16) {
+        const f32x16_t v = _mm512_maskz_loadu_ps(avx512_mask16(n), x);
+        const f64x8_t lo = _mm512_cvtps_pd(_mm512_castps512_ps256(v));
+        const f64x8_t hi = _mm512_cvtps_pd(avx512_upper_f32x8(v));
+        a0 = _mm512_fmadd_pd(lo, lo, a0);
+        a1 = _mm512_fmadd_pd(hi, hi, a1);
+    }
+    return sqrt(_mm512_reduce_add_pd(_mm512_add_pd(a0, a1)));
+}
+
+isa_target("avx512f")
+static fp64_t avx512_nrm2_64(const fp64_t* x, int64_t n) {
+    const f64x8_t tsml = _mm512_set1_pd(blas1_tsml);
+    const f64x8_t tbig = _mm512_set1_pd(blas1_tbig);
+    const f64x8_t ssml = _mm512_set1_pd(blas1_ssml);
+    const f64x8_t sbig = _mm512_set1_pd(blas1_sbig);
+    f64x8_t sml = _mm512_setzero_pd();
+    f64x8_t med = _mm512_setzero_pd();
+    f64x8_t big = _mm512_setzero_pd();
+    for (; n > 0; n -= 8, x += 8) {
+        const f64x8_t v = _mm512_abs_pd(_mm512_maskz_loadu_pd(avx512_mask8(n), x));
+        const __mmask8 is_big = _mm512_cmp_pd_mask(v, tbig, _CMP_GT_OQ);
+        const __mmask8 is_sml = _mm512_cmp_pd_mask(v, tsml, _CMP_LT_OQ);
+        const f64x8_t b = _mm512_maskz_mul_pd(is_big, v, sbig);
+        const f64x8_t s = _mm512_maskz_mul_pd(is_sml, v, ssml);
+        const f64x8_t m = _mm512_maskz_mov_pd((__mmask8)~(is_big | is_sml), v);
+        big = _mm512_fmadd_pd(b, b, big);
+        sml = _mm512_fmadd_pd(s, s, sml);
+        med = _mm512_fmadd_pd(m, m, med);
+    }
+    const fp64_t a[3] = { _mm512_reduce_add_pd(sml), _mm512_reduce_add_pd(med),
+                          _mm512_reduce_add_pd(big) };
+    return blas1_blue(a);
+}
+
+// Masked off tail lanes are not updated and keep -1 maximum.
+
+isa_target("avx512f")
+static int64_t avx512_iamax32(const fp32_t* x, int64_t n) {
+    int64_t best = n > 0 ? 0 : -1;
+    fp64_t max = -1;
+    for (int64_t i = 0; i < n; i += blas1_chunk) {
+        const int64_t k = min(n - i, (int64_t)blas1_chunk);
+        f32x16_t vm = _mm512_set1_ps(-1);
+        __m512i vi = _mm512_setzero_si512();
+        __m512i ix = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                       8, 9, 10, 11, 12, 13, 14, 15);
+        for (int64_t j = 0; j < k; j += 16) {
+            const f32x16_t v = _mm512_abs_ps(
+                _mm512_maskz_loadu_ps(avx512_mask16(k - j), x + i + j));
+            const __mmask16 gt = _mm512_mask_cmp_ps_mask(avx512_mask16(k - j),
+                v, vm, _CMP_GT_OQ);
+            vm = _mm512_mask_mov_ps(vm, gt, v);
+            vi = _mm512_mask_mov_epi32(vi, gt, ix);
+            ix = _mm512_add_epi32(ix, _mm512_set1_epi32(16));
+        }
+        fp32_t lm[16];
+        int32_t li[16];
+        _mm512_storeu_ps(lm, vm);
+        _mm512_storeu_si512(li, vi);
+        fp64_t m[16];
+        int64_t ixs[16];
+        for (int l = 0; l < 16; l++) { m[l] = lm[l]; ixs[l] = li[l]; }
+        blas1_iamax_lanes(m, ixs, 16, i, &max, &best);
+    }
+    return best;
+}
+
+isa_target("avx512f")
+static int64_t avx512_iamax64(const fp64_t* x, int64_t n) {
+    int64_t best = n > 0 ? 0 : -1;
+    fp64_t max = -1;
+    f64x8_t vm = _mm512_set1_pd(-1);
+    __m512i vi = _mm512_setzero_si512();
+    __m512i ix = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    for (int64_t j = 0; j < n; j += 8) {
+        const __mmask8 k = avx512_mask8(n - j);
+        const f64x8_t v = _mm512_abs_pd(_mm512_maskz_loadu_pd(k, x + j));
+        const __mmask8 gt = _mm512_mask_cmp_pd_mask(k, v, vm, _CMP_GT_OQ);
+        vm = _mm512_mask_mov_pd(vm, gt, v);
+        vi = _mm512_mask_mov_epi64(vi, gt, ix);
+        ix = _mm512_add_epi64(ix, _mm512_set1_epi64(8));
+    }
+    fp64_t m[8];
+    int64_t ixs[8];
+    _mm512_storeu_pd(m, vm);
+    _mm512_storeu_si512(ixs, vi);
+    blas1_iamax_lanes(m, ixs, 8, 0, &max, &best);
+    return best;
+}
+
+isa_target("avx512f")
+static void avx512_rot32(fp32_t c, fp32_t s, fp32_t* x, fp32_t* y, int64_t n) {
+    const f32x16_t vc = _mm512_set1_ps(c);
+    const f32x16_t vs = _mm512_set1_ps(s);
+    for (; n > 0; n -= 16, x += 16, y += 16) {
+        const __mmask16 k = avx512_mask16(n);
+        const f32x16_t xi = _mm512_maskz_loadu_ps(k, x);
+        const f32x16_t yi = _mm512_maskz_loadu_ps(k, y);
+        _mm512_mask_storeu_ps(x, k, _mm512_fmadd_ps(vc, xi, _mm512_mul_ps(vs, yi)));
+        _mm512_mask_storeu_ps(y, k, _mm512_fmsub_ps(vc, yi, _mm512_mul_ps(vs, xi)));
+    }
+}
+
+isa_target("avx512f")
+static void avx512_rot64(fp64_t c, fp64_t s, fp64_t* x, fp64_t* y, int64_t n) {
+    const f64x8_t vc = _mm512_set1_pd(c);
+    const f64x8_t vs = _mm512_set1_pd(s);
+    for (; n > 0; n -= 8, x += 8, y += 8) {
+        const __mmask8 k = avx512_mask8(n);
+        const f64x8_t xi = _mm512_maskz_loadu_pd(k, x);
+        const f64x8_t yi = _mm512_maskz_loadu_pd(k, y);
+        _mm512_mask_storeu_pd(x, k, _mm512_fmadd_pd(vc, xi, _mm512_mul_pd(vs, yi)));
+        _mm512_mask_storeu_pd(y, k, _mm512_fmsub_pd(vc, yi, _mm512_mul_pd(vs, xi)));
+    }
+}
+
+static void avx2_init(void) {
+    isa.init();
+    if (isa.avx2 && isa.fma) {
+        avx2.axpy32  = avx2_axpy32;
+        avx2.axpy64  = avx2_axpy64;
+        avx2.scal32  = avx2_scal32;
+        avx2.scal64  = avx2_scal64;
+        avx2.asum32  = avx2_asum32;
+        avx2.asum64  = avx2_asum64;
+        avx2.nrm2_32 = avx2_nrm2_32;
+        avx2.nrm2_64 = avx2_nrm2_64;
+        avx2.iamax32 = avx2_iamax32;
+        avx2.iamax64 = avx2_iamax64;
+        avx2.rot32   = avx2_rot32;
+        avx2.rot64   = avx2_rot64;
+        avx2.swap    = avx2_swap;
+        if (isa.f16c) {
+            avx2.axpy16  = avx2_axpy16;
+            avx2.scal16  = avx2_scal16;
+            avx2.asum16  = avx2_asum16;
+            avx2.nrm2_16 = avx2_nrm2_16;
+            avx2.iamax16 = avx2_iamax16;
+            avx2.rot16   = avx2_rot16;
+        }
+    }
+}
+
+static void avx512_init(void) {
+    isa.init();
+    if (isa.avx512f) {
+        avx512.axpy32  = avx512_axpy32;
+        avx512.axpy64  = avx512_axpy64;
+        avx512.scal32  = avx512_scal32;
+        avx512.scal64  = avx512_scal64;
+        avx512.asum32  = avx512_asum32;
+        avx512.asum64  = avx512_asum64;
+        avx512.nrm2_32 = avx512_nrm2_32;
+        avx512.nrm2_64 = avx512_nrm2_64;
+        avx512.iamax32 = avx512_iamax32;
+        avx512.iamax64 = avx512_iamax64;
+        avx512.rot32   = avx512_rot32;
+        avx512.rot64   = avx512_rot64;
+    }
+}
+
+// API: contiguous vectors go to the widest available kernel
+
+void axpy16(fp32_t a, const fp16_t* x, int64_t sx, fp16_t* y, int64_t sy, int64_t n) {
+    blas1_init();
+    if (sx == 1 && sy == 1 && avx2.axpy16 != null) {
+        avx2.axpy16(a, x, y, n);
+    } else {
+        cpu_axpy16(a, x, sx, y, sy, n);
+    }
+}
+
+void axpy32(fp32_t a, const fp32_t* x, int64_t sx, fp32_t* y, int64_t sy, int64_t n) {
+    blas1_init();
+    if (sx == 1 && sy == 1 && avx512.axpy32 != null) {
+        avx512.axpy32(a, x, y, n);
+    } else if (sx == 1 && sy == 1 && avx2.axpy32 != null) {
+        avx2.axpy32(a, x, y, n);
+    } else {
+        cpu_axpy32(a, x, sx, y, sy, n);
+    }
+}
+
+void axpy64(fp64_t a, const fp64_t* x, int64_t sx, fp64_t* y, int64_t sy, int64_t n) {
+    blas1_init();
+    if (sx == 1 && sy == 1 && avx512.axpy64 != null) {
+        avx512.axpy64(a, x, y, n);
+    } else if (sx == 1 && sy == 1 && avx2.axpy64 != null) {
+        avx2.axpy64(a, x, y, n);
+    } else {
+        cpu_axpy64(a, x, sx, y, sy, n);
+    }
+}
+
+void scal16(fp32_t a, fp16_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    if (s == 1 && avx2.scal16 != null) {
+        avx2.scal16(a, x, n);
+    } else {
+        cpu_scal16(a, x, s, n);
+    }
+}
+
+void scal32(fp32_t a, fp32_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    if (s == 1 && avx512.scal32 != null) {
+        avx512.scal32(a, x, n);
+    } else if (s == 1 && avx2.scal32 != null) {
+        avx2.scal32(a, x, n);
+    } else {
+        cpu_scal32(a, x, s, n);
+    }
+}
+
+void scal64(fp64_t a, fp64_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    if (s == 1 && avx512.scal64 != null) {
+        avx512.scal64(a, x, n);
+    } else if (s == 1 && avx2.scal64 != null) {
+        avx2.scal64(a, x, n);
+    } else {
+        cpu_scal64(a, x, s, n);
+    }
+}
+
+fp64_t asum16(const fp16_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    return s == 1 && avx2.asum16 != null ?
+        avx2.asum16(x, n) : cpu_asum16(x, s, n);
+}
+
+fp64_t asum32(const fp32_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    if (s == 1 && avx512.asum32 != null) { return avx512.asum32(x, n); }
+    return s == 1 && avx2.asum32 != null ?
+        avx2.asum32(x, n) : cpu_asum32(x, s, n);
+}
+
+fp64_t asum64(const fp64_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    if (s == 1 && avx512.asum64 != null) { return avx512.asum64(x, n); }
+    return s == 1 && avx2.asum64 != null ?
+        avx2.asum64(x, n) : cpu_asum64(x, s, n);
+}
+
+fp64_t nrm2_16(const fp16_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    return s == 1 && avx2.nrm2_16 != null ?
+        avx2.nrm2_16(x, n) : cpu_nrm2_16(x, s, n);
+}
+
+fp64_t nrm2_32(const fp32_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    if (s == 1 && avx512.nrm2_32 != null) { return avx512.nrm2_32(x, n); }
+    return s == 1 && avx2.nrm2_32 != null ?
+        avx2.nrm2_32(x, n) : cpu_nrm2_32(x, s, n);
+}
+
+fp64_t nrm2_64(const fp64_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    if (s == 1 && avx512.nrm2_64 != null) { return avx512.nrm2_64(x, n); }
+    return s == 1 && avx2.nrm2_64 != null ?
+        avx2.nrm2_64(x, n) : cpu_nrm2_64(x, s, n);
+}
+
+int64_t iamax16(const fp16_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    return s == 1 && avx2.iamax16 != null ?
+        avx2.iamax16(x, n) : cpu_iamax16(x, s, n);
+}
+
+int64_t iamax32(const fp32_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    if (s == 1 && avx512.iamax32 != null) { return avx512.iamax32(x, n); }
+    return s == 1 && avx2.iamax32 != null ?
+        avx2.iamax32(x, n) : cpu_iamax32(x, s, n);
+}
+
+int64_t iamax64(const fp64_t* x, int64_t s, int64_t n) {
+    blas1_init();
+    if (s == 1 && avx512.iamax64 != null) { return avx512.iamax64(x, n); }
+    return s == 1 && avx2.iamax64 != null ?
+        avx2.iamax64(x, n) : cpu_iamax64(x, s, n);
+}
+
+void rot16(fp32_t c, fp32_t s, fp16_t* x, int64_t sx, fp16_t* y, int64_t sy, int64_t n) {
+    blas1_init();
+    if (sx == 1 && sy == 1 && avx2.rot16 != null) {
+        avx2.rot16(c, s, x, y, n);
+    } else {
+        cpu_rot16(c, s, x, sx, y, sy, n);
+    }
+}
+
+void rot32(fp32_t c, fp32_t s, fp32_t* x, int64_t sx, fp32_t* y, int64_t sy, int64_t n) {
+    blas1_init();
+    if (sx == 1 && sy == 1 && avx512.rot32 != null) {
+        avx512.rot32(c, s, x, y, n);
+    } else if (sx == 1 && sy == 1 && avx2.rot32 != null) {
+        avx2.rot32(c, s, x, y, n);
+    } else {
+        cpu_rot32(c, s, x, sx, y, sy, n);
+    }
+}
+
+void rot64(fp64_t c, fp64_t s, fp64_t* x, int64_t sx, fp64_t* y, int64_t sy, int64_t n) {
+    blas1_init();
+    if (sx == 1 && sy == 1 && avx512.rot64 != null) {
+        avx512.rot64(c, s, x, y, n);
+    } else if (sx == 1 && sy == 1 && avx2.rot64 != null) {
+        avx2.rot64(c, s, x, y, n);
+    } else {
+        cpu_rot64(c, s, x, sx, y, sy, n);
+    }
+}
+
+#define blas1_swap(type) do {                                           \
+    blas1_init();                                                       \
+    if (sx == 1 && sy == 1 && avx2.swap != null) {                      \
+        avx2.swap(x, y, n * (int64_t)sizeof(type));                     \
+    } else {                                                            \
+        for (int64_t i = 0; i < n; i++) {                               \
+            const type t = x[i * sx]; x[i * sx] = y[i * sy]; y[i * sy] = t; \
+        }                                                               \
+    }                                                                   \
+} while (0)
+
+void swap16(fp16_t* x, int64_t sx, fp16_t* y, int64_t sy, int64_t n) {
+    blas1_swap(fp16_t);
+}
+
+void swap32(fp32_t* x, int64_t sx, fp32_t* y, int64_t sy, int64_t n) {
+    blas1_swap(fp32_t);
+}
+
+void swap64(fp64_t* x, int64_t sx, fp64_t* y, int64_t sy, int64_t n) {
+    blas1_swap(fp64_t);
+}
+
+// Small multiples of 1/4 keep all results exact in fp16_t, fp32_t and
+// fp64_t, so every kernel must produce exactly the expected values.
+
+static void blas1_test_exact(void) {
+    enum { n_max = 131, s_max = 3 };
+    static fp16_t x16[n_max * s_max], y16[n_max * s_max];
+    static fp32_t x32[n_max * s_max], y32[n_max * s_max];
+    static fp64_t x64[n_max * s_max], y64[n_max * s_max];
+    #pragma push_macro("set")
+    #pragma push_macro("check")
+    #define set(i, x, y) do {                                           \
+        x64[i] = x32[i] = (fp32_t)(x); x16[i] = fp32to16(x32[i]);       \
+        y64[i] = y32[i] = (fp32_t)(y); y16[i] = fp32to16(y32[i]);       \
+    } while (0)
+    #define check(what, i, x, y) fatal_if(                              \
+        fp16to32(x16[i]) != (x) || x32[i] != (x) || x64[i] != (x) ||    \
+        fp16to32(y16[i]) != (y) || y32[i] != (y) || y64[i] != (y),      \
+        "%s n: %lld s: %lld [%lld] %.2f %.2f %.2f %.2f %.2f %.2f "      \
+        "expected: %.2f %.2f", what, n, s, i, fp16to32(x16[i]), x32[i], \
+        x64[i], fp16to32(y16[i]), y32[i], y64[i], (fp64_t)(x), (fp64_t)(y))
+    for (int64_t n = 0; n <= n_max; n += n < 40 ? 1 : 13) {
+        for (int64_t s = 1; s <= s_max; s += 2) {
+            fp64_t sum = 0, ssq = 0;
+            for (int64_t i = 0; i < n * s; i++) {
+                set(i, (i % 7 - 3) / 4.0, (i % 5 - 2) / 2.0);
+                if (i % s == 0) {
+                    sum += fabs(x64[i]);
+                    ssq += x64[i] * x64[i];
+                }
+            }
+            const fp64_t a[3] = { asum16(x16, s, n), asum32(x32, s, n), asum64(x64, s, n) };
+            const fp64_t r[3] = { nrm2_16(x16, s, n), nrm2_32(x32, s, n), nrm2_64(x64, s, n) };
+            for (int k = 0; k < 3; k++) {
+                fatal_if(a[k] != sum || r[k] != sqrt(ssq), "n: %lld s: %lld "
+                    "asum: %.2f expected: %.2f nrm2: %.17f expected: %.17f",
+                    n, s, a[k], sum, r[k], sqrt(ssq));
+            }
+            axpy16(0.5f, x16, s, y16, s, n);
+            axpy32(0.5f, x32, s, y32, s, n);
+            axpy64(0.5, x64, s, y64, s, n);
+            for (int64_t i = 0; i < n * s; i++) {
+                const fp64_t x = (i % 7 - 3) / 4.0, y = (i % 5 - 2) / 2.0;
+                check("axpy", i, x, i % s == 0 ? 0.5 * x + y : y);
+            }
+            for (int64_t i = 0; i < n * s; i++) { set(i, (i % 7 - 3) / 4.0, 0); }
+            scal16(-2.0f, x16, s, n);
+            scal32(-2.0f, x32, s, n);
+            scal64(-2.0, x64, s, n);
+            for (int64_t i = 0; i < n * s; i++) {
+                const fp64_t x = (i % 7 - 3) / 4.0;
+                check("scal", i, i % s == 0 ? -2 * x : x, 0);
+            }
+            for (int64_t i = 0; i < n * s; i++) {
+                set(i, (i % 7 - 3) / 4.0, (i % 5 - 2) / 2.0);
+            }
+            rot16(0.5f, 0.25f, x16, s, y16, s, n);
+            rot32(0.5f, 0.25f, x32, s, y32, s, n);
+            rot64(0.5, 0.25, x64, s, y64, s, n);
+            for (int64_t i = 0; i < n * s; i++) {
+                const fp64_t x = (i % 7 - 3) / 4.0, y = (i % 5 - 2) / 2.0;
+                if (i % s == 0) {
+                    check("rot", i, 0.5 * x + 0.25 * y, 0.5 * y - 0.25 * x);
+                } else {
+                    check("rot", i, x, y);
+                }
+            }
+            for (int64_t i = 0; i < n * s; i++) {
+                set(i, (i % 7 - 3) / 4.0, (i % 5 - 2) / 2.0);
+            }
+            swap16(x16, s, y16, s, n);
+            swap32(x32, s, y32, s, n);
+            swap64(x64, s, y64, s, n);
+            for (int64_t i = 0; i < n * s; i++) {
+                const fp64_t x = (i % 7 - 3) / 4.0, y = (i % 5 - 2) / 2.0;
+                if (i % s == 0) {
+                    check("swap", i, y, x);
+                } else {
+                    check("swap", i, x, y);
+                }
+            }
+            // iamax: NaN first and the first of two equal maxima wins
+            for (int64_t p = 0; p < n; p += 1 + n / 7) {
+                for (int64_t i = 0; i < n * s; i++) { set(i, (i % 7 - 3) / 4.0, 0); }
+                set(0, NAN, 0);
+                if (p > 0) {
+                    set(p * s, -4, 0);
+                    if (p + 1 < n) { set((n - 1) * s, 4, 0); }
+                }
+                int64_t e = n == 0 ? -1 : 0;
+                fp64_t max = -1;
+                for (int64_t i = 0; i < n; i++) {
+                    if (fabs(x64[i * s]) > max) { max = fabs(x64[i * s]); e = i; }
+                }
+                const int64_t k[3] = {
+                    iamax16(x16, s, n), iamax32(x32, s, n), iamax64(x64, s, n)
+                };
+                for (int j = 0; j < 3; j++) {
+                    fatal_if(k[j] != e, "iamax n: %lld s: %lld p: %lld "
+                             "%lld expected: %lld", n, s, p, k[j], e);
+                }
+            }
+        }
+    }
+    #pragma pop_macro("check")
+    #pragma pop_macro("set")
+}
+
+// nrm2 of values that would overflow or underflow if squared in the
+// precision of the elements: 3 * scale and 4 * scale alternating
+// 18 times is 15 * scale.
+
+static void blas1_test_nrm2(void) {
+    enum { n = 18 };
+    fatal_if(blas1_tsml != ldexp(1, -511) || blas1_tbig != ldexp(1, 486) ||
+             blas1_ssml != ldexp(1, 537) || blas1_sbig != ldexp(1, -538),
+             "Blue's constants");
+    static const fp64_t scales[] = {
+        1, 1e300, 1e-300, 1e-310, 1e150, 1e-160, 1e-320
+    };
+    fp16_t x16[n];
+    fp32_t x32[n];
+    fp64_t x64[n];
+    for (int k = 0; k < countof(scales); k++) {
+        for (int i = 0; i < n; i++) { x64[i] = (i % 2 ? 3 : 4) * scales[k]; }
+        const fp64_t r = nrm2_64(x64, 1, n), e = 15 * scales[k];
+        // 1e-320 is subnormal with only a few significant bits
+        const fp64_t tolerance = scales[k] < DBL_MIN ? 1e-3 : 1e-15;
+        fatal_if(fabs(r - e) > e * tolerance, "nrm2_64: %.17e expected: %.17e", r, e);
+        const fp64_t s = nrm2_64(x64 + 1, 2, n / 2), es = 3 * scales[k] * 3;
+        fatal_if(fabs(s - es) > es * tolerance, "nrm2_64: %.17e expected: %.17e", s, es);
+    }
+    for (int i = 0; i < n; i++) {
+        x32[i] = (i % 2 ? 3 : 4) * 1e37f;   // squares overflow fp32_t
+        x16[i] = fp32to16((i % 2 ? 3 : 4) * 1000.0f); // and fp16_t
+    }
+    const fp64_t r32 = nrm2_32(x32, 1, n), e32 = 15 * (fp64_t)1e37f;
+    fatal_if(fabs(r32 - e32) > e32 * 1e-7, "nrm2_32: %.9e expected: %.9e", r32, e32);
+    fatal_if(nrm2_16(x16, 1, n) != 15000, "nrm2_16: %.3f", nrm2_16(x16, 1, n));
+    for (int i = 0; i < n; i++) { x64[i] = i % 3 ? 1e300 : 1e-300; }
+    x64[n - 1] = INFINITY;
+    fatal_if(!isinf(nrm2_64(x64, 1, n)), "nrm2_64 inf");
+    x64[n - 1] = NAN;
+    fatal_if(!isnan(nrm2_64(x64, 1, n)), "nrm2_64 NaN");
+    for (int i = 0; i < n; i++) { x64[i] = i % 3 ? 1 : 1e-300; }
+    x64[n - 1] = NAN;
+    fatal_if(!isnan(nrm2_64(x64, 1, n)), "nrm2_64 NaN");
+    x32[n - 1] = NAN;
+    fatal_if(!isnan(nrm2_32(x32, 1, n)), "nrm2_32 NaN");
+}
+
+void blas1_test() {
+    blas1_init();
+    // widest kernels, then AVX2 only, then portable kernels:
+    const avx512_if a512 = avx512;
+    const avx2_if a2 = avx2;
+    blas1_test_exact();
+    blas1_test_nrm2();
+    avx512 = (avx512_if){ .init = avx512_init };
+    blas1_test_exact();
+    blas1_test_nrm2();
+    avx2 = (avx2_if){ .init = avx2_init };
+    blas1_test_exact();
+    blas1_test_nrm2();
+    avx2 = a2;
+    avx512 = a512;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "rt.h"
+
+#ifdef cplusplus
+extern "C" {
+#endif
+
+// Host Level 1 BLAS (dot products are in dot.h). sx, sy and s are strides
+// in elements (>= 1), contiguous vectors (stride 1) use AVX2 or AVX512
+// kernels when the CPU supports them. fp16_t is computed in fp32_t and
+// rounded to nearest even on store. Reductions return fp64_t.
+
+// y = a * x + y
+void axpy16(fp32_t a, const fp16_t* x, int64_t sx, fp16_t* y, int64_t sy, int64_t n);
+void axpy32(fp32_t a, const fp32_t* x, int64_t sx, fp32_t* y, int64_t sy, int64_t n);
+void axpy64(fp64_t a, const fp64_t* x, int64_t sx, fp64_t* y, int64_t sy, int64_t n);
+
+// x = a * x
+void scal16(fp32_t a, fp16_t* x, int64_t s, int64_t n);
+void scal32(fp32_t a, fp32_t* x, int64_t s, int64_t n);
+void scal64(fp64_t a, fp64_t* x, int64_t s, int64_t n);
+
+// sum(|x[i]|)
+fp64_t asum16(const fp16_t* x, int64_t s, int64_t n);
+fp64_t asum32(const fp32_t* x, int64_t s, int64_t n);
+fp64_t asum64(const fp64_t* x, int64_t s, int64_t n);
+
+// sqrt(sum(x[i] * x[i])) in a single pass without overflow or underflow
+// of intermediate results: squares of fp16_t and fp32_t are summed in
+// fp64_t that has enough range, fp64_t uses Blue's scaled accumulators.
+fp64_t nrm2_16(const fp16_t* x, int64_t s, int64_t n);
+fp64_t nrm2_32(const fp32_t* x, int64_t s, int64_t n);
+fp64_t nrm2_64(const fp64_t* x, int64_t s, int64_t n);
+
+// index of the first element with the largest |x[i]|, NaNs are skipped
+// (0 if all elements are NaNs), -1 if n < 1
+int64_t iamax16(const fp16_t* x, int64_t s, int64_t n);
+int64_t iamax32(const fp32_t* x, int64_t s, int64_t n);
+int64_t iamax64(const fp64_t* x, int64_t s, int64_t n);
+
+// plane rotation: x[i], y[i] = c * x[i] + s * y[i], c * y[i] - s * x[i]
+void rot16(fp32_t c, fp32_t s, fp16_t* x, int64_t sx, fp16_t* y, int64_t sy, int64_t n);
+void rot32(fp32_t c, fp32_t s, fp32_t* x, int64_t sx, fp32_t* y, int64_t sy, int64_t n);
+void rot64(fp64_t c, fp64_t s, fp64_t* x, int64_t sx, fp64_t* y, int64_t sy, int64_t n);
+
+// x[i] <-> y[i]
+void swap16(fp16_t* x, int64_t sx, fp16_t* y, int64_t sy, int64_t n);
+void swap32(fp32_t* x, int64_t sx, fp32_t* y, int64_t sy, int64_t n);
+void swap64(fp64_t* x, int64_t sx, fp64_t* y, int64_t sy, int64_t n);
+
+void blas1_test();
+
+#ifdef cplusplus
+} // extern "C"
+#endif
@@ -1,5 +1,8 @@
 #include "rt.h"
 #include "blast.h"
+#include "dot.h"
+#include "gemv.h"
+#include "quant.h"
 #include <CL/opencl.h>
 #include <math.h>
 #include <malloc.h>
@@ -7,12 +10,29 @@
 // because fpp and access enums are used to index arrays they must be compact
 // with exact ordering:
 
-static_assert(blast_fpp16 == 0 && blast_fpp32 == 1 && blast_fpp64 == 2, "order");
+static_assert(blast_fpp16 == 0 && blast_fpp32 == 1 && blast_fpp64 == 2 &&
+              blast_fppbf16 == 3, "order");
 
-const char* blast_fpp_names[3] = {"fp16", "fp32", "fp64"};
+const char* blast_fpp_names[4] = {"fp16", "fp32", "fp64", "bf16"};
 
-const int blast_fpp_bytes[3] = {
-    (int)sizeof(fp16_t), (int)sizeof(fp32_t), (int)sizeof(fp64_t)
+const int blast_fpp_bytes[4] = {
+    (int)sizeof(fp16_t), (int)sizeof(fp32_t), (int)sizeof(fp64_t),
+    (int)sizeof(bf16_t)
+};
+
+const char* blast_format_names[4] = { "q8", "q4", "e4m3", "e5m2" };
+
+const int blast_format_bytes[4] = {
+    (int)sizeof(q8_t), (int)sizeof(q4_t),
+    (int)sizeof(fp8_e4m3_t), (int)sizeof(fp8_e5m2_t)
+};
+
+const int blast_format_block[4] = { quant_block, quant_block, 1, 1 };
+
+// type of accumulated partial sums on the device (see acc_t in blast.cl):
+static const int blast_acc_bytes[4] = {
+    (int)sizeof(fp32_t), (int)sizeof(fp32_t), (int)sizeof(fp64_t),
+    (int)sizeof(fp32_t)
 };
 
 static_assert(blast_access_read  == 0, "order");
@@ -31,26 +51,81 @@ static int blast_map_access_to_ocl[] = {
     ocl_map_rw
 };
 
+static int blast_pool_class(int64_t bytes) {
+    int k = 0;
+    while (((int64_t)blast_pool_min_bytes << k) < bytes) { k++; }
+    return k;
+}
+
+static void blast_pool_init(blast_t* b) {
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    int64_t max_bytes = d->max_groups * d->max_items[0] * sizeof(fp64_t);
+    max_bytes = min(max_bytes,
+        (int64_t)blast_pool_min_bytes << (blast_pool_classes - 1));
+    memset(&b->pool, 0, sizeof(b->pool));
+    b->pool.max_bytes = (int64_t)blast_pool_min_bytes <<
+        blast_pool_class(max_bytes);
+}
+
+static void blast_pool_fini(blast_t* b) {
+    blast_pool_t* p = &b->pool;
+    for (int a = 0; a < countof(p->count); a++) {
+        for (int k = 0; k < blast_pool_classes; k++) {
+            for (int i = 0; i < p->count[a][k]; i++) {
+                ocl.deallocate(p->free[a][k][i]);
+            }
+            p->count[a][k] = 0;
+        }
+    }
+}
+
 static blast_memory_t blast_allocate(blast_t* b, int access, int64_t bytes) {
+    fatal_if(access < blast_access_read || blast_access_rw < access,
+        "access: %d", access);
     blast_memory_t gm;
     gm.m = null;
     gm.b = b;
     gm.s = bytes;
-    gm.h = ocl.allocate(b->c, blast_alloc_access_to_ocl[access], bytes);
+    gm.access = access;
+    blast_pool_t* p = &b->pool;
+    if (bytes <= p->max_bytes) {
+        const int k = blast_pool_class(bytes);
+        if (p->count[access][k] > 0) {
+            gm.h = (void*)p->free[access][k][--p->count[access][k]];
+        } else {
+            gm.h = ocl.allocate(b->c, blast_alloc_access_to_ocl[access],
+                (int64_t)blast_pool_min_bytes << k);
+        }
+    } else {
+        gm.h = ocl.allocate(b->c, blast_alloc_access_to_ocl[access], bytes);
+    }
 //  traceln("%p: %p", bm->h, bm->m);
     return gm;
 }
 
+// Returning the buffer to the pool while kernels that use it are still
+// in flight is safe: the queue is in-order and any following user of the
+// same buffer is enqueued after them.
+
 static void blast_deallocate(blast_memory_t* bm) {
 //  traceln("%p: %p", bm->h, bm->m);
-    ocl.deallocate((ocl_memory_t)bm->h);
-    memset(bm, 0, sizeof(bm));
+    blast_pool_t* p = &bm->b->pool;
+    const int k = bm->s <= p->max_bytes ? blast_pool_class(bm->s) : -1;
+    if (k >= 0 && p->count[bm->access][k] < blast_pool_depth) {
+        p->free[bm->access][k][p->count[bm->access][k]++] =
+            (ocl_memory_t)bm->h;
+    } else {
+        ocl.deallocate((ocl_memory_t)bm->h);
+    }
+    memset(bm, 0, sizeof(*bm));
 }
 
 static void* blast_map(blast_memory_t* bm, int access, int64_t offset,
         int64_t bytes) {
     bm->m = ocl.map(bm->b->c, blast_map_access_to_ocl[access],
         (ocl_memory_t)bm->h, offset, bytes);
+    bm->mo = offset;
+    bm->ms = bytes;
 //  traceln("%p: %p", bm->h, bm->m);
     return bm->m;
 }
@@ -59,6 +134,8 @@ static void blast_unmap(blast_memory_t* bm) {
 //  traceln("%p: %p", bm->h, bm->m);
     ocl.unmap(bm->b->c, (ocl_memory_t)bm->h, bm->m);
     bm->m = null;
+    bm->mo = 0;
+    bm->ms = 0;
 }
 
 // Think about what is known in at compiler time for Parallel Reduction
@@ -78,55 +155,115 @@ static void blast_unmap(blast_memory_t* bm) {
 // and where dot() optimizations may turn to be irrelevant and better
 // handled by AVX2/AVX512.
 
-static void blast_dot_compact(int64_t groups, int64_t items,
-        blast_memory_t* v0, blast_memory_t* v1, blast_memory_t* r, int fpp) {
+// blast_profile_summary() accumulates all profiled kernel invocations
+// of a single blast operation into profiling[0]. Caller must make sure
+// all the kernels have finished (e.g. ocl.finish()).
+
+static void blast_profile_summary(ocl_context_t* c) {
+    if (ocl.is_profiling(c) && c->ov->profiling_count) {
+        ocl_profiling_t* p = &c->ov->profiling[0];
+        ocl.profile(&p[0]);
+        for (int i = 1; i < c->ov->profiling_count; i++) {
+            ocl.profile(&p[i]);
+            p[0].time   += p[i].time;
+            p[0].user   += p[i].user;
+            p[0].gflops += p[i].gflops;
+            p[0].i32ops += p[i].i64ops;
+            p[0].i64ops += p[i].i64ops;
+        }
+        p->gflops /= c->ov->profiling_count;
+        p->i32ops /= c->ov->profiling_count;
+        p->i64ops /= c->ov->profiling_count;
+    }
+}
+
+// blast_dot_partials() enqueues dot_c or dot_os kernel that leaves one
+// partial sum per work-group in r[groups] of acc_t elements.
+// dot_c walks vec4 chunks and requires unit strides and offsets that
+// are multiples of 4, see blast_dot_compact().
+
+static bool blast_dot_compact(int64_t o0, int64_t s0, int64_t o1, int64_t s1) {
+    return s0 == 1 && s1 == 1 && o0 % 4 == 0 && o1 % 4 == 0;
+}
+
+static void blast_dot_partials(int64_t groups, int64_t items,
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        blast_memory_t* r, int fpp) {
     blast_t* b = v0->b;
     ocl_context_t* c = b->c;
-    ocl_arg_t args[] = {
-        {&v0->h, sizeof(ocl_memory_t)},
-        {&v1->h, sizeof(ocl_memory_t)},
-        {&r->h,  sizeof(ocl_memory_t)}
+    const bool compact = blast_dot_compact(o0, s0, o1, s1);
+    int32_t offset0 = (int32_t)o0;
+    int32_t stride0 = (int32_t)s0;
+    int32_t offset1 = (int32_t)o1;
+    int32_t stride1 = (int32_t)s1;
+    int32_t count   = (int32_t)n;
+    ocl_arg_t args_c[] = {
+        {&v0->h,   sizeof(ocl_memory_t)},
+        {&offset0, sizeof(int32_t)},
+        {&v1->h,   sizeof(ocl_memory_t)},
+        {&offset1, sizeof(int32_t)},
+        {&count,   sizeof(int32_t)},
+        {&r->h,    sizeof(ocl_memory_t)},
+        {null,     items * blast_acc_bytes[fpp]} // __local partial[]
+    };
+    ocl_arg_t args_os[] = {
+        {&v0->h,   sizeof(ocl_memory_t)},
+        {&offset0, sizeof(int32_t)},
+        {&stride0, sizeof(int32_t)},
+        {&v1->h,   sizeof(ocl_memory_t)},
+        {&offset1, sizeof(int32_t)},
+        {&stride1, sizeof(int32_t)},
+        {&count,   sizeof(int32_t)},
+        {&r->h,    sizeof(ocl_memory_t)},
+        {null,     items * blast_acc_bytes[fpp]} // __local partial[]
     };
     double user = ocl.is_profiling(c) ? seconds() : 0;
-    ocl_event_t e = ocl.enqueue_range_kernel(c,
-        b->dot_c[fpp], groups, items, countof(args), args);
+    ocl_event_t e = compact ?
+        ocl.enqueue_range_kernel(c, b->dot_c[fpp], groups, items,
+            countof(args_c), args_c) :
+        ocl.enqueue_range_kernel(c, b->dot_os[fpp], groups, items,
+            countof(args_os), args_os);
     user = ocl.is_profiling(c) ? (seconds() - user) : 0;
     if (ocl.is_profiling(c)) {
         ocl_profiling_t* p = ocl.profile_add(c, e);
         p->user = user;
-        p->count = groups * items;
-        p->fops = 1;
+        p->count = n;
+        p->fops = 2;
+        p->i32ops = compact ? 1 : 5; // per element, compact is per vec4
     }
     ocl.release_event(e);
 }
 
-static void blast_dot_strided(int64_t groups, int64_t items,
-        blast_memory_t* v0, int64_t o0, int64_t s0,
-        blast_memory_t* v1, int64_t o1, int64_t s1,
-        blast_memory_t* r,  int fpp) {
-    blast_t* b = v0->b;
+// blast_sum_partials() enqueues a single work-group that adds up
+// partials[0..n-1] into result[offset] as fp_t.
+
+static ocl_event_t blast_sum_partials(blast_memory_t* partials, int64_t n,
+        blast_memory_t* result, int64_t offset, int fpp) {
+    blast_t* b = partials->b;
     ocl_context_t* c = b->c;
+    const int64_t max_items = ocl.devices[c->ix].max_items[0];
+    const int64_t items = min(n, max_items);
+    int32_t count = (int32_t)n;
+    int32_t r_offset = (int32_t)offset;
     ocl_arg_t args[] = {
-        {&v0->h, sizeof(ocl_memory_t)},
-        {&o0,    sizeof(int32_t)},
-        {&s0,    sizeof(int32_t)},
-        {&v1->h, sizeof(ocl_memory_t)},
-        {&o1,    sizeof(int32_t)},
-        {&s1,    sizeof(int32_t)},
-        {&r->h,  sizeof(ocl_memory_t)}
+        {&partials->h, sizeof(ocl_memory_t)},
+        {&count,       sizeof(int32_t)},
+        {&result->h,   sizeof(ocl_memory_t)},
+        {&r_offset,    sizeof(int32_t)},
+        {null,         items * blast_acc_bytes[fpp]} // __local partial[]
     };
     double user = ocl.is_profiling(c) ? seconds() : 0;
-    ocl_event_t e = ocl.enqueue_range_kernel(c, b->dot_os[fpp],
-        groups, items, countof(args), args);
+    ocl_event_t e = ocl.enqueue_range_kernel(c, b->sum_partials[fpp],
+        1, items, countof(args), args);
     user = ocl.is_profiling(c) ? (seconds() - user) : 0;
     if (ocl.is_profiling(c)) {
         ocl_profiling_t* p = ocl.profile_add(c, e);
         p->user = user;
-        p->count = groups * items;
+        p->count = n;
         p->fops = 1;
-        p->i32ops = 4;
     }
-    ocl.release_event(e);
+    return e;
 }
 
 static fp64_t read_1xfp_from_memory(blast_memory_t* m, int fpp) {
@@ -136,121 +273,71 @@ static fp64_t read_1xfp_from_memory(blast_memory_t* m, int fpp) {
         case blast_fpp16: v = fp16to32(*(fp16_t*)a); break;
         case blast_fpp32: v = *(fp32_t*)a; break;
         case blast_fpp64: v = *(fp64_t*)a; break;
+        case blast_fppbf16: v = bf16to32(*(bf16_t*)a); break;
         default: fatal_if("fpp", "%d", fpp); break;
     }
     blast.unmap(m);
     return v;
 }
 
-static fp64_t sum_and_finish(blast_memory_t* v, int64_t items, int64_t groups, int fpp) {
-    blast_t* b = v->b;
-    ocl_context_t* c = b->c;
-    fp64_t sum = 0;
-    int64_t ne = items * groups; // number of elements
-    if (ne == 1) {
-        ocl.finish(c);
-        sum = read_1xfp_from_memory(v, fpp);
-    } else {
-        int64_t n = ne;
-        int64_t m = n / 2;
-        int64_t bytes = ne * blast_fpp_bytes[fpp] / 2; // odd "ne" truncated
-        blast_memory_t  s = blast.allocate(v->b, blast_access_read, bytes);
-        blast_memory_t* v0 = v;
-        blast_memory_t* v1 = &s;
-        const int64_t max_items  = ocl.devices[c->ix].max_items[0];
-        while (m >= 1) {
-            if (m < max_items) {
-                groups = 1; items = m;
-            } else if (groups > 1 && groups % 2 == 0) {
-                groups >>= 1;
-            } else if (items > 1 && items % 2 == 0) {
-                items  >>= 1;
-            } else {
-                assert(false);
-            }
-            assertion(groups * items == m);
-            ocl_arg_t args[] = {
-                {&v0->h,  sizeof(ocl_memory_t)},
-                {&v1->h,  sizeof(ocl_memory_t)}
-            };
-            ocl_kernel_t k = n % 2 == 0 ? b->sum_even[fpp] : b->sum_odd[fpp];
-            double user = ocl.is_profiling(c) ? seconds() : 0;
-            ocl_event_t e = ocl.enqueue_range_kernel(c, k, groups, items,
-                countof(args), args);
-            user = ocl.is_profiling(c) ? (seconds() - user) : 0;
-            if (ocl.is_profiling(c)) {
-                ocl_profiling_t* p = ocl.profile_add(c, e);
-                p->user = user;
-                p->count = ne;
-                p->fops   = 1;
-                p->i32ops = 0;
-            }
-            ocl.release_event(e);
-            blast_memory_t* swap = v0; v0 = v1; v1 = swap;
-            n  = m;
-            m /= 2;
-        }
-        ocl.finish(c); // same as waiting for chain of events
-        sum = read_1xfp_from_memory(v0, fpp);
-        blast.deallocate(&s);
-    }
-    return sum;
-}
+// blast_dot_enqueue() completes in two dispatches: dot_c/dot_os with
+// a grid-stride loop and work-group reduction leaving "groups" partial
+// sums followed by sum_partials that stores fp_t result[offset_r].
+// Returns event of the last kernel.
 
-static fp64_t blast_dot(
+static ocl_event_t blast_dot_enqueue(
         blast_memory_t* v0, int64_t o0, int64_t s0,
         blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
-        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64
-    fatal_if(v0->b != v1->b, "foreign vectors");
-    fatal_if(fpp < blast_fpp16 || blast_fpp64 < fpp, "fpp: %d", fpp);
+        blast_memory_t* result, int64_t offset_r,
+        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64, blast_fppbf16
+    fatal_if(v0->b != v1->b || v0->b != result->b, "foreign memory");
+    fatal_if(fpp < blast_fpp16 || blast_fppbf16 < fpp, "fpp: %d", fpp);
+    fatal_if(n < 1 || s0 < 1 || s1 < 1, "n: %lld s0: %lld s1: %lld", n, s0, s1);
+    fatal_if(o0 < 0 || o1 < 0 || offset_r < 0 || offset_r > INT32_MAX,
+        "o0: %lld o1: %lld offset_r: %lld", o0, o1, offset_r);
+    const int64_t last0 = o0 + (n - 1) * s0;
+    const int64_t last1 = o1 + (n - 1) * s1;
+    fatal_if(last0 > INT32_MAX || last1 > INT32_MAX,
+        "vectors are too large for int32_t offsets");
+    fatal_if((last0 + 1) * blast_fpp_bytes[fpp] > v0->s ||
+             (last1 + 1) * blast_fpp_bytes[fpp] > v1->s,
+        "vectors out of bounds");
+    fatal_if((offset_r + 1) * blast_fpp_bytes[fpp] > result->s,
+        "offset_r: %lld is out of result memory", offset_r);
     blast_t* b = v0->b;
     ocl_context_t* c = b->c;
-    fp64_t s = 0;
     const int64_t max_groups = ocl.devices[c->ix].max_groups;
     const int64_t max_items  = ocl.devices[c->ix].max_items[0];
-    // sum relies on max_* being power of 2
-    assert((max_items  & (max_items  - 1)) == 0);
-    assert((max_groups & (max_groups - 1)) == 0);
     if (ocl.is_profiling(c)) {
         c->ov->profiling_count = 0;
     }
-    size_t bytes = blast_fpp_bytes[fpp];
-    while (n > 0) {
-        int64_t groups = min((n + max_items - 1) / max_items, max_groups);
-        assertion(n >= (groups - 1) * max_items);
-        int64_t ne = groups == 1 ? n : groups * max_items;
-        if (groups > 1 && ne > n) { groups--; ne -= max_items; }
-        int64_t items = ne / groups;
-        assertion(items > 0 && groups > 0 && items * groups <= n);
-        assertion(ne == groups * items);
-        blast_memory_t r = blast.allocate(b, blast_access_read, ne * bytes);
-        if (o0 == 0 && s0 == 1 && o1 == 0 && s1 == 1) {
-            blast_dot_compact(groups, items, v0, v1, &r, fpp);
-        } else {
-//          traceln("offsets: %8lld %8lld strides: %lld %lld ne: %8lld", o0, o1, s0, s1, ne);
-            blast_dot_strided(groups, items, v0, o0, s0, v1, o1, s1, &r, fpp);
-        }
-        s += sum_and_finish(&r, items, groups, fpp);
-        blast.deallocate(&r);
-        n  -= ne;
-        o0 += ne * s0;
-        o1 += ne * s1;
-    }
-    if (ocl.is_profiling(c) && c->ov->profiling_count) {
-        ocl_profiling_t* p = &c->ov->profiling[0];
-        ocl.profile(&p[0]);
-        for (int i = 1; i < c->ov->profiling_count; i++) {
-            ocl.profile(&p[i]);
-            p[0].time   += p[i].time;
-            p[0].user   += p[i].user;
-            p[0].gflops += p[i].gflops;
-            p[0].i32ops += p[i].i64ops;
-            p[0].i64ops += p[i].i64ops;
-        }
-        p->gflops /= c->ov->profiling_count;
-        p->i32ops /= c->ov->profiling_count;
-        p->i64ops /= c->ov->profiling_count;
+    // compact kernel work-items move 4 elements per iteration:
+    const int64_t work   = blast_dot_compact(o0, s0, o1, s1) ? max(n / 4, 1) : n;
+    const int64_t items  = min(work, max_items);
+    const int64_t groups = min((work + items - 1) / items, max_groups);
+    blast_memory_t partials = blast.allocate(b, blast_access_rw,
+        groups * blast_acc_bytes[fpp]);
+    blast_dot_partials(groups, items, v0, o0, s0, v1, o1, s1, n,
+        &partials, fpp);
+    ocl_event_t e = blast_sum_partials(&partials, groups, result, offset_r, fpp);
+    blast.deallocate(&partials); // see note above blast_deallocate()
+    if (ocl.is_profiling(c)) {
+        ocl.finish(c);
+        blast_profile_summary(c);
     }
+    return e;
+}
+
+static fp64_t blast_dot(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64, blast_fppbf16
+    blast_memory_t r = blast.allocate(v0->b, blast_access_rw,
+        blast_fpp_bytes[fpp]);
+    ocl_event_t e = blast_dot_enqueue(v0, o0, s0, v1, o1, s1, n, &r, 0, fpp);
+    ocl.release_event(e);
+    fp64_t s = read_1xfp_from_memory(&r, fpp); // blocking map waits
+    blast.deallocate(&r);
     return s;
 }
 
@@ -272,99 +359,1808 @@ static fp64_t blast_dot_fp64(
     return blast_dot(v0, o0, s0, v1, o1, s1, n, blast_fpp64);
 }
 
-static const char* blast_program_options(blast_t* b, int fpp) {
-    static const char* type_t[] = {"half", "float", "double"};
-    static const char* suffix[] = {"fp16", "fp32", "fp64"};
-    const char* fp_t = type_t[fpp];
-    // see https://man.opencl.org/clBuildProgram.html
-    const ocl_device_t* d = &ocl.devices[b->c->ix];
-    static char options[4096];
-    char* p = options;
-    #pragma push_macro("append")
-    #define append(...) do {                                             \
-        intptr_t k = options + countof(options) - p - 1;                 \
-        fatal_if(k <= 0, "options[%d] overflow", (int)countof(options)); \
-        p += snprintf(p, k, "" __VA_ARGS__);                             \
-    } while (0)
-    append("-D fp16_t=half -D fp32_t=float -D fp64_t=double ");
-    append("-D int32_t=int -D int64_t=long ");
-    append("-cl-std=CL%d.%d ", d->c_version_major, d->c_version_minor);
-    append("-D fp_t=%s -D vec4=%s4 -D vec8=%s8 -D vec16=%s16 -D suffix=%s %s ",
-           fp_t, fp_t,fp_t, fp_t, suffix[fpp],
-          (fpp == blast_fpp16 ? "-D fp16_surrogate" : ""));
-    #pragma pop_macro("append")
-    *p = 0;
-//  traceln("options: %s", options);
-    return options;
+static fp64_t blast_dot_bf16(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n) {
+    return blast_dot(v0, o0, s0, v1, o1, s1, n, blast_fppbf16);
 }
 
-static ocl_program_t blast_compile(blast_t* b, int fpp,
-        const void* code, int bytes) {
-//  traceln("\nfpp: %s\n%*.*s\n\n", blast_fpp_names[fpp], bytes, bytes, code);
-    const char* opts = blast_program_options(b, fpp);
-    return ocl.compile_program(b->c, code, bytes, opts);
-}
+// blast_dot_batch() uploads pairs[] as int32_t descriptors and enqueues
+// dot_batch kernel: a work-group per pair with just enough work-items
+// for the longest pair.
 
-static void blast_init(blast_t* b, ocl_context_t* c) {
-    b->c = c;
-    ocl_device_t* d = &ocl.devices[b->c->ix];
-    void* code = null;
-    int64_t bytes64 = 0;
-    int r = memmap_resource("blast_cl", &code, &bytes64);
-    fatal_if(r != 0 || code == null || bytes64 == 0, "blast.cl in blast.rc?");
-    fatal_if(bytes64 > INT_MAX, "blast.cl %lld bytes", bytes64);
-    int bytes = (int)bytes64;
-    const bool has_fp16 = (d->fp_config & ocl_fp16) != 0;
-    const bool has_fp64 =  d->double_fp_config != 0;
-    ocl_program_t p[3] = {
-        has_fp16 ? blast_compile(b, blast_fpp16, code, bytes) : null,
-        blast_compile(b, blast_fpp32, code, bytes),
-        has_fp64 ? blast_compile(b, blast_fpp64, code, bytes) : null
+static void blast_dot_batch(blast_memory_t* v0, blast_memory_t* v1,
+        const blast_dot_pair_t* pairs, int64_t count,
+        blast_memory_t* result, int64_t offset_r,
+        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64, blast_fppbf16
+    fatal_if(v0->b != v1->b || v0->b != result->b, "foreign memory");
+    fatal_if(fpp < blast_fpp16 || blast_fppbf16 < fpp, "fpp: %d", fpp);
+    fatal_if(count < 1 || offset_r < 0 || offset_r + count > INT32_MAX,
+        "count: %lld offset_r: %lld", count, offset_r);
+    fatal_if((offset_r + count) * blast_fpp_bytes[fpp] > result->s,
+        "offset_r: %lld count: %lld is out of result memory", offset_r, count);
+    blast_t* b = v0->b;
+    ocl_context_t* c = b->c;
+    const int64_t max_groups = ocl.devices[c->ix].max_groups;
+    const int64_t max_items  = ocl.devices[c->ix].max_items[0];
+    const int64_t bytes = count * 5 * sizeof(int32_t);
+    blast_memory_t descriptors = blast.allocate(b, blast_access_write, bytes);
+    int32_t* d = (int32_t*)blast.map(&descriptors, blast_access_write, 0, bytes);
+    int64_t longest = 1;
+    int64_t total = 0; // elements for profiling
+    for (int64_t k = 0; k < count; k++) {
+        const blast_dot_pair_t* p = &pairs[k];
+        fatal_if(p->n < 1 || p->offset0 < 0 || p->stride0 < 1 ||
+                 p->offset1 < 0 || p->stride1 < 1,
+            "pairs[%lld] n: %lld offset0: %lld stride0: %lld "
+            "offset1: %lld stride1: %lld", k, p->n,
+            p->offset0, p->stride0, p->offset1, p->stride1);
+        const int64_t last0 = p->offset0 + (p->n - 1) * p->stride0;
+        const int64_t last1 = p->offset1 + (p->n - 1) * p->stride1;
+        fatal_if(last0 > INT32_MAX || last1 > INT32_MAX,
+            "pairs[%lld] vectors are too large for int32_t offsets", k);
+        fatal_if((last0 + 1) * blast_fpp_bytes[fpp] > v0->s ||
+                 (last1 + 1) * blast_fpp_bytes[fpp] > v1->s,
+            "pairs[%lld] out of bounds", k);
+        d[k * 5 + 0] = (int32_t)p->offset0;
+        d[k * 5 + 1] = (int32_t)p->stride0;
+        d[k * 5 + 2] = (int32_t)p->offset1;
+        d[k * 5 + 3] = (int32_t)p->stride1;
+        d[k * 5 + 4] = (int32_t)p->n;
+        longest = max(longest, p->n);
+        total += p->n;
+    }
+    blast.unmap(&descriptors);
+    int64_t items = 1;
+    while (items * 2 <= max_items && items < longest) { items <<= 1; }
+    const int64_t groups = min(count, max_groups);
+    if (ocl.is_profiling(c)) {
+        c->ov->profiling_count = 0;
+    }
+    int32_t n_pairs  = (int32_t)count;
+    int32_t r_offset = (int32_t)offset_r;
+    ocl_arg_t args[] = {
+        {&v0->h,          sizeof(ocl_memory_t)},
+        {&v1->h,          sizeof(ocl_memory_t)},
+        {&descriptors.h,  sizeof(ocl_memory_t)},
+        {&n_pairs,        sizeof(int32_t)},
+        {&result->h,      sizeof(ocl_memory_t)},
+        {&r_offset,       sizeof(int32_t)},
+        {null,            items * blast_acc_bytes[fpp]} // __local partial[]
     };
-    static const char* sum_odd[]     = {"sum_odd_fp16",     "sum_odd_fp32",     "sum_odd_fp64"};
-    static const char* sum_odd_os[]  = {"sum_odd_os_fp16",  "sum_odd_os_fp32",  "sum_odd_os_fp64"};
-    static const char* sum_even[]    = {"sum_even_fp16",    "sum_even_fp32",    "sum_even_fp64"};
-    static const char* sum_even_os[] = {"sum_even_os_fp16", "sum_even_os_fp32", "sum_even_os_fp64"};
-    static const char* dot[]         = {"dot_fp16",         "dot_fp32",         "dot_fp64"};
-    static const char* dot_os[]      = {"dot_os_fp16",      "dot_os_fp32",      "dot_os_fp64"};
-    static const char* gemv[]        = {"gemv_fp16",        "gemv_fp32",        "gemv_fp64"};
-    static const char* gemv_os[]     = {"gemv_os_fp16",     "gemv_os_fp32",     "gemv_os_fp64"};
-    for (int fp = blast_fpp16; fp <= blast_fpp64; fp++) {
-        if (p[fp] != null) {
-            b->sum_odd[fp]     = ocl.create_kernel(p[fp], sum_odd[fp]);
-            b->sum_odd_os[fp]  = ocl.create_kernel(p[fp], sum_odd_os[fp]);
-            b->sum_even[fp]    = ocl.create_kernel(p[fp], sum_even[fp]);
-            b->sum_even_os[fp] = ocl.create_kernel(p[fp], sum_even_os[fp]);
-            b->dot_c[fp]       = ocl.create_kernel(p[fp], dot[fp]);
-            b->dot_os[fp]      = ocl.create_kernel(p[fp], dot_os[fp]);
-            b->gemv_c[fp]      = ocl.create_kernel(p[fp], gemv[fp]);
-            b->gemv_os[fp]     = ocl.create_kernel(p[fp], gemv_os[fp]);
-            ocl.release_program(p[fp]);
-            switch (fp) {
-                case blast_fpp16: b->dot[fp] = blast_dot_fp16; break;
-                case blast_fpp32: b->dot[fp] = blast_dot_fp32; break;
-                case blast_fpp64: b->dot[fp] = blast_dot_fp64; break;
-                default: fatal_if("never");
-            }
+    double user = ocl.is_profiling(c) ? seconds() : 0;
+    ocl_event_t e = ocl.enqueue_range_kernel(c, b->dot_batch_k[fpp],
+        groups, items, countof(args), args);
+    user = ocl.is_profiling(c) ? (seconds() - user) : 0;
+    if (ocl.is_profiling(c)) {
+        ocl_profiling_t* p = ocl.profile_add(c, e);
+        p->user = user;
+        p->count = total;
+        p->fops = 2;
+        p->i32ops = 5;
+    }
+    ocl.release_event(e);
+    blast.deallocate(&descriptors); // see note above blast_deallocate()
+    if (ocl.is_profiling(c)) {
+        ocl.finish(c);
+        blast_profile_summary(c);
+    }
+}
+
+static void blast_dot_batch_fp16(blast_memory_t* v0, blast_memory_t* v1,
+        const blast_dot_pair_t* pairs, int64_t count,
+        blast_memory_t* r, int64_t offset_r) {
+    blast_dot_batch(v0, v1, pairs, count, r, offset_r, blast_fpp16);
+}
+
+static void blast_dot_batch_fp32(blast_memory_t* v0, blast_memory_t* v1,
+        const blast_dot_pair_t* pairs, int64_t count,
+        blast_memory_t* r, int64_t offset_r) {
+    blast_dot_batch(v0, v1, pairs, count, r, offset_r, blast_fpp32);
+}
+
+static void blast_dot_batch_fp64(blast_memory_t* v0, blast_memory_t* v1,
+        const blast_dot_pair_t* pairs, int64_t count,
+        blast_memory_t* r, int64_t offset_r) {
+    blast_dot_batch(v0, v1, pairs, count, r, offset_r, blast_fpp64);
+}
+
+static void blast_dot_batch_bf16(blast_memory_t* v0, blast_memory_t* v1,
+        const blast_dot_pair_t* pairs, int64_t count,
+        blast_memory_t* r, int64_t offset_r) {
+    blast_dot_batch(v0, v1, pairs, count, r, offset_r, blast_fppbf16);
+}
+
+// gemv() enqueues one work-group per matrix row (see gemv_wg in blast.cl)
+// in chunks of at most max_groups rows. The result is available to
+// the following blast operations or blast.map() without explicit waiting
+// because the command queue is in-order.
+// blast_gemv_rows() is shared with quantized gemv_q() kernels that take
+// the same arguments but express om and sm in blocks. Work-items of a
+// row step over step elements at a time (vec4 or quantized block).
+// Returns event of the last enqueued kernel.
+
+static ocl_event_t blast_gemv_rows(ocl_kernel_t kernel, int64_t step,
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n,
+        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64, blast_fppbf16
+    blast_t* b = mx->b;
+    ocl_context_t* c = b->c;
+    const int64_t max_groups = ocl.devices[c->ix].max_groups;
+    const int64_t max_items  = ocl.devices[c->ix].max_items[0];
+    // enough work-items to cover the row with steps but not more:
+    int64_t items = 1;
+    while (items * 2 <= max_items && items * step < n) { items <<= 1; }
+    if (ocl.is_profiling(c)) {
+        c->ov->profiling_count = 0;
+    }
+    int32_t mx_offset  = (int32_t)om;
+    int32_t row_stride = (int32_t)sm;
+    int32_t v_offset   = (int32_t)ov;
+    int32_t v_stride   = (int32_t)sv;
+    int32_t r_offset   = 0;
+    int32_t columns    = (int32_t)n;
+    ocl_event_t last = null;
+    int64_t row = 0;
+    while (row < m) {
+        int64_t groups = min(m - row, max_groups);
+        ocl_arg_t args[] = {
+            {&mx->h,      sizeof(ocl_memory_t)},
+            {&mx_offset,  sizeof(int32_t)},
+            {&row_stride, sizeof(int32_t)},
+            {&vc->h,      sizeof(ocl_memory_t)},
+            {&v_offset,   sizeof(int32_t)},
+            {&v_stride,   sizeof(int32_t)},
+            {&r->h,       sizeof(ocl_memory_t)},
+            {&r_offset,   sizeof(int32_t)},
+            {&columns,    sizeof(int32_t)},
+            {null,        items * blast_acc_bytes[fpp]} // __local partial[]
+        };
+        double user = ocl.is_profiling(c) ? seconds() : 0;
+        ocl_event_t e = ocl.enqueue_range_kernel(c, kernel,
+            groups, items, countof(args), args);
+        user = ocl.is_profiling(c) ? (seconds() - user) : 0;
+        if (ocl.is_profiling(c)) {
+            ocl_profiling_t* p = ocl.profile_add(c, e);
+            p->user = user;
+            p->count = groups * n;
+            p->fops = 2;
+            p->i32ops = 2;
         }
+        if (last != null) { ocl.release_event(last); }
+        last = e;
+        row += groups;
+        mx_offset += (int32_t)(groups * sm);
+        r_offset  += (int32_t)groups;
+    }
+    if (ocl.is_profiling(c)) {
+        ocl.finish(c);
+        blast_profile_summary(c);
     }
+    return last;
 }
 
-static void blast_fini(blast_t* b) {
-    ocl_device_t* d = &ocl.devices[b->c->ix];
-    // all known GPU support at least fp32_t but many do not support
-    // fp16_t and/or fp64_t
-    int from = (d->fp_config & ocl_fp16) != 0 ? blast_fpp16 : blast_fpp32;
-    int to   =  d->double_fp_config != 0 ? blast_fpp64 : blast_fpp32;
-    for (int fp = from; fp <= to; fp++) {
-        ocl.release_kernel(b->sum_odd[fp]);
-        ocl.release_kernel(b->sum_odd_os[fp]);
-        ocl.release_kernel(b->sum_even[fp]);
-        ocl.release_kernel(b->sum_even_os[fp]);
-        ocl.release_kernel(b->dot_c[fp]);
-        ocl.release_kernel(b->dot_os[fp]);
-        ocl.release_kernel(b->gemv_c[fp]);
-        ocl.release_kernel(b->gemv_os[fp]);
+// blast_gemv_items() enqueues gemv, gemv4 or gemv16 kernel (work-item
+// per row, see blast.cl) in chunks of at most max_groups * items rows.
+// Returns event of the last enqueued kernel.
+
+static ocl_event_t blast_gemv_items(ocl_kernel_t kernel,
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_t* b = mx->b;
+    ocl_context_t* c = b->c;
+    const int64_t max_groups = ocl.devices[c->ix].max_groups;
+    const int64_t max_items  = ocl.devices[c->ix].max_items[0];
+    // small work-groups spread few rows over more compute units:
+    const int64_t items = min(min(m, max_items), 64);
+    if (ocl.is_profiling(c)) {
+        c->ov->profiling_count = 0;
+    }
+    int32_t mx_offset  = (int32_t)om;
+    int32_t row_stride = (int32_t)sm;
+    int32_t v_offset   = (int32_t)ov;
+    int32_t v_stride   = (int32_t)sv;
+    int32_t r_offset   = 0;
+    int32_t columns    = (int32_t)n;
+    ocl_event_t last = null;
+    int64_t row = 0;
+    while (row < m) {
+        int64_t groups = min((m - row + items - 1) / items, max_groups);
+        int32_t rows = (int32_t)min(m - row, groups * items);
+        ocl_arg_t args[] = {
+            {&mx->h,      sizeof(ocl_memory_t)},
+            {&mx_offset,  sizeof(int32_t)},
+            {&row_stride, sizeof(int32_t)},
+            {&vc->h,      sizeof(ocl_memory_t)},
+            {&v_offset,   sizeof(int32_t)},
+            {&v_stride,   sizeof(int32_t)},
+            {&r->h,       sizeof(ocl_memory_t)},
+            {&r_offset,   sizeof(int32_t)},
+            {&rows,       sizeof(int32_t)},
+            {&columns,    sizeof(int32_t)}
+        };
+        double user = ocl.is_profiling(c) ? seconds() : 0;
+        ocl_event_t e = ocl.enqueue_range_kernel(c, kernel,
+            groups, items, countof(args), args);
+        user = ocl.is_profiling(c) ? (seconds() - user) : 0;
+        if (ocl.is_profiling(c)) {
+            ocl_profiling_t* p = ocl.profile_add(c, e);
+            p->user = user;
+            p->count = rows * n;
+            p->fops = 2;
+            p->i32ops = 2;
+        }
+        if (last != null) { ocl.release_event(last); }
+        last = e;
+        row += rows;
+        mx_offset += (int32_t)(rows * sm);
+        r_offset  += rows;
+    }
+    if (ocl.is_profiling(c)) {
+        ocl.finish(c);
+        blast_profile_summary(c);
+    }
+    return last;
+}
+
+// shape class of gemv() kernel variant selection (see blast_crossover_t):
+// few (< 256) or many rows times short (< 1024) or long rows
+
+static int blast_gemv_class(int64_t m, int64_t n) {
+    return (m >= 256 ? 2 : 0) + (n >= 1024 ? 1 : 0);
+}
+
+static ocl_event_t blast_gemv_enqueue(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n,
+        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64, blast_fppbf16
+    fatal_if(mx->b != vc->b || mx->b != r->b, "foreign memory");
+    fatal_if(fpp < blast_fpp16 || blast_fppbf16 < fpp, "fpp: %d", fpp);
+    fatal_if(m < 1 || n < 1 || sm < n || sv < 1,
+        "m: %lld n: %lld stride_m: %lld stride_v: %lld", m, n, sm, sv);
+    fatal_if(om + (m - 1) * sm + n > INT32_MAX || ov + (n - 1) * sv > INT32_MAX,
+        "matrix or vector is too large for int32_t offsets");
+    fatal_if(om < 0 || ov < 0, "offset_m: %lld offset_v: %lld", om, ov);
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    fatal_if((om + (m - 1) * sm + n) * bytes > mx->s, "matrix out of bounds");
+    fatal_if((ov + (n - 1) * sv + 1) * bytes > vc->s, "vector out of bounds");
+    fatal_if(m * bytes > r->s, "result out of bounds");
+    blast_t* b = mx->b;
+    ocl_kernel_t items[] = { null, b->gemv_c[fpp], b->gemv4_c[fpp],
+                             b->gemv16_c[fpp] }; // [blast_gemv_*]
+    const int variant = b->crossover.gemv_variant[fpp][blast_gemv_class(m, n)];
+    assert(blast_gemv_wg <= variant && variant <= blast_gemv_item16,
+        "variant: %d", variant);
+    return variant == blast_gemv_wg ?
+        blast_gemv_rows(b->gemv_wg[fpp], 4, mx, om, sm, vc, ov, sv,
+            r, m, n, fpp) :
+        blast_gemv_items(items[variant], mx, om, sm, vc, ov, sv, r, m, n);
+}
+
+static void blast_gemv(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n,
+        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64, blast_fppbf16
+    ocl.release_event(blast_gemv_enqueue(mx, om, sm, vc, ov, sv, r, m, n, fpp));
+}
+
+static void blast_gemv_fp16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv(mx, om, sm, vc, ov, sv, r, m, n, blast_fpp16);
+}
+
+static void blast_gemv_fp32(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv(mx, om, sm, vc, ov, sv, r, m, n, blast_fpp32);
+}
+
+static void blast_gemv_fp64(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv(mx, om, sm, vc, ov, sv, r, m, n, blast_fpp64);
+}
+
+static void blast_gemv_bf16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv(mx, om, sm, vc, ov, sv, r, m, n, blast_fppbf16);
+}
+
+// gemv_q() multiplies quantized matrix by fpp vector. Offsets and
+// strides of the matrix are in elements and must be multiples of
+// blast_format_block[format], kernels see them in blocks.
+
+static_assertion(quant_block == 32); // hardcoded in blast.cl
+
+static void blast_gemv_q(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n,
+        int format, int fpp) {
+    fatal_if(mx->b != vc->b || mx->b != r->b, "foreign memory");
+    fatal_if(format < blast_format_q8 || blast_format_e5m2 < format,
+        "format: %d", format);
+    fatal_if(fpp < blast_fpp16 || blast_fppbf16 < fpp, "fpp: %d", fpp);
+    fatal_if(m < 1 || n < 1 || sm < n || sv < 1,
+        "m: %lld n: %lld stride_m: %lld stride_v: %lld", m, n, sm, sv);
+    const int64_t block = blast_format_block[format];
+    fatal_if(om % block != 0 || sm % block != 0 ||
+             n % block != 0, "offset_m: %lld stride_m: %lld n: %lld "
+             "must be multiples of %lld", om, sm, n, block);
+    fatal_if((om + (m - 1) * sm + n) / block > INT32_MAX ||
+             ov + (n - 1) * sv > INT32_MAX,
+        "matrix or vector is too large for int32_t offsets");
+    fatal_if(om < 0 || ov < 0, "offset_m: %lld offset_v: %lld", om, ov);
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    fatal_if((om + (m - 1) * sm + n) / block *
+             blast_format_bytes[format] > mx->s, "matrix out of bounds");
+    fatal_if((ov + (n - 1) * sv + 1) * bytes > vc->s, "vector out of bounds");
+    fatal_if(m * bytes > r->s, "result out of bounds");
+    // at least 4 fp8 elements per work-item, short rows use fewer items:
+    const int64_t step = block == 1 ? 4 : block;
+    ocl.release_event(blast_gemv_rows(mx->b->gemv_q_k[format][fpp],
+        step, mx, om / block, sm / block, vc, ov, sv, r, m, n, fpp));
+}
+
+static void blast_gemv_q8_fp16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_q8, blast_fpp16);
+}
+
+static void blast_gemv_q8_fp32(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_q8, blast_fpp32);
+}
+
+static void blast_gemv_q8_fp64(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_q8, blast_fpp64);
+}
+
+static void blast_gemv_q8_bf16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_q8, blast_fppbf16);
+}
+
+static void blast_gemv_q4_fp16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_q4, blast_fpp16);
+}
+
+static void blast_gemv_q4_fp32(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_q4, blast_fpp32);
+}
+
+static void blast_gemv_q4_fp64(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_q4, blast_fpp64);
+}
+
+static void blast_gemv_q4_bf16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_q4, blast_fppbf16);
+}
+
+static void blast_gemv_e4m3_fp16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_e4m3, blast_fpp16);
+}
+
+static void blast_gemv_e4m3_fp32(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_e4m3, blast_fpp32);
+}
+
+static void blast_gemv_e4m3_fp64(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_e4m3, blast_fpp64);
+}
+
+static void blast_gemv_e4m3_bf16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_e4m3, blast_fppbf16);
+}
+
+static void blast_gemv_e5m2_fp16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_e5m2, blast_fpp16);
+}
+
+static void blast_gemv_e5m2_fp32(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_e5m2, blast_fpp32);
+}
+
+static void blast_gemv_e5m2_fp64(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_e5m2, blast_fpp64);
+}
+
+static void blast_gemv_e5m2_bf16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_q(mx, om, sm, vc, ov, sv, r, m, n, blast_format_e5m2, blast_fppbf16);
+}
+
+// gemv_batch() enqueues a work-group per matrix row (see gemv_batch in
+// blast.cl) in chunks of at most max_groups rows. Each work-group reduces
+// k sums of all its items in local memory, so the work-group size is
+// limited by local memory too.
+
+static void blast_gemv_batch(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv, int64_t sb,
+        blast_memory_t* r,  int64_t sr,
+        int64_t m, int64_t n, int64_t k,
+        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64, blast_fppbf16
+    fatal_if(mx->b != vc->b || mx->b != r->b, "foreign memory");
+    fatal_if(fpp < blast_fpp16 || blast_fppbf16 < fpp, "fpp: %d", fpp);
+    fatal_if(m < 1 || n < 1 || k < 1 || k > blast_batch_max || sm < n ||
+             sv < 1 || sb < 0 || (k > 1 && sr < m),
+        "m: %lld n: %lld k: %lld stride_m: %lld stride_v: %lld "
+        "stride_b: %lld stride_r: %lld", m, n, k, sm, sv, sb, sr);
+    fatal_if(om + (m - 1) * sm + n > INT32_MAX ||
+             ov + (n - 1) * sv + (k - 1) * sb > INT32_MAX ||
+             (k - 1) * sr + m > INT32_MAX,
+        "matrix or vectors are too large for int32_t offsets");
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    fatal_if((om + (m - 1) * sm + n) * bytes > mx->s, "matrix out of bounds");
+    fatal_if((ov + (n - 1) * sv + (k - 1) * sb + 1) * bytes > vc->s,
+        "vectors out of bounds");
+    fatal_if(((k - 1) * sr + m) * bytes > r->s, "result out of bounds");
+    blast_t* b = mx->b;
+    ocl_context_t* c = b->c;
+    const ocl_device_t* d = &ocl.devices[c->ix];
+    const int64_t max_groups = d->max_groups;
+    const int64_t max_items  = d->max_items[0];
+    const int64_t acc_bytes  = blast_acc_bytes[fpp];
+    // enough work-items to cover the row but not more:
+    int64_t items = 1;
+    while (items * 2 <= max_items && items * 2 <= 256 && items < n &&
+           k * items * 2 * acc_bytes <= d->local_memory) {
+        items <<= 1;
+    }
+    if (ocl.is_profiling(c)) {
+        c->ov->profiling_count = 0;
+    }
+    int32_t mx_offset  = (int32_t)om;
+    int32_t row_stride = (int32_t)sm;
+    int32_t v_offset   = (int32_t)ov;
+    int32_t v_stride   = (int32_t)sv;
+    int32_t b_stride   = (int32_t)sb;
+    int32_t r_offset   = 0;
+    int32_t r_stride   = (int32_t)sr;
+    int32_t columns    = (int32_t)n;
+    int32_t vectors    = (int32_t)k;
+    int64_t row = 0;
+    while (row < m) {
+        int64_t groups = min(m - row, max_groups);
+        ocl_arg_t args[] = {
+            {&mx->h,      sizeof(ocl_memory_t)},
+            {&mx_offset,  sizeof(int32_t)},
+            {&row_stride, sizeof(int32_t)},
+            {&vc->h,      sizeof(ocl_memory_t)},
+            {&v_offset,   sizeof(int32_t)},
+            {&v_stride,   sizeof(int32_t)},
+            {&b_stride,   sizeof(int32_t)},
+            {&r->h,       sizeof(ocl_memory_t)},
+            {&r_offset,   sizeof(int32_t)},
+            {&r_stride,   sizeof(int32_t)},
+            {&columns,    sizeof(int32_t)},
+            {&vectors,    sizeof(int32_t)},
+            {null,        k * items * acc_bytes} // __local partial[]
+        };
+        double user = ocl.is_profiling(c) ? seconds() : 0;
+        ocl_event_t e = ocl.enqueue_range_kernel(c, b->gemv_batch_k[fpp],
+            groups, items, countof(args), args);
+        user = ocl.is_profiling(c) ? (seconds() - user) : 0;
+        if (ocl.is_profiling(c)) {
+            ocl_profiling_t* p = ocl.profile_add(c, e);
+            p->user = user;
+            p->count = groups * n * k;
+            p->fops = 2;
+            p->i32ops = 2;
+        }
+        ocl.release_event(e);
+        row += groups;
+        mx_offset += (int32_t)(groups * sm);
+        r_offset  += (int32_t)groups;
+    }
+    if (ocl.is_profiling(c)) {
+        ocl.finish(c);
+        blast_profile_summary(c);
+    }
+}
+
+static void blast_gemv_batch_fp16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv, int64_t sb,
+        blast_memory_t* r,  int64_t sr, int64_t m, int64_t n, int64_t k) {
+    blast_gemv_batch(mx, om, sm, vc, ov, sv, sb, r, sr, m, n, k, blast_fpp16);
+}
+
+static void blast_gemv_batch_fp32(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv, int64_t sb,
+        blast_memory_t* r,  int64_t sr, int64_t m, int64_t n, int64_t k) {
+    blast_gemv_batch(mx, om, sm, vc, ov, sv, sb, r, sr, m, n, k, blast_fpp32);
+}
+
+static void blast_gemv_batch_fp64(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv, int64_t sb,
+        blast_memory_t* r,  int64_t sr, int64_t m, int64_t n, int64_t k) {
+    blast_gemv_batch(mx, om, sm, vc, ov, sv, sb, r, sr, m, n, k, blast_fpp64);
+}
+
+static void blast_gemv_batch_bf16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv, int64_t sb,
+        blast_memory_t* r,  int64_t sr, int64_t m, int64_t n, int64_t k) {
+    blast_gemv_batch(mx, om, sm, vc, ov, sv, sb, r, sr, m, n, k, blast_fppbf16);
+}
+
+// Asynchronous versions of dot() and gemv() do not wait for the kernels.
+// The returned blast_event_t must be passed to blast.wait() exactly once.
+
+static blast_event_t blast_dot_async_fp16(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        blast_memory_t* r, int64_t offset_r) {
+    return (blast_event_t){ .e = blast_dot_enqueue(v0, o0, s0, v1, o1, s1, n,
+        r, offset_r, blast_fpp16) };
+}
+
+static blast_event_t blast_dot_async_fp32(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        blast_memory_t* r, int64_t offset_r) {
+    return (blast_event_t){ .e = blast_dot_enqueue(v0, o0, s0, v1, o1, s1, n,
+        r, offset_r, blast_fpp32) };
+}
+
+static blast_event_t blast_dot_async_fp64(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        blast_memory_t* r, int64_t offset_r) {
+    return (blast_event_t){ .e = blast_dot_enqueue(v0, o0, s0, v1, o1, s1, n,
+        r, offset_r, blast_fpp64) };
+}
+
+static blast_event_t blast_dot_async_bf16(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        blast_memory_t* r, int64_t offset_r) {
+    return (blast_event_t){ .e = blast_dot_enqueue(v0, o0, s0, v1, o1, s1, n,
+        r, offset_r, blast_fppbf16) };
+}
+
+static blast_event_t blast_gemv_async_fp16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    return (blast_event_t){ .e = blast_gemv_enqueue(mx, om, sm, vc, ov, sv,
+        r, m, n, blast_fpp16) };
+}
+
+static blast_event_t blast_gemv_async_fp32(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    return (blast_event_t){ .e = blast_gemv_enqueue(mx, om, sm, vc, ov, sv,
+        r, m, n, blast_fpp32) };
+}
+
+static blast_event_t blast_gemv_async_fp64(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    return (blast_event_t){ .e = blast_gemv_enqueue(mx, om, sm, vc, ov, sv,
+        r, m, n, blast_fpp64) };
+}
+
+static blast_event_t blast_gemv_async_bf16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    return (blast_event_t){ .e = blast_gemv_enqueue(mx, om, sm, vc, ov, sv,
+        r, m, n, blast_fppbf16) };
+}
+
+// Level 1 element-wise operations enqueue a single kernel (see Level 1
+// kernels in blast.cl) on at most max_groups work-groups. Compact
+// kernels are used when both strides are 1.
+
+enum { blast_l1_copy, blast_l1_swap, blast_l1_scal, blast_l1_axpy, blast_l1_rot };
+
+typedef union blast_scalar_u { // acc_t kernel argument
+    fp32_t f32;
+    fp64_t f64;
+} blast_scalar_t;
+
+static blast_scalar_t blast_scalar(fp64_t v, int fpp) {
+    blast_scalar_t s = { 0 };
+    if (blast_acc_bytes[fpp] == sizeof(fp64_t)) {
+        s.f64 = v;
+    } else {
+        s.f32 = (fp32_t)v;
+    }
+    return s;
+}
+
+static void blast_l1_check(blast_memory_t* v, int64_t o, int64_t s,
+        int64_t n, int fpp) {
+    fatal_if(o < 0 || s < 1, "offset: %lld stride: %lld", o, s);
+    fatal_if(o + (n - 1) * s > INT32_MAX,
+        "vector is too large for int32_t offsets");
+    fatal_if((o + (n - 1) * s + 1) * blast_fpp_bytes[fpp] > v->s,
+        "offset: %lld stride: %lld n: %lld out of bounds", o, s, n);
+}
+
+static void blast_l1(int op, fp64_t a, fp64_t s,
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n,
+        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64, blast_fppbf16
+    const bool binary = op != blast_l1_scal; // has y
+    fatal_if(binary && x->b != y->b, "foreign memory");
+    fatal_if(fpp < blast_fpp16 || blast_fppbf16 < fpp, "fpp: %d", fpp);
+    fatal_if(n < 1 || n > INT32_MAX, "n: %lld", n);
+    blast_l1_check(x, ox, sx, n, fpp);
+    if (binary) { blast_l1_check(y, oy, sy, n, fpp); }
+    blast_t* b = x->b;
+    ocl_context_t* c = b->c;
+    const bool compact = sx == 1 && (!binary || sy == 1);
+    ocl_kernel_t* kernels[][2] = {
+        { b->copy_c, b->copy_os },
+        { b->swap_c, b->swap_os },
+        { b->scal_c, b->scal_os },
+        { b->mad_c,  b->mad_os  },
+        { b->rot_c,  b->rot_os  }
+    };
+    ocl_kernel_t k = kernels[op][compact ? 0 : 1][fpp];
+    blast_scalar_t alpha = blast_scalar(a, fpp);
+    blast_scalar_t sine  = blast_scalar(s, fpp);
+    int32_t offset_x = (int32_t)ox;
+    int32_t stride_x = (int32_t)sx;
+    int32_t offset_y = (int32_t)oy;
+    int32_t stride_y = (int32_t)sy;
+    int32_t count    = (int32_t)n;
+    ocl_arg_t args[9];
+    int argc = 0;
+    if (op == blast_l1_scal || op == blast_l1_axpy || op == blast_l1_rot) {
+        args[argc++] = (ocl_arg_t){&alpha, blast_acc_bytes[fpp]};
+    }
+    if (op == blast_l1_rot) {
+        args[argc++] = (ocl_arg_t){&sine, blast_acc_bytes[fpp]};
+    }
+    args[argc++] = (ocl_arg_t){&x->h, sizeof(ocl_memory_t)};
+    args[argc++] = (ocl_arg_t){&offset_x, sizeof(int32_t)};
+    if (!compact) { args[argc++] = (ocl_arg_t){&stride_x, sizeof(int32_t)}; }
+    if (binary) {
+        args[argc++] = (ocl_arg_t){&y->h, sizeof(ocl_memory_t)};
+        args[argc++] = (ocl_arg_t){&offset_y, sizeof(int32_t)};
+        if (!compact) { args[argc++] = (ocl_arg_t){&stride_y, sizeof(int32_t)}; }
+    }
+    args[argc++] = (ocl_arg_t){&count, sizeof(int32_t)};
+    const int64_t max_groups = ocl.devices[c->ix].max_groups;
+    const int64_t max_items  = ocl.devices[c->ix].max_items[0];
+    // compact kernels move 4 elements per work-item iteration:
+    const int64_t work   = compact ? max(n / 4, 1) : n;
+    const int64_t items  = min(work, max_items);
+    const int64_t groups = min((work + items - 1) / items, max_groups);
+    if (ocl.is_profiling(c)) {
+        c->ov->profiling_count = 0;
+    }
+    double user = ocl.is_profiling(c) ? seconds() : 0;
+    ocl_event_t e = ocl.enqueue_range_kernel(c, k, groups, items, argc, args);
+    user = ocl.is_profiling(c) ? (seconds() - user) : 0;
+    if (ocl.is_profiling(c)) {
+        static const int fops[] = { 0, 0, 1, 2, 6 };
+        ocl_profiling_t* p = ocl.profile_add(c, e);
+        p->user = user;
+        p->count = n;
+        p->fops = fops[op];
+        p->i32ops = compact ? 1 : 3;
+    }
+    ocl.release_event(e);
+    if (ocl.is_profiling(c)) {
+        ocl.finish(c);
+        blast_profile_summary(c);
+    }
+}
+
+static void blast_axpy_fp16(fp64_t a,
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_axpy, a, 0, x, ox, sx, y, oy, sy, n, blast_fpp16);
+}
+
+static void blast_axpy_fp32(fp64_t a,
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_axpy, a, 0, x, ox, sx, y, oy, sy, n, blast_fpp32);
+}
+
+static void blast_axpy_fp64(fp64_t a,
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_axpy, a, 0, x, ox, sx, y, oy, sy, n, blast_fpp64);
+}
+
+static void blast_axpy_bf16(fp64_t a,
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_axpy, a, 0, x, ox, sx, y, oy, sy, n, blast_fppbf16);
+}
+
+static void blast_scal_fp16(fp64_t a,
+        blast_memory_t* x, int64_t ox, int64_t sx, int64_t n) {
+    blast_l1(blast_l1_scal, a, 0, x, ox, sx, null, 0, 0, n, blast_fpp16);
+}
+
+static void blast_scal_fp32(fp64_t a,
+        blast_memory_t* x, int64_t ox, int64_t sx, int64_t n) {
+    blast_l1(blast_l1_scal, a, 0, x, ox, sx, null, 0, 0, n, blast_fpp32);
+}
+
+static void blast_scal_fp64(fp64_t a,
+        blast_memory_t* x, int64_t ox, int64_t sx, int64_t n) {
+    blast_l1(blast_l1_scal, a, 0, x, ox, sx, null, 0, 0, n, blast_fpp64);
+}
+
+static void blast_scal_bf16(fp64_t a,
+        blast_memory_t* x, int64_t ox, int64_t sx, int64_t n) {
+    blast_l1(blast_l1_scal, a, 0, x, ox, sx, null, 0, 0, n, blast_fppbf16);
+}
+
+static void blast_copy_fp16(
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_copy, 0, 0, x, ox, sx, y, oy, sy, n, blast_fpp16);
+}
+
+static void blast_copy_fp32(
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_copy, 0, 0, x, ox, sx, y, oy, sy, n, blast_fpp32);
+}
+
+static void blast_copy_fp64(
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_copy, 0, 0, x, ox, sx, y, oy, sy, n, blast_fpp64);
+}
+
+static void blast_copy_bf16(
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_copy, 0, 0, x, ox, sx, y, oy, sy, n, blast_fppbf16);
+}
+
+static void blast_swap_fp16(
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_swap, 0, 0, x, ox, sx, y, oy, sy, n, blast_fpp16);
+}
+
+static void blast_swap_fp32(
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_swap, 0, 0, x, ox, sx, y, oy, sy, n, blast_fpp32);
+}
+
+static void blast_swap_fp64(
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_swap, 0, 0, x, ox, sx, y, oy, sy, n, blast_fpp64);
+}
+
+static void blast_swap_bf16(
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_swap, 0, 0, x, ox, sx, y, oy, sy, n, blast_fppbf16);
+}
+
+static void blast_rot_fp16(fp64_t c, fp64_t s,
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_rot, c, s, x, ox, sx, y, oy, sy, n, blast_fpp16);
+}
+
+static void blast_rot_fp32(fp64_t c, fp64_t s,
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_rot, c, s, x, ox, sx, y, oy, sy, n, blast_fpp32);
+}
+
+static void blast_rot_fp64(fp64_t c, fp64_t s,
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_rot, c, s, x, ox, sx, y, oy, sy, n, blast_fpp64);
+}
+
+static void blast_rot_bf16(fp64_t c, fp64_t s,
+        blast_memory_t* x, int64_t ox, int64_t sx,
+        blast_memory_t* y, int64_t oy, int64_t sy, int64_t n) {
+    blast_l1(blast_l1_rot, c, s, x, ox, sx, y, oy, sy, n, blast_fppbf16);
+}
+
+// blast_reduce() enqueues a reduction kernel (see Level 1 reductions in
+// blast.cl) that leaves "groups" partial results followed by a single
+// work-group that combines them into result[offset_r].
+
+enum { blast_reduce_sum, blast_reduce_asum, blast_reduce_nrm2,
+       blast_reduce_iamax, blast_reduce_iamin };
+
+static void blast_reduce(int op,
+        blast_memory_t* x, int64_t ox, int64_t sx, int64_t n,
+        blast_memory_t* result, int64_t offset_r,
+        int fpp) { // blast_fpp16, blast_fpp32, blast_fpp64, blast_fppbf16
+    const bool index = op == blast_reduce_iamax || op == blast_reduce_iamin;
+    const int64_t bytes_r = index ? sizeof(int32_t) : blast_fpp_bytes[fpp];
+    fatal_if(x->b != result->b, "foreign memory");
+    fatal_if(fpp < blast_fpp16 || blast_fppbf16 < fpp, "fpp: %d", fpp);
+    fatal_if(n < 1 || n > INT32_MAX, "n: %lld", n);
+    blast_l1_check(x, ox, sx, n, fpp);
+    fatal_if(offset_r < 0 || (offset_r + 1) * bytes_r > result->s,
+        "offset_r: %lld is out of result memory", offset_r);
+    blast_t* b = x->b;
+    ocl_context_t* c = b->c;
+    const int64_t max_groups = ocl.devices[c->ix].max_groups;
+    const int64_t max_items  = ocl.devices[c->ix].max_items[0];
+    const int64_t acc_bytes  = blast_acc_bytes[fpp];
+    if (ocl.is_profiling(c)) {
+        c->ov->profiling_count = 0;
+    }
+    const int64_t items  = min(n, max_items);
+    const int64_t groups = min((n + items - 1) / items, max_groups);
+    const int64_t pairs  = op == blast_reduce_nrm2 ? 2 : 1; // acc_t per group
+    blast_memory_t pv = blast.allocate(b, blast_access_rw,
+        groups * pairs * acc_bytes);
+    blast_memory_t pk = { 0 }; // partial indices of iamax() and iamin()
+    if (index) {
+        pk = blast.allocate(b, blast_access_rw, groups * sizeof(int32_t));
+    }
+    int32_t offset_x = (int32_t)ox;
+    int32_t stride_x = (int32_t)sx;
+    int32_t count    = (int32_t)n;
+    int32_t partials = (int32_t)groups;
+    int32_t r_offset = (int32_t)offset_r;
+    ocl_kernel_t kernels[][2] = { // [op][pass]
+        { b->sum_os[fpp],   b->sum_partials[fpp]   },
+        { b->asum_os[fpp],  b->sum_partials[fpp]   },
+        { b->nrm2_os[fpp],  b->nrm2_partials[fpp]  },
+        { b->iamax_os[fpp], b->iamax_partials[fpp] },
+        { b->iamin_os[fpp], b->iamin_partials[fpp] }
+    };
+    const int64_t items2 = min(groups, max_items);
+    ocl_arg_t args0[8]; // x, ox, sx, n, pv, [pk], __local pv[], [pk[]]
+    int argc0 = 0;
+    args0[argc0++] = (ocl_arg_t){&x->h,     sizeof(ocl_memory_t)};
+    args0[argc0++] = (ocl_arg_t){&offset_x, sizeof(int32_t)};
+    args0[argc0++] = (ocl_arg_t){&stride_x, sizeof(int32_t)};
+    args0[argc0++] = (ocl_arg_t){&count,    sizeof(int32_t)};
+    args0[argc0++] = (ocl_arg_t){&pv.h,     sizeof(ocl_memory_t)};
+    if (index) { args0[argc0++] = (ocl_arg_t){&pk.h, sizeof(ocl_memory_t)}; }
+    args0[argc0++] = (ocl_arg_t){null, items * pairs * acc_bytes};
+    if (index) { args0[argc0++] = (ocl_arg_t){null, items * sizeof(int32_t)}; }
+    ocl_arg_t args1[7]; // pv, [pk], groups, r, offset, __local pv[], [pk[]]
+    int argc1 = 0;
+    args1[argc1++] = (ocl_arg_t){&pv.h,      sizeof(ocl_memory_t)};
+    if (index) { args1[argc1++] = (ocl_arg_t){&pk.h, sizeof(ocl_memory_t)}; }
+    args1[argc1++] = (ocl_arg_t){&partials,  sizeof(int32_t)};
+    args1[argc1++] = (ocl_arg_t){&result->h, sizeof(ocl_memory_t)};
+    args1[argc1++] = (ocl_arg_t){&r_offset,  sizeof(int32_t)};
+    args1[argc1++] = (ocl_arg_t){null, items2 * pairs * acc_bytes};
+    if (index) { args1[argc1++] = (ocl_arg_t){null, items2 * sizeof(int32_t)}; }
+    double user = ocl.is_profiling(c) ? seconds() : 0;
+    ocl_event_t e0 = ocl.enqueue_range_kernel(c, kernels[op][0],
+        groups, items, argc0, args0);
+    ocl_event_t e1 = ocl.enqueue_range_kernel(c, kernels[op][1],
+        1, items2, argc1, args1);
+    user = ocl.is_profiling(c) ? (seconds() - user) : 0;
+    if (ocl.is_profiling(c)) {
+        ocl_profiling_t* p = ocl.profile_add(c, e0);
+        p->user = user;
+        p->count = n;
+        p->fops = op == blast_reduce_nrm2 ? 4 : 1;
+        p->i32ops = 3;
+        p = ocl.profile_add(c, e1);
+        p->count = groups;
+        p->fops = op == blast_reduce_nrm2 ? 4 : 1;
+    }
+    ocl.release_event(e0);
+    ocl.release_event(e1);
+    if (index) { blast.deallocate(&pk); } // see note above blast_deallocate()
+    blast.deallocate(&pv);
+    if (ocl.is_profiling(c)) {
+        ocl.finish(c);
+        blast_profile_summary(c);
+    }
+}
+
+static void blast_sum_fp16(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_sum, x, ox, sx, n, r, offset_r, blast_fpp16);
+}
+
+static void blast_sum_fp32(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_sum, x, ox, sx, n, r, offset_r, blast_fpp32);
+}
+
+static void blast_sum_fp64(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_sum, x, ox, sx, n, r, offset_r, blast_fpp64);
+}
+
+static void blast_sum_bf16(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_sum, x, ox, sx, n, r, offset_r, blast_fppbf16);
+}
+
+static void blast_asum_fp16(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_asum, x, ox, sx, n, r, offset_r, blast_fpp16);
+}
+
+static void blast_asum_fp32(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_asum, x, ox, sx, n, r, offset_r, blast_fpp32);
+}
+
+static void blast_asum_fp64(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_asum, x, ox, sx, n, r, offset_r, blast_fpp64);
+}
+
+static void blast_asum_bf16(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_asum, x, ox, sx, n, r, offset_r, blast_fppbf16);
+}
+
+static void blast_nrm2_fp16(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_nrm2, x, ox, sx, n, r, offset_r, blast_fpp16);
+}
+
+static void blast_nrm2_fp32(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_nrm2, x, ox, sx, n, r, offset_r, blast_fpp32);
+}
+
+static void blast_nrm2_fp64(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_nrm2, x, ox, sx, n, r, offset_r, blast_fpp64);
+}
+
+static void blast_nrm2_bf16(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_nrm2, x, ox, sx, n, r, offset_r, blast_fppbf16);
+}
+
+static void blast_iamax_fp16(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_iamax, x, ox, sx, n, r, offset_r, blast_fpp16);
+}
+
+static void blast_iamax_fp32(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_iamax, x, ox, sx, n, r, offset_r, blast_fpp32);
+}
+
+static void blast_iamax_fp64(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_iamax, x, ox, sx, n, r, offset_r, blast_fpp64);
+}
+
+static void blast_iamax_bf16(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_iamax, x, ox, sx, n, r, offset_r, blast_fppbf16);
+}
+
+static void blast_iamin_fp16(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_iamin, x, ox, sx, n, r, offset_r, blast_fpp16);
+}
+
+static void blast_iamin_fp32(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_iamin, x, ox, sx, n, r, offset_r, blast_fpp32);
+}
+
+static void blast_iamin_fp64(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_iamin, x, ox, sx, n, r, offset_r, blast_fpp64);
+}
+
+static void blast_iamin_bf16(blast_memory_t* x, int64_t ox, int64_t sx,
+        int64_t n, blast_memory_t* r, int64_t offset_r) {
+    blast_reduce(blast_reduce_iamin, x, ox, sx, n, r, offset_r, blast_fppbf16);
+}
+
+static void blast_wait(blast_event_t* e) {
+    fatal_if(e->e == null, "already waited for or never started");
+    ocl.wait(&e->e, 1);
+    ocl.release_event(e->e);
+    e->e = null;
+}
+
+static bool blast_poll(blast_event_t* e) {
+    fatal_if(e->e == null, "already waited for or never started");
+    return ocl.poll(e->e);
+}
+
+static void blast_then(blast_event_t* e, void (*done)(void* that), void* that) {
+    fatal_if(e->e == null, "already waited for or never started");
+    ocl.notify(e->e, done, that);
+}
+
+static const char* blast_program_options(blast_t* b, int fpp) {
+    static const char* type_t[] = {"half", "float", "double", "ushort"};
+    static const char* suffix[] = {"fp16", "fp32", "fp64", "bf16"};
+    const char* fp_t = type_t[fpp];
+    // see https://man.opencl.org/clBuildProgram.html
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    static char options[4096];
+    char* p = options;
+    #pragma push_macro("append")
+    #define append(...) do {                                             \
+        intptr_t k = options + countof(options) - p - 1;                 \
+        fatal_if(k <= 0, "options[%d] overflow", (int)countof(options)); \
+        p += snprintf(p, k, "" __VA_ARGS__);                             \
+    } while (0)
+    append("-D fp16_t=half -D fp32_t=float -D fp64_t=double ");
+    append("-D int32_t=int -D int64_t=long ");
+    append("-cl-std=CL%d.%d ", d->c_version_major, d->c_version_minor);
+    append("-D fp_t=%s -D vec4=%s4 -D vec8=%s8 -D vec16=%s16 -D suffix=%s %s ",
+           fp_t, fp_t,fp_t, fp_t, suffix[fpp],
+          (fpp == blast_fpp16   ? "-D fp16_surrogate" :
+           fpp == blast_fppbf16 ? "-D bf16_surrogate" : ""));
+    #pragma pop_macro("append")
+    *p = 0;
+//  traceln("options: %s", options);
+    return options;
+}
+
+// Compiled programs are cached on disk in the folder named by BLAST_CACHE
+// environment variable (or TEMP, TMPDIR) as blast_<key>.bin files.
+// The key is a hash of device name, driver version, build options and
+// the kernels source, thus any change of those misses the cache.
+// Corrupted or rejected cache entries are recompiled and overwritten.
+
+static uint64_t blast_hash(uint64_t h, const void* data, size_t bytes) {
+    const byte_t* a = (const byte_t*)data; // FNV-1a
+    for (size_t i = 0; i < bytes; i++) { h = (h ^ a[i]) * 0x100000001B3uLL; }
+    return h;
+}
+
+static const uint64_t blast_hash_seed = 0xCBF29CE484222325uLL;
+
+static const char* blast_cache_path(char* path, int count,
+        uint64_t key, const char* ext) {
+    const char* folder = getenv("BLAST_CACHE");
+    if (folder == null) { folder = getenv("TEMP"); }
+    if (folder == null) { folder = getenv("TMPDIR"); }
+    if (folder == null) { folder = "."; }
+    snprintf(path, count, "%s/blast_%016llX.%s", folder,
+        (unsigned long long)key, ext);
+    path[count - 1] = 0;
+    return path;
+}
+
+typedef struct blast_cache_header_s {
+    char     magic[8];
+    uint64_t key;
+    uint64_t bytes;
+    uint64_t hash; // of the binary that follows the header
+} blast_cache_header_t;
+
+static const char blast_cache_magic[8] = "blastbin";
+
+static ocl_program_t blast_cache_load(blast_t* b, uint64_t key,
+        const char* options) {
+    char path[1024];
+    FILE* f = fopen(blast_cache_path(path, countof(path), key, "bin"), "rb");
+    if (f == null) { return null; }
+    ocl_program_t p = null;
+    blast_cache_header_t h = {0};
+    bool valid = fread(&h, sizeof(h), 1, f) == 1 &&
+        memcmp(h.magic, blast_cache_magic, sizeof(h.magic)) == 0 &&
+        h.key == key && 0 < h.bytes && h.bytes < (1uLL << 28);
+    void* data = valid ? malloc((size_t)h.bytes) : null;
+    if (data != null) {
+        valid = fread(data, (size_t)h.bytes, 1, f) == 1 &&
+            blast_hash(blast_hash_seed, data, (size_t)h.bytes) == h.hash;
+        if (valid) {
+            p = ocl.load_program(b->c, data, (size_t)h.bytes, options);
+        }
+        free(data);
+    }
+    fclose(f);
+    if (p == null) { traceln("stale or corrupted: %s", path); }
+    return p;
+}
+
+static void blast_cache_save(ocl_program_t p, uint64_t key) {
+    size_t bytes = ocl.program_binary(p, null, 0);
+    void* data = bytes > 0 ? malloc(bytes) : null;
+    if (data != null) {
+        ocl.program_binary(p, data, bytes);
+        blast_cache_header_t h = {0};
+        memcpy(h.magic, blast_cache_magic, sizeof(h.magic));
+        h.key = key;
+        h.bytes = bytes;
+        h.hash = blast_hash(blast_hash_seed, data, bytes);
+        char path[1024];
+        FILE* f = fopen(blast_cache_path(path, countof(path), key, "bin"), "wb");
+        if (f != null) {
+            // partially written file is detected by hash mismatch on load
+            bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+                      fwrite(data, bytes, 1, f) == 1;
+            if (fclose(f) != 0 || !ok) { remove(path); }
+        }
+        free(data);
+    }
+}
+
+static ocl_program_t blast_compile(blast_t* b, int fpp,
+        const void* code, int bytes) {
+//  traceln("\nfpp: %s\n%*.*s\n\n", blast_fpp_names[fpp], bytes, bytes, code);
+    const char* opts = blast_program_options(b, fpp);
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    uint64_t key = blast_hash_seed;
+    key = blast_hash(key, d->name, strlen(d->name) + 1);
+    key = blast_hash(key, d->driver, strlen(d->driver) + 1);
+    key = blast_hash(key, opts, strlen(opts) + 1);
+    key = blast_hash(key, code, bytes);
+    ocl_program_t p = blast_cache_load(b, key, opts);
+    if (p == null) {
+        p = ocl.compile_program(b->c, code, bytes, opts);
+        blast_cache_save(p, key);
+    }
+    return p;
+}
+
+// Host side of adaptive dispatch. Operands are mapped in place; regions
+// of the same blast_memory_t are merged into a single mapping, and
+// operands already mapped by the caller are used as is.
+
+typedef struct blast_region_s {
+    blast_memory_t* m;
+    int64_t from; // bytes
+    int64_t to;
+    int access;
+    byte_t* a;    // address of m[from]
+    bool unmap;
+} blast_region_t;
+
+static void blast_map_regions(blast_region_t r[], int n) {
+    for (int i = 0; i < n; i++) { r[i].a = null; r[i].unmap = false; }
+    for (int i = 0; i < n; i++) {
+        if (r[i].a != null) { continue; }
+        blast_memory_t* m = r[i].m;
+        int64_t from = r[i].from;
+        int64_t to = r[i].to;
+        int access = r[i].access;
+        for (int j = i + 1; j < n; j++) {
+            if (r[j].m == m) {
+                from = min(from, r[j].from);
+                to = max(to, r[j].to);
+                if (r[j].access != access) { access = blast_access_rw; }
+            }
+        }
+        byte_t* a = null;
+        if (m->m != null) {
+            fatal_if(from < m->mo || m->mo + m->ms < to,
+                "[%lld..%lld] is not mapped", from, to);
+            a = (byte_t*)m->m + (from - m->mo);
+        } else {
+            a = (byte_t*)blast_map(m, access, from, to - from);
+            r[i].unmap = true;
+        }
+        for (int j = i; j < n; j++) {
+            if (r[j].m == m) { r[j].a = a + (r[j].from - from); }
+        }
+    }
+}
+
+static void blast_unmap_regions(blast_region_t r[], int n) {
+    for (int i = 0; i < n; i++) {
+        if (r[i].unmap) { blast_unmap(r[i].m); }
+    }
+}
+
+static fp64_t blast_dot_host(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        int fpp) {
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    blast_region_t r[2] = {
+        { .m = v0, .from = o0 * bytes, .to = (o0 + (n - 1) * s0 + 1) * bytes },
+        { .m = v1, .from = o1 * bytes, .to = (o1 + (n - 1) * s1 + 1) * bytes }
+    };
+    blast_map_regions(r, countof(r));
+    fp64_t s = 0;
+    switch (fpp) {
+        case blast_fpp16: // rounded to fp16_t like device result
+            s = fp16to32(fp32to16((fp32_t)dot16((fp16_t*)r[0].a, s0,
+                (fp16_t*)r[1].a, s1, n)));
+            break;
+        case blast_fpp32:
+            s = (fp32_t)dot32((fp32_t*)r[0].a, s0, (fp32_t*)r[1].a, s1, n);
+            break;
+        case blast_fpp64:
+            s = dot64((fp64_t*)r[0].a, s0, (fp64_t*)r[1].a, s1, n);
+            break;
+        case blast_fppbf16: // rounded to bf16_t like device result
+            s = bf16to32(fp32tobf16((fp32_t)dotbf16((bf16_t*)r[0].a, s0,
+                (bf16_t*)r[1].a, s1, n)));
+            break;
+        default: fatal_if("fpp", "%d", fpp);
+    }
+    blast_unmap_regions(r, countof(r));
+    return s;
+}
+
+static void blast_gemv_host(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n,
+        int fpp) {
+    const int64_t bytes = blast_fpp_bytes[fpp];
+    blast_region_t rs[3] = {
+        { .m = mx, .from = om * bytes, .to = (om + (m - 1) * sm + n) * bytes,
+          .access = blast_access_read },
+        { .m = vc, .from = ov * bytes, .to = (ov + (n - 1) * sv + 1) * bytes,
+          .access = blast_access_read },
+        { .m = r,  .from = 0, .to = m * bytes, .access = blast_access_write }
+    };
+    blast_map_regions(rs, countof(rs));
+    switch (fpp) {
+        case blast_fpp16:
+            gemv16((fp16_t*)rs[0].a, sm, (fp16_t*)rs[1].a, sv,
+                   (fp16_t*)rs[2].a, m, n);
+            break;
+        case blast_fpp32:
+            gemv32((fp32_t*)rs[0].a, sm, (fp32_t*)rs[1].a, sv,
+                   (fp32_t*)rs[2].a, m, n);
+            break;
+        case blast_fpp64:
+            gemv64((fp64_t*)rs[0].a, sm, (fp64_t*)rs[1].a, sv,
+                   (fp64_t*)rs[2].a, m, n);
+            break;
+        case blast_fppbf16:
+            gemvbf16((bf16_t*)rs[0].a, sm, (bf16_t*)rs[1].a, sv,
+                     (bf16_t*)rs[2].a, m, n);
+            break;
+        default: fatal_if("fpp", "%d", fpp);
+    }
+    blast_unmap_regions(rs, countof(rs));
+}
+
+static bool blast_on_device(blast_t* b, int fpp, int64_t count,
+        int64_t crossover, blast_memory_t* m0, blast_memory_t* m1,
+        blast_memory_t* m2) {
+    return b->dot[fpp] != null && count >= crossover &&
+        m0->m == null && m1->m == null && (m2 == null || m2->m == null);
+}
+
+static fp64_t blast_dot_auto(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n,
+        int fpp) {
+    blast_t* b = v0->b;
+    return blast_on_device(b, fpp, n, b->crossover.dot[fpp], v0, v1, null) ?
+        b->dot[fpp](v0, o0, s0, v1, o1, s1, n) :
+        blast_dot_host(v0, o0, s0, v1, o1, s1, n, fpp);
+}
+
+static void blast_gemv_auto(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n,
+        int fpp) {
+    blast_t* b = mx->b;
+    if (blast_on_device(b, fpp, m * n, b->crossover.gemv[fpp], mx, vc, r)) {
+        b->gemv[fpp](mx, om, sm, vc, ov, sv, r, m, n);
+    } else {
+        blast_gemv_host(mx, om, sm, vc, ov, sv, r, m, n, fpp);
+    }
+}
+
+static fp64_t blast_dot_auto_fp16(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n) {
+    return blast_dot_auto(v0, o0, s0, v1, o1, s1, n, blast_fpp16);
+}
+
+static fp64_t blast_dot_auto_fp32(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n) {
+    return blast_dot_auto(v0, o0, s0, v1, o1, s1, n, blast_fpp32);
+}
+
+static fp64_t blast_dot_auto_fp64(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n) {
+    return blast_dot_auto(v0, o0, s0, v1, o1, s1, n, blast_fpp64);
+}
+
+static fp64_t blast_dot_auto_bf16(
+        blast_memory_t* v0, int64_t o0, int64_t s0,
+        blast_memory_t* v1, int64_t o1, int64_t s1, int64_t n) {
+    return blast_dot_auto(v0, o0, s0, v1, o1, s1, n, blast_fppbf16);
+}
+
+static void blast_gemv_auto_fp16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_auto(mx, om, sm, vc, ov, sv, r, m, n, blast_fpp16);
+}
+
+static void blast_gemv_auto_fp32(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_auto(mx, om, sm, vc, ov, sv, r, m, n, blast_fpp32);
+}
+
+static void blast_gemv_auto_fp64(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_auto(mx, om, sm, vc, ov, sv, r, m, n, blast_fpp64);
+}
+
+static void blast_gemv_auto_bf16(
+        blast_memory_t* mx, int64_t om, int64_t sm,
+        blast_memory_t* vc, int64_t ov, int64_t sv,
+        blast_memory_t* r,  int64_t m,  int64_t n) {
+    blast_gemv_auto(mx, om, sm, vc, ov, sv, r, m, n, blast_fppbf16);
+}
+
+// Calibration times host and device on power of 4 sizes and takes as
+// crossover the smallest size from which device wins at all larger
+// measured sizes. gemv is measured on 64 rows of n columns.
+
+enum { blast_calibration_min = 1 << 10, blast_calibration_max = 1 << 20 };
+
+static double blast_best_of(blast_memory_t* v, int64_t n, int fpp,
+        bool dot, bool host) {
+    enum { rows = 64 };
+    blast_t* b = v->b;
+    blast_memory_t r = blast.allocate(b, blast_access_rw, rows * sizeof(fp64_t));
+    double best = DBL_MAX;
+    for (int k = 0; k < 3; k++) {
+        double time = seconds();
+        // v[0..n - 1] matrix, v[n..] vector(s) followed by gemv result
+        if (dot && host) {
+            blast_dot_host(v, 0, 1, v, n, 1, n, fpp);
+        } else if (dot) { // dot() waits for the result in blocking map
+            b->dot[fpp](v, 0, 1, v, n, 1, n);
+        } else if (host) {
+            blast_gemv_host(v, 0, n / rows, v, n, 1, &r, rows, n / rows, fpp);
+        } else {
+            b->gemv[fpp](v, 0, n / rows, v, n, 1, &r, rows, n / rows);
+            ocl.finish(b->c); // gemv() only enqueues
+        }
+        best = min(best, seconds() - time);
+    }
+    blast.deallocate(&r);
+    return best;
+}
+
+static int64_t blast_calibrate_crossover(blast_memory_t* v, int fpp,
+        bool dot) {
+    int64_t crossover = INT64_MAX;
+    for (int64_t n = blast_calibration_max; n >= blast_calibration_min;
+            n >>= 2) {
+        if (blast_best_of(v, n, fpp, dot, false) >=
+            blast_best_of(v, n, fpp, dot, true)) {
+            break;
+        }
+        crossover = n;
+    }
+    return crossover;
+}
+
+// blast_gemv_select() times every gemv() kernel variant on a matrix of
+// each shape class and keeps the fastest. v is the calibration memory.
+
+static void blast_gemv_select(blast_memory_t* v, int fpp) {
+    static const int64_t shapes[][2] = { // {m, n} one per shape class
+        {   64,  256 }, {   64, 4096 }, { 2048,  256 }, { 1024, 1024 }
+    };
+    blast_t* b = v->b;
+    for (int i = 0; i < countof(shapes); i++) {
+        const int64_t m = shapes[i][0];
+        const int64_t n = shapes[i][1];
+        const int k = blast_gemv_class(m, n);
+        blast_memory_t r = blast.allocate(b, blast_access_rw,
+            m * blast_fpp_bytes[fpp]);
+        double best = DBL_MAX;
+        int winner = blast_gemv_wg;
+        for (int variant = blast_gemv_wg; variant <= blast_gemv_item16;
+                variant++) {
+            b->crossover.gemv_variant[fpp][k] = variant;
+            for (int j = 0; j < 3; j++) {
+                double time = seconds();
+                // v[0..m * n - 1] matrix, v[m * n..] vector
+                b->gemv[fpp](v, 0, n, v, m * n, 1, &r, m, n);
+                ocl.finish(b->c);
+                time = seconds() - time;
+                if (time < best) { best = time; winner = variant; }
+            }
+        }
+        b->crossover.gemv_variant[fpp][k] = winner;
+        blast.deallocate(&r);
+    }
+}
+
+// Calibration results are cached as blast_<key>.cal files next to the
+// compiled programs. The header carries magic, version of the layout
+// and hash of blast.cl source. Stale, corrupted or out of range entries
+// are recalibrated and overwritten.
+
+enum { blast_calibration_version = 2 }; // of blast_crossover_t layout
+
+typedef struct blast_calibration_header_s {
+    char     magic[8];
+    uint32_t version; // blast_calibration_version
+    uint32_t bytes;   // sizeof(blast_crossover_t)
+    uint64_t key;     // device, driver and limits
+    uint64_t code;    // hash of blast.cl source
+    uint64_t hash;    // of blast_crossover_t that follows the header
+} blast_calibration_header_t;
+
+static const char blast_calibration_magic[8] = "blastcal";
+
+static bool blast_crossover_valid(const blast_crossover_t* x) {
+    for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+        if (x->dot[fpp] < 0 || x->gemv[fpp] < 0) { return false; }
+        for (int k = 0; k < countof(x->gemv_variant[fpp]); k++) {
+            const int32_t v = x->gemv_variant[fpp][k];
+            if (v < blast_gemv_wg || blast_gemv_item16 < v) { return false; }
+        }
+    }
+    return true;
+}
+
+static bool blast_calibration_load(const char* path, uint64_t key,
+        uint64_t code, blast_crossover_t* x) {
+    FILE* f = fopen(path, "rb");
+    if (f == null) { return false; }
+    blast_calibration_header_t h = {0};
+    blast_crossover_t c = {0};
+    const bool valid = fread(&h, sizeof(h), 1, f) == 1 &&
+        memcmp(h.magic, blast_calibration_magic, sizeof(h.magic)) == 0 &&
+        h.version == blast_calibration_version && h.bytes == sizeof(c) &&
+        h.key == key && h.code == code &&
+        fread(&c, sizeof(c), 1, f) == 1 &&
+        blast_hash(blast_hash_seed, &c, sizeof(c)) == h.hash &&
+        blast_crossover_valid(&c);
+    fclose(f);
+    if (valid) {
+        *x = c;
+    } else {
+        traceln("stale or corrupted: %s", path);
+    }
+    return valid;
+}
+
+static void blast_calibration_save(const char* path, uint64_t key,
+        uint64_t code, const blast_crossover_t* x) {
+    blast_calibration_header_t h = {0};
+    memcpy(h.magic, blast_calibration_magic, sizeof(h.magic));
+    h.version = blast_calibration_version;
+    h.bytes = sizeof(*x);
+    h.key = key;
+    h.code = code;
+    h.hash = blast_hash(blast_hash_seed, x, sizeof(*x));
+    FILE* f = fopen(path, "wb");
+    if (f != null) {
+        // partially written file is detected by hash mismatch on load
+        bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+                  fwrite(x, sizeof(*x), 1, f) == 1;
+        if (fclose(f) != 0 || !ok) { remove(path); }
+    }
+}
+
+// Crossovers are loaded from the cache or measured on the first run.
+// The sweep of gemv() kernel variants is opt-in: it runs only when the
+// BLAST_CALIBRATE environment variable is "1", otherwise gemv() always
+// uses gemv_wg. Opt-in is part of the key so each mode has its own file.
+
+static void blast_calibrate(blast_t* b, const void* code, int bytes) {
+    const char* opt_in = getenv("BLAST_CALIBRATE");
+    const bool select = opt_in != null && strcmp(opt_in, "1") == 0;
+    const ocl_device_t* d = &ocl.devices[b->c->ix];
+    uint64_t key = blast_hash_seed;
+    key = blast_hash(key, d->name, strlen(d->name) + 1);
+    key = blast_hash(key, d->driver, strlen(d->driver) + 1);
+    key = blast_hash(key, &d->max_groups, sizeof(d->max_groups));
+    key = blast_hash(key, &d->max_items[0], sizeof(d->max_items[0]));
+    key = blast_hash(key, &select, sizeof(select));
+    const uint64_t code_hash = blast_hash(blast_hash_seed, code, bytes);
+    char path[1024];
+    blast_cache_path(path, countof(path), key, "cal");
+    if (!blast_calibration_load(path, key, code_hash, &b->crossover)) {
+        memset(&b->crossover, 0, sizeof(b->crossover)); // blast_gemv_wg
+        const int64_t size = 2 * blast_calibration_max * sizeof(fp64_t);
+        blast_memory_t v = blast.allocate(b, blast_access_rw, size);
+        memset(blast.map(&v, blast_access_write, 0, size), 0, size);
+        blast.unmap(&v);
+        for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+            b->crossover.dot[fpp]  = INT64_MAX;
+            b->crossover.gemv[fpp] = INT64_MAX;
+            if (b->dot[fpp] != null) {
+                if (select) { blast_gemv_select(&v, fpp); } // before gemv crossover
+                b->crossover.dot[fpp]  = blast_calibrate_crossover(&v, fpp, true);
+                b->crossover.gemv[fpp] = blast_calibrate_crossover(&v, fpp, false);
+            }
+        }
+        blast.deallocate(&v);
+        blast_calibration_save(path, key, code_hash, &b->crossover);
+    }
+}
+
+static void blast_init(blast_t* b, ocl_context_t* c) {
+    dot_init();
+    b->c = c;
+    blast_pool_init(b);
+    ocl_device_t* d = &ocl.devices[b->c->ix];
+    void* code = null;
+    int64_t bytes64 = 0;
+    int r = memmap_resource("blast_cl", &code, &bytes64);
+    fatal_if(r != 0 || code == null || bytes64 == 0, "blast.cl in blast.rc?");
+    fatal_if(bytes64 > INT_MAX, "blast.cl %lld bytes", bytes64);
+    int bytes = (int)bytes64;
+    const bool has_fp16 = (d->fp_config & ocl_fp16) != 0;
+    const bool has_fp64 =  d->double_fp_config != 0;
+    // bf16_t kernels only need fp32_t arithmetic (see bf16_surrogate)
+    ocl_program_t p[4] = {
+        has_fp16 ? blast_compile(b, blast_fpp16, code, bytes) : null,
+        blast_compile(b, blast_fpp32, code, bytes),
+        has_fp64 ? blast_compile(b, blast_fpp64, code, bytes) : null,
+        blast_compile(b, blast_fppbf16, code, bytes)
+    };
+    static const char* sum_partials[] = {"sum_partials_fp16", "sum_partials_fp32", "sum_partials_fp64", "sum_partials_bf16"};
+    static const char* dot[]         = {"dot_fp16",         "dot_fp32",         "dot_fp64",         "dot_bf16"};
+    static const char* dot_os[]      = {"dot_os_fp16",      "dot_os_fp32",      "dot_os_fp64",      "dot_os_bf16"};
+    static const char* dot_batch[]   = {"dot_batch_fp16",   "dot_batch_fp32",   "dot_batch_fp64",   "dot_batch_bf16"};
+    static const char* gemv[]        = {"gemv_fp16",        "gemv_fp32",        "gemv_fp64",        "gemv_bf16"};
+    static const char* gemv4[]       = {"gemv4_fp16",       "gemv4_fp32",       "gemv4_fp64",       "gemv4_bf16"};
+    static const char* gemv16[]      = {"gemv16_fp16",      "gemv16_fp32",      "gemv16_fp64",      "gemv16_bf16"};
+    static const char* gemv_os[]     = {"gemv_os_fp16",     "gemv_os_fp32",     "gemv_os_fp64",     "gemv_os_bf16"};
+    static const char* gemv_wg[]     = {"gemv_wg_fp16",     "gemv_wg_fp32",     "gemv_wg_fp64",     "gemv_wg_bf16"};
+    static const char* gemv_batch[]  = {"gemv_batch_fp16",  "gemv_batch_fp32",  "gemv_batch_fp64",  "gemv_batch_bf16"};
+    static const char* gemv_q[4][4]  = {
+        {"gemv_q8_fp16", "gemv_q8_fp32", "gemv_q8_fp64", "gemv_q8_bf16"},
+        {"gemv_q4_fp16", "gemv_q4_fp32", "gemv_q4_fp64", "gemv_q4_bf16"},
+        {"gemv_e4m3_fp16", "gemv_e4m3_fp32", "gemv_e4m3_fp64", "gemv_e4m3_bf16"},
+        {"gemv_e5m2_fp16", "gemv_e5m2_fp32", "gemv_e5m2_fp64", "gemv_e5m2_bf16"}
+    };
+    static const char* level1[18][4] = { // same order as level1_k[] below
+        {"copy_c_fp16", "copy_c_fp32", "copy_c_fp64", "copy_c_bf16"},
+        {"copy_os_fp16", "copy_os_fp32", "copy_os_fp64", "copy_os_bf16"},
+        {"swap_c_fp16", "swap_c_fp32", "swap_c_fp64", "swap_c_bf16"},
+        {"swap_os_fp16", "swap_os_fp32", "swap_os_fp64", "swap_os_bf16"},
+        {"scal_c_fp16", "scal_c_fp32", "scal_c_fp64", "scal_c_bf16"},
+        {"scal_os_fp16", "scal_os_fp32", "scal_os_fp64", "scal_os_bf16"},
+        {"mad_c_fp16", "mad_c_fp32", "mad_c_fp64", "mad_c_bf16"},
+        {"mad_os_fp16", "mad_os_fp32", "mad_os_fp64", "mad_os_bf16"},
+        {"rot_c_fp16", "rot_c_fp32", "rot_c_fp64", "rot_c_bf16"},
+        {"rot_os_fp16", "rot_os_fp32", "rot_os_fp64", "rot_os_bf16"},
+        {"sum_os_fp16", "sum_os_fp32", "sum_os_fp64", "sum_os_bf16"},
+        {"asum_os_fp16", "asum_os_fp32", "asum_os_fp64", "asum_os_bf16"},
+        {"nrm2_os_fp16", "nrm2_os_fp32", "nrm2_os_fp64", "nrm2_os_bf16"},
+        {"nrm2_partials_fp16", "nrm2_partials_fp32", "nrm2_partials_fp64", "nrm2_partials_bf16"},
+        {"iamax_os_fp16", "iamax_os_fp32", "iamax_os_fp64", "iamax_os_bf16"},
+        {"iamin_os_fp16", "iamin_os_fp32", "iamin_os_fp64", "iamin_os_bf16"},
+        {"iamax_partials_fp16", "iamax_partials_fp32", "iamax_partials_fp64", "iamax_partials_bf16"},
+        {"iamin_partials_fp16", "iamin_partials_fp32", "iamin_partials_fp64", "iamin_partials_bf16"}
+    };
+    ocl_kernel_t* level1_k[] = {
+        b->copy_c, b->copy_os, b->swap_c, b->swap_os, b->scal_c, b->scal_os,
+        b->mad_c,  b->mad_os,  b->rot_c,  b->rot_os,
+        b->sum_os, b->asum_os, b->nrm2_os, b->nrm2_partials,
+        b->iamax_os, b->iamin_os, b->iamax_partials, b->iamin_partials
+    };
+    for (int fp = blast_fpp16; fp <= blast_fppbf16; fp++) {
+        if (p[fp] != null) {
+            b->sum_partials[fp] = ocl.create_kernel(p[fp], sum_partials[fp]);
+            b->dot_c[fp]       = ocl.create_kernel(p[fp], dot[fp]);
+            b->dot_os[fp]      = ocl.create_kernel(p[fp], dot_os[fp]);
+            b->dot_batch_k[fp] = ocl.create_kernel(p[fp], dot_batch[fp]);
+            b->gemv_c[fp]      = ocl.create_kernel(p[fp], gemv[fp]);
+            b->gemv4_c[fp]     = ocl.create_kernel(p[fp], gemv4[fp]);
+            b->gemv16_c[fp]    = ocl.create_kernel(p[fp], gemv16[fp]);
+            b->gemv_os[fp]     = ocl.create_kernel(p[fp], gemv_os[fp]);
+            b->gemv_wg[fp]     = ocl.create_kernel(p[fp], gemv_wg[fp]);
+            b->gemv_batch_k[fp] = ocl.create_kernel(p[fp], gemv_batch[fp]);
+            for (int f = blast_format_q8; f <= blast_format_e5m2; f++) {
+                b->gemv_q_k[f][fp] = ocl.create_kernel(p[fp], gemv_q[f][fp]);
+            }
+            for (int i = 0; i < countof(level1_k); i++) {
+                level1_k[i][fp] = ocl.create_kernel(p[fp], level1[i][fp]);
+            }
+            ocl.release_program(p[fp]);
+            switch (fp) {
+                case blast_fpp16:
+                    b->dot[fp]        = blast_dot_fp16;
+                    b->dot_batch[fp]  = blast_dot_batch_fp16;
+                    b->gemv[fp]       = blast_gemv_fp16;
+                    b->dot_async[fp]  = blast_dot_async_fp16;
+                    b->gemv_async[fp] = blast_gemv_async_fp16;
+                    b->gemv_batch[fp] = blast_gemv_batch_fp16;
+                    b->gemv_q[blast_format_q8][fp] = blast_gemv_q8_fp16;
+                    b->gemv_q[blast_format_q4][fp] = blast_gemv_q4_fp16;
+                    b->gemv_q[blast_format_e4m3][fp] = blast_gemv_e4m3_fp16;
+                    b->gemv_q[blast_format_e5m2][fp] = blast_gemv_e5m2_fp16;
+                    b->axpy[fp]       = blast_axpy_fp16;
+                    b->scal[fp]       = blast_scal_fp16;
+                    b->copy[fp]       = blast_copy_fp16;
+                    b->swap[fp]       = blast_swap_fp16;
+                    b->rot[fp]        = blast_rot_fp16;
+                    b->sum[fp]        = blast_sum_fp16;
+                    b->asum[fp]       = blast_asum_fp16;
+                    b->nrm2[fp]       = blast_nrm2_fp16;
+                    b->iamax[fp]      = blast_iamax_fp16;
+                    b->iamin[fp]      = blast_iamin_fp16;
+                    break;
+                case blast_fpp32:
+                    b->dot[fp]        = blast_dot_fp32;
+                    b->dot_batch[fp]  = blast_dot_batch_fp32;
+                    b->gemv[fp]       = blast_gemv_fp32;
+                    b->dot_async[fp]  = blast_dot_async_fp32;
+                    b->gemv_async[fp] = blast_gemv_async_fp32;
+                    b->gemv_batch[fp] = blast_gemv_batch_fp32;
+                    b->gemv_q[blast_format_q8][fp] = blast_gemv_q8_fp32;
+                    b->gemv_q[blast_format_q4][fp] = blast_gemv_q4_fp32;
+                    b->gemv_q[blast_format_e4m3][fp] = blast_gemv_e4m3_fp32;
+                    b->gemv_q[blast_format_e5m2][fp] = blast_gemv_e5m2_fp32;
+                    b->axpy[fp]       = blast_axpy_fp32;
+                    b->scal[fp]       = blast_scal_fp32;
+                    b->copy[fp]       = blast_copy_fp32;
+                    b->swap[fp]       = blast_swap_fp32;
+                    b->rot[fp]        = blast_rot_fp32;
+                    b->sum[fp]        = blast_sum_fp32;
+                    b->asum[fp]       = blast_asum_fp32;
+                    b->nrm2[fp]       = blast_nrm2_fp32;
+                    b->iamax[fp]      = blast_iamax_fp32;
+                    b->iamin[fp]      = blast_iamin_fp32;
+                    break;
+                case blast_fpp64:
+                    b->dot[fp]        = blast_dot_fp64;
+                    b->dot_batch[fp]  = blast_dot_batch_fp64;
+                    b->gemv[fp]       = blast_gemv_fp64;
+                    b->dot_async[fp]  = blast_dot_async_fp64;
+                    b->gemv_async[fp] = blast_gemv_async_fp64;
+                    b->gemv_batch[fp] = blast_gemv_batch_fp64;
+                    b->gemv_q[blast_format_q8][fp] = blast_gemv_q8_fp64;
+                    b->gemv_q[blast_format_q4][fp] = blast_gemv_q4_fp64;
+                    b->gemv_q[blast_format_e4m3][fp] = blast_gemv_e4m3_fp64;
+                    b->gemv_q[blast_format_e5m2][fp] = blast_gemv_e5m2_fp64;
+                    b->axpy[fp]       = blast_axpy_fp64;
+                    b->scal[fp]       = blast_scal_fp64;
+                    b->copy[fp]       = blast_copy_fp64;
+                    b->swap[fp]       = blast_swap_fp64;
+                    b->rot[fp]        = blast_rot_fp64;
+                    b->sum[fp]        = blast_sum_fp64;
+                    b->asum[fp]       = blast_asum_fp64;
+                    b->nrm2[fp]       = blast_nrm2_fp64;
+                    b->iamax[fp]      = blast_iamax_fp64;
+                    b->iamin[fp]      = blast_iamin_fp64;
+                    break;
+                case blast_fppbf16:
+                    b->dot[fp]        = blast_dot_bf16;
+                    b->dot_batch[fp]  = blast_dot_batch_bf16;
+                    b->gemv[fp]       = blast_gemv_bf16;
+                    b->dot_async[fp]  = blast_dot_async_bf16;
+                    b->gemv_async[fp] = blast_gemv_async_bf16;
+                    b->gemv_batch[fp] = blast_gemv_batch_bf16;
+                    b->gemv_q[blast_format_q8][fp] = blast_gemv_q8_bf16;
+                    b->gemv_q[blast_format_q4][fp] = blast_gemv_q4_bf16;
+                    b->gemv_q[blast_format_e4m3][fp] = blast_gemv_e4m3_bf16;
+                    b->gemv_q[blast_format_e5m2][fp] = blast_gemv_e5m2_bf16;
+                    b->axpy[fp]       = blast_axpy_bf16;
+                    b->scal[fp]       = blast_scal_bf16;
+                    b->copy[fp]       = blast_copy_bf16;
+                    b->swap[fp]       = blast_swap_bf16;
+                    b->rot[fp]        = blast_rot_bf16;
+                    b->sum[fp]        = blast_sum_bf16;
+                    b->asum[fp]       = blast_asum_bf16;
+                    b->nrm2[fp]       = blast_nrm2_bf16;
+                    b->iamax[fp]      = blast_iamax_bf16;
+                    b->iamin[fp]      = blast_iamin_bf16;
+                    break;
+                default: fatal_if("never");
+            }
+        }
+    }
+    b->dot_auto[blast_fpp16]  = blast_dot_auto_fp16;
+    b->dot_auto[blast_fpp32]  = blast_dot_auto_fp32;
+    b->dot_auto[blast_fpp64]  = blast_dot_auto_fp64;
+    b->dot_auto[blast_fppbf16] = blast_dot_auto_bf16;
+    b->gemv_auto[blast_fpp16] = blast_gemv_auto_fp16;
+    b->gemv_auto[blast_fpp32] = blast_gemv_auto_fp32;
+    b->gemv_auto[blast_fpp64] = blast_gemv_auto_fp64;
+    b->gemv_auto[blast_fppbf16] = blast_gemv_auto_bf16;
+    blast_calibrate(b, code, bytes);
+}
+
+static void blast_fini(blast_t* b) {
+    blast_pool_fini(b);
+    // all known GPU support at least fp32_t (and thus bf16_t) but many
+    // do not support fp16_t and/or fp64_t
+    for (int fp = blast_fpp16; fp <= blast_fppbf16; fp++) {
+        if (b->dot_c[fp] == null) { continue; }
+        ocl.release_kernel(b->sum_partials[fp]);
+        ocl.release_kernel(b->dot_c[fp]);
+        ocl.release_kernel(b->dot_os[fp]);
+        ocl.release_kernel(b->dot_batch_k[fp]);
+        ocl.release_kernel(b->gemv_c[fp]);
+        ocl.release_kernel(b->gemv4_c[fp]);
+        ocl.release_kernel(b->gemv16_c[fp]);
+        ocl.release_kernel(b->gemv_os[fp]);
+        ocl.release_kernel(b->gemv_wg[fp]);
+        ocl.release_kernel(b->gemv_batch_k[fp]);
+        for (int f = blast_format_q8; f <= blast_format_e5m2; f++) {
+            ocl.release_kernel(b->gemv_q_k[f][fp]);
+        }
+        ocl_kernel_t* level1_k[] = {
+            b->copy_c, b->copy_os, b->swap_c, b->swap_os, b->scal_c, b->scal_os,
+            b->mad_c,  b->mad_os,  b->rot_c,  b->rot_os,
+            b->sum_os, b->asum_os, b->nrm2_os, b->nrm2_partials,
+            b->iamax_os, b->iamin_os, b->iamax_partials, b->iamin_partials
+        };
+        for (int i = 0; i < countof(level1_k); i++) {
+            ocl.release_kernel(level1_k[i][fp]);
+        }
     }
 }
 
@@ -374,5 +2170,8 @@ blast_if blast = {
     .deallocate = blast_deallocate,
     .map        = blast_map,
     .unmap      = blast_unmap,
+    .wait       = blast_wait,
+    .poll       = blast_poll,
+    .then       = blast_then,
     .fini       = blast_fini
 };
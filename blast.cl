@@ -1,9 +1,11 @@
 // expectes to be prepended with
-// #define suffix fp16|fp32|fp64
+// #define suffix fp16|fp32|fp64|bf16
 // #define fp_t float
 // or
 // #define fp_t double
 // #define fp_t half
+// or (bf16 with -D bf16_surrogate)
+// #define fp_t ushort
 
 // for gemv() optimizations vec4, vec8, vec16 must be defined as:
 // #define vec4 type4
@@ -17,16 +19,9 @@
 // #pragma OPENCL SELECT_ROUNDING_MODE rte // rte rtz rtp rtn
 
 // Because half4, half8 and half16 has limited support at the
-// time of writing there is workaround for surrogate kernels fp16_t.
-// is the special case.
-// #define fp16_surrogate 1
-// or
-// #define fp16_surrogate 2
-// to use alternative implementations of:
-// dot_fp16x16_1()
-// or
-// dot_fp16x16_2()
-// TODO: measure which one is faster
+// time of writing fp16_t kernels are compiled with fp16_surrogate
+// defined: elements are converted to float on load (see acc_t below)
+// and no half arithmetic is required from the device.
 
 #if __OPENCL_VERSION__ <= CL_VERSION_1_1
 #pragma OPENCL EXTENSION cl_khr_fp64: enable
@@ -53,102 +48,756 @@
 // 1. not defined: FP_FAST_FMA_HALF not defined
 // 2. dot(halfN, halfN) not defined for N=2,3,5,16
 
-// below are substitutes for dot(half4, half4) and dot(half16, half16)
+// dot(load4(), load4()) in float substitutes dot(half4, half4) and
+// gemv16() does four of them per iteration instead of dot(half16, half16)
 
 #define fp_ro_t __global const fp_t* // pointer to read only elements
 #define fp_wr_t __global fp_t*       // pointer to write only elements
 
-__kernel void name(sum_odd, suffix)(fp_ro_t const v, fp_wr_t r) {
-    const int32_t i = get_global_id(0);
-    const int32_t m = get_global_size(0); // middle
-    const int32_t e = get_global_size(0) * 2; // end
-    if (i == 0) { // extra one for odd for first element only
-        r[0] = v[0] + v[m] + v[e];
-    } else {
-        r[i] = v[i] + v[i + m];
+// acc_t is the type of accumulated sums. For fp16_t it is float because
+// sum of many half products quickly loses precision (and overflows at 65504).
+// fp16_t elements are accessed with vload_half()/vstore_half() that convert
+// to/from float and do not require half arithmetic on the device.
+
+// bf16_t elements are ushort upper halves of float: loads are shifts and
+// stores round to nearest even (quiet NaNs stay NaNs) like fp32tobf16().
+
+inline ushort bf16_from_float(float f) {
+    const uint u = as_uint(f);
+    return isnan(f) ? (ushort)((u >> 16) | 0x40) :
+                      (ushort)((u + 0x7FFF + ((u >> 16) & 1)) >> 16);
+}
+
+inline void bf16_store4(float4 v, int32_t i, __global ushort* p) {
+    float f[4];
+    vstore4(v, 0, f);
+    for (int32_t k = 0; k < 4; k++) { p[i * 4 + k] = bf16_from_float(f[k]); }
+}
+
+// raw_t and raw4_t are bit patterns of fp_t for copies without conversion.
+
+#ifdef fp16_surrogate
+#define acc_t           float
+#define acc4_t          float4
+#define raw_t           ushort
+#define raw4_t          ushort4
+#define load1(i, p)     vload_half(i, p)
+#define load4(i, p)     vload_half4(i, p)
+#define store1(v, i, p) vstore_half(v, i, p)
+#define store4(v, i, p) vstore_half4(v, i, p)
+#elif defined(bf16_surrogate)
+#define acc_t           float
+#define acc4_t          float4
+#define raw_t           ushort
+#define raw4_t          ushort4
+#define load1(i, p)     as_float((uint)(p)[i] << 16)
+#define load4(i, p)     as_float4(convert_uint4(vload4(i, p)) << 16)
+#define store1(v, i, p) ((p)[i] = bf16_from_float(v))
+#define store4(v, i, p) bf16_store4(v, i, p)
+#else
+#define acc_t           fp_t
+#define acc4_t          vec4
+#define raw_t           fp_t
+#define raw4_t          vec4
+#define load1(i, p)     ((p)[i])
+#define load4(i, p)     vload4(i, p)
+#define store1(v, i, p) ((p)[i] = (v))
+#define store4(v, i, p) vstore4(v, i, p)
+#endif
+
+// group_sum() tree reduction of work-items values in local memory.
+// Works for any local size (not only power of 2). All work-items of the
+// group must call it and all of them receive the sum.
+
+inline acc_t group_sum(__local acc_t* partial, acc_t s) {
+    const int32_t i = get_local_id(0);
+    int32_t n = get_local_size(0);
+    partial[i] = s;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    while (n > 1) {
+        const int32_t h = (n + 1) / 2;
+        if (i < n - h) { partial[i] += partial[i + h]; }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        n = h;
     }
+    s = partial[0];
+    barrier(CLK_LOCAL_MEM_FENCE); // partial[] can be reused after return
+    return s;
 }
 
-__kernel void name(sum_even, suffix)(fp_ro_t const v, fp_wr_t r) {
-    const int32_t i = get_global_id(0);
-    const int32_t m = get_global_size(0);
-    r[i] = v[i] + v[(i + m)];
+// dot() is computed in at most two dispatches regardless of n:
+// 1. dot[_os]() every work-item accumulates products of a grid-stride run
+//    of elements, the work-group reduces them in local memory and writes
+//    a single partial sum per group to r[get_group_id(0)]
+// 2. sum_partials() a single work-group adds up the partial sums and
+//    stores the result as fp_t into the destination memory.
+// partial[] is local memory of get_local_size(0) elements.
+// dot() (compact) requires unit strides and offsets that are multiples
+// of 4: every iteration is a pair of aligned vec4 loads (vload_half4()
+// for fp16) accumulated privately, the first work-item also adds the
+// last n % 4 products. Work-items process n / 4 vec4 chunks, thus the
+// host enqueues 4 times fewer of them than for dot_os().
+
+__kernel void name(dot, suffix)(
+        fp_ro_t const x0, const int32_t offset0,
+        fp_ro_t const x1, const int32_t offset1,
+        const int32_t n, __global acc_t* r, __local acc_t* partial) {
+    fp_ro_t const v0 = x0 + offset0;
+    fp_ro_t const v1 = x1 + offset1;
+    const int32_t stride = get_global_size(0);
+    const int32_t n4 = n / 4;
+    acc_t s = 0;
+    for (int32_t i = get_global_id(0); i < n4; i += stride) {
+        s += dot(load4(i, v0), load4(i, v1));
+    }
+    if (get_global_id(0) == 0) {
+        for (int32_t i = n4 * 4; i < n; i++) { s += load1(i, v0) * load1(i, v1); }
+    }
+    s = group_sum(partial, s);
+    if (get_local_id(0) == 0) { r[get_group_id(0)] = s; }
 }
 
-__kernel void name(sum_odd_os, suffix)(fp_ro_t v,
-        const int32_t offset, const int32_t stride, fp_wr_t r) {
-    const int32_t i = get_global_id(0);
-    const int32_t m = get_global_size(0); // middle
-    const int32_t e = get_global_size(0) * 2; // end
-    if (i == 0) {
-        r[i] = v[offset + i * stride] + v[offset + (i + m) * stride] +
-               v[offset + e * stride]; // extra one for odd
+__kernel void name(dot_os, suffix)(
+        fp_ro_t const v0, const int32_t offset0, const int32_t stride0,
+        fp_ro_t const v1, const int32_t offset1, const int32_t stride1,
+        const int32_t n, __global acc_t* r, __local acc_t* partial) {
+    const int32_t stride = get_global_size(0);
+    acc_t s = 0;
+    for (int32_t i = get_global_id(0); i < n; i += stride) {
+        s += load1(offset0 + i * stride0, v0) * load1(offset1 + i * stride1, v1);
+    }
+    s = group_sum(partial, s);
+    if (get_local_id(0) == 0) { r[get_group_id(0)] = s; }
+}
+
+// sum_partials() must be enqueued as a single work-group.
+// r[offset] = v[0] + v[1] + ... + v[n - 1]
+
+__kernel void name(sum_partials, suffix)(__global const acc_t* v,
+        const int32_t n, fp_wr_t r, const int32_t offset,
+        __local acc_t* partial) {
+    const int32_t items = get_local_size(0);
+    acc_t s = 0;
+    for (int32_t i = get_local_id(0); i < n; i += items) { s += v[i]; }
+    s = group_sum(partial, s);
+    if (get_local_id(0) == 0) { store1(s, offset, r); }
+}
+
+// dot_batch() is many dot() products in a single dispatch: a work-group
+// per pair of vectors (groups walk the pairs in a grid-stride loop) and
+// work-items of the group stride over the elements of the pair.
+// d[k * 5 + 0..4] = offset0, stride0, offset1, stride1, n of pair k
+// r[r_offset + k] = v0[offset0 + i * stride0] dot v1[offset1 + i * stride1]
+
+__kernel void name(dot_batch, suffix)(fp_ro_t const v0, fp_ro_t const v1,
+        __global const int32_t* d, const int32_t pairs,
+        fp_wr_t r, const int32_t r_offset, __local acc_t* partial) {
+    const int32_t items = get_local_size(0);
+    for (int32_t k = get_group_id(0); k < pairs; k += get_num_groups(0)) {
+        __global const int32_t* p = d + k * 5;
+        const int32_t o0 = p[0], s0 = p[1], o1 = p[2], s1 = p[3], n = p[4];
+        acc_t s = 0;
+        for (int32_t i = get_local_id(0); i < n; i += items) {
+            s += load1(o0 + i * s0, v0) * load1(o1 + i * s1, v1);
+        }
+        s = group_sum(partial, s);
+        if (get_local_id(0) == 0) { store1(s, r_offset + k, r); }
+    }
+}
+
+// gemv General Matrix Multiplication by Vector
+// gemv(), gemv4() and gemv16() assign a work-item per row of the matrix
+// and take the same arguments as gemv_wg() (below) plus the number of
+// rows instead of partial[]:
+// row = mx[mx_offset + row * row_stride] ... [+ n - 1] for row < rows
+// v[i] = vc[v_offset + i * v_stride]
+// r[r_offset + row] = row dot v
+// gemv() does one product per iteration, gemv4() one vec4 and gemv16()
+// four vec4 (when v_stride == 1). Which of them or gemv_wg() is faster
+// depends on the device and the shape of the matrix, the host measures
+// them at blast.init().
+
+inline acc_t gemv_row(fp_ro_t const m, fp_ro_t const v, const int32_t v_stride,
+        const int32_t n, const int32_t width) { // 1, 4 or 16
+    acc_t s = 0;
+    int32_t j = 0;
+    if (width > 1 && v_stride == 1) {
+        const int32_t n4 = n / 4;
+        if (width == 16) {
+            for (; j + 4 <= n4; j += 4) {
+                s += dot(load4(j + 0, m), load4(j + 0, v)) +
+                     dot(load4(j + 1, m), load4(j + 1, v)) +
+                     dot(load4(j + 2, m), load4(j + 2, v)) +
+                     dot(load4(j + 3, m), load4(j + 3, v));
+            }
+        }
+        for (; j < n4; j++) { s += dot(load4(j, m), load4(j, v)); }
+        j = n4 * 4;
+    }
+    for (; j < n; j++) { s += load1(j, m) * load1(j * v_stride, v); }
+    return s;
+}
+
+#define gemv_items(width) do {                                          \
+    const int32_t row = get_global_id(0);                               \
+    if (row < rows) {                                                   \
+        fp_ro_t const m = mx + mx_offset + (int64_t)row * row_stride;   \
+        const acc_t s = gemv_row(m, vc + v_offset, v_stride, n, width); \
+        store1(s, r_offset + row, r);                                   \
+    }                                                                   \
+} while (0)
+
+__kernel void name(gemv, suffix)(
+        fp_ro_t const mx, const int32_t mx_offset, const int32_t row_stride,
+        fp_ro_t const vc, const int32_t v_offset, const int32_t v_stride,
+        fp_wr_t r, const int32_t r_offset, const int32_t rows,
+        const int32_t n) {
+    gemv_items(1);
+}
+
+__kernel void name(gemv4, suffix)(
+        fp_ro_t const mx, const int32_t mx_offset, const int32_t row_stride,
+        fp_ro_t const vc, const int32_t v_offset, const int32_t v_stride,
+        fp_wr_t r, const int32_t r_offset, const int32_t rows,
+        const int32_t n) {
+    gemv_items(4);
+}
+
+__kernel void name(gemv16, suffix)(
+        fp_ro_t const mx, const int32_t mx_offset, const int32_t row_stride,
+        fp_ro_t const vc, const int32_t v_offset, const int32_t v_stride,
+        fp_wr_t r, const int32_t r_offset, const int32_t rows,
+        const int32_t n) {
+    gemv_items(16);
+}
+
+// gemv_wg() assigns a work-group per row of the matrix. Work-items of
+// the group walk the row with vec4 loads (adjacent work-items read adjacent
+// vec4 - coalesced memory access) and reduce partial sums in local memory.
+// row = mx[mx_offset + row * row_stride] ... [+ n - 1]
+// v[i] = vc[v_offset + i * v_stride]
+// r[r_offset + row] = row dot v
+// partial[] is local memory of get_local_size(0) elements.
+
+__kernel void name(gemv_wg, suffix)(
+        fp_ro_t const mx, const int32_t mx_offset, const int32_t row_stride,
+        fp_ro_t const vc, const int32_t v_offset, const int32_t v_stride,
+        fp_wr_t r, const int32_t r_offset, const int32_t n,
+        __local acc_t* partial) {
+    const int32_t row   = get_group_id(0);
+    const int32_t lid   = get_local_id(0);
+    const int32_t items = get_local_size(0);
+    fp_ro_t const m = mx + mx_offset + (int64_t)row * row_stride;
+    fp_ro_t const v = vc + v_offset;
+    acc_t s = 0;
+    if (v_stride == 1) {
+        const int32_t n4 = n / 4;
+        for (int32_t j = lid; j < n4; j += items) {
+            s += dot(load4(j, m), load4(j, v));
+        }
+        for (int32_t j = n4 * 4 + lid; j < n; j += items) {
+            s += load1(j, m) * load1(j, v);
+        }
     } else {
-        r[i] = v[offset + i * stride] + v[offset + (i + m) * stride];
+        for (int32_t j = lid; j < n; j += items) {
+            s += load1(j, m) * load1(j * v_stride, v);
+        }
     }
+    s = group_sum(partial, s);
+    if (lid == 0) { store1(s, r_offset + row, r); }
 }
 
-__kernel void name(sum_even_os, suffix)(fp_ro_t const v,
-        const int32_t offset, const int32_t stride, fp_wr_t r) {
-    const int32_t i = get_global_id(0);
-    const int32_t m = get_global_size(0);
-    r[i] = v[offset + i * stride] + v[offset + (i + m) * stride];
+// gemv_batch() multiplies the matrix by k <= gemv_batch_max vectors
+// in a single pass over the matrix (skinny gemm M[m][n] x V[n][k]):
+// row = mx[mx_offset + row * row_stride] ... [+ n - 1]
+// v[b][j] = vc[v_offset + j * v_stride + b * b_stride]
+// r[r_offset + b * r_stride + row] = row dot v[b]
+// Work-group per row like gemv_wg(): adjacent work-items read adjacent
+// elements of the row (coalesced memory access), every work-item keeps
+// k private sums and the group reduces all of them together in
+// partial[] (k * get_local_size(0) elements of local memory).
+
+#define gemv_batch_max 32
+
+__kernel void name(gemv_batch, suffix)(
+        fp_ro_t const mx, const int32_t mx_offset, const int32_t row_stride,
+        fp_ro_t const vc, const int32_t v_offset, const int32_t v_stride,
+        const int32_t b_stride,
+        fp_wr_t r, const int32_t r_offset, const int32_t r_stride,
+        const int32_t n, const int32_t k,
+        __local acc_t* partial) {
+    const int32_t row   = get_group_id(0);
+    const int32_t lid   = get_local_id(0);
+    const int32_t items = get_local_size(0);
+    fp_ro_t const mr = mx + mx_offset + (int64_t)row * row_stride;
+    acc_t s[gemv_batch_max];
+    // constant trip count with (b < k) guard lets compiler keep s[] in registers
+    for (int32_t b = 0; b < gemv_batch_max; b++) { s[b] = 0; }
+    for (int32_t j = lid; j < n; j += items) {
+        const acc_t x = load1(j, mr);
+        const int32_t jv = v_offset + j * v_stride;
+        for (int32_t b = 0; b < gemv_batch_max; b++) {
+            if (b < k) { s[b] += x * load1(jv + b * b_stride, vc); }
+        }
+    }
+    for (int32_t b = 0; b < gemv_batch_max; b++) {
+        if (b < k) { partial[b * items + lid] = s[b]; }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+    int32_t w = items; // tree reduction of k rows of partial[] at once
+    while (w > 1) {
+        const int32_t h = (w + 1) / 2;
+        if (lid < w - h) {
+            for (int32_t b = 0; b < k; b++) {
+                partial[b * items + lid] += partial[b * items + lid + h];
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        w = h;
+    }
+    for (int32_t b = lid; b < k; b += items) {
+        store1(partial[b * items], r_offset + b * r_stride + row, r);
+    }
 }
 
-// for n = groups * items:
-// dot(x, y, r) does not do summation and to complete operation
-// sum_xxx(r, s[n / 2]), sum_xxx(r, n / 4) ...
-// must be chained after initial dot()
-// _xxx must be _odd or _even depending on oddness of "n" not "n / 2"
+// Block quantized weights (see q8_t and q4_t in quant.h) of 32 elements:
+//   q8: half d, char q[32]               x = d * q
+//   q4: half d, half m, uchar q[16]      x = d * q + m
+//       q[i] low nibble is element i, high nibble is element i + 16
+// gemv_q8() and gemv_q4() are gemv_wg() for quantized matrix: work-group
+// per row, work-items take whole blocks, dequantize them in private
+// memory and accumulate in float. Vector and result are fp_t.
+// mx_offset and row_stride are in blocks.
+
+#define q8_bytes 34
+#define q4_bytes 20
+
+inline float dot_q8(__global const uchar* p, fp_ro_t const v, int32_t stride) {
+    const float d = vload_half(0, (__global const half*)p);
+    __global const char* q = (__global const char*)(p + 2);
+    float s = 0;
+    for (int32_t i = 0; i < 32; i++) {
+        s += (float)q[i] * (float)load1(i * stride, v);
+    }
+    return d * s;
+}
 
-__kernel void name(dot, suffix)(fp_ro_t const v0, fp_ro_t const v1, fp_wr_t r) {
-    const int32_t i = get_global_id(0); // (0) of dimension zero out of 3
-    r[i] = v0[i] * v1[i];
+inline float dot_q4(__global const uchar* p, fp_ro_t const v, int32_t stride) {
+    const float d = vload_half(0, (__global const half*)p);
+    const float m = vload_half(1, (__global const half*)p);
+    __global const uchar* q = p + 4;
+    float s = 0;
+    float x = 0; // sum of vector elements for the m term
+    for (int32_t i = 0; i < 16; i++) {
+        const float v0 = (float)load1(i * stride, v);
+        const float v1 = (float)load1((i + 16) * stride, v);
+        s += (float)(q[i] & 0xF) * v0 + (float)(q[i] >> 4) * v1;
+        x += v0 + v1;
+    }
+    return d * s + m * x;
 }
 
-__kernel void name(dot_os, suffix)(
-        fp_ro_t const v0, const int32_t offset0, const int32_t stride0,
-        fp_ro_t const v1, const int32_t offset1, const int32_t stride1,
-        fp_wr_t r) {
-    const int32_t i = get_global_id(0);
-    r[i] = v0[offset0 + i * stride0] * v1[offset1 + i * stride1];
+#define gemv_q(dot_q, bytes) do {                                       \
+    const int32_t row    = get_group_id(0);                             \
+    const int32_t lid    = get_local_id(0);                             \
+    const int32_t items  = get_local_size(0);                           \
+    const int32_t blocks = n / 32;                                      \
+    __global const uchar* m = mx +                                      \
+        ((int64_t)mx_offset + (int64_t)row * row_stride) * bytes;       \
+    fp_ro_t const v = vc + v_offset;                                    \
+    float s = 0;                                                        \
+    for (int32_t b = lid; b < blocks; b += items) {                     \
+        s += dot_q(m + (int64_t)b * bytes, v + b * 32 * v_stride, v_stride); \
+    }                                                                   \
+    acc_t sum = group_sum(partial, (acc_t)s);                           \
+    if (lid == 0) { store1(sum, r_offset + row, r); }                   \
+} while (0)
+
+__kernel void name(gemv_q8, suffix)(
+        __global const uchar* mx, const int32_t mx_offset, const int32_t row_stride,
+        fp_ro_t const vc, const int32_t v_offset, const int32_t v_stride,
+        fp_wr_t r, const int32_t r_offset, const int32_t n,
+        __local acc_t* partial) {
+    gemv_q(dot_q8, q8_bytes);
 }
 
-// TODO: dot16_fp16(), dot4_fp32(), dot4_fp4() future optimization
+__kernel void name(gemv_q4, suffix)(
+        __global const uchar* mx, const int32_t mx_offset, const int32_t row_stride,
+        fp_ro_t const vc, const int32_t v_offset, const int32_t v_stride,
+        fp_wr_t r, const int32_t r_offset, const int32_t n,
+        __local acc_t* partial) {
+    gemv_q(dot_q4, q4_bytes);
+}
 
-// gemv General Matrix Multiplication by Vector
-// for k = groups * items:
-// v[n] sequential memory addresses
-// mx[rows][columns] rows == k sequential memory addresses
-// r[k]
+// fp8 weights (see fp8_e4m3_t and fp8_e5m2_t in fp16.h) byte per element:
+//   e4m3: exponent bias 7, no infinities, S.1111.111 is NaN
+//   e5m2: upper byte of half (bias 15, infinities and NaNs)
+// gemv_e4m3() and gemv_e5m2() are gemv_wg() that upconvert weights on
+// load and accumulate in float. mx_offset and row_stride are in elements.
+
+inline float e4m3_to_float(uint b) {
+    const uint e = (b >> 3) & 0xF;
+    const uint m = b & 0x7;
+    const float x = e == 0 ? (float)m * (1.0f / 512) :
+                             as_float(((e + 120) << 23) | (m << 20));
+    return (b & 0x7F) == 0x7F ? NAN : ((b & 0x80) ? -x : x);
+}
 
-__kernel void name(gemv, suffix)(fp_ro_t const mx, fp_ro_t const v,
-        fp_wr_t r, const int32_t n) {
-    const int32_t i = get_global_id(0);
-    fp_ro_t const m = mx + i * n;
-    fp_t s = 0;
-    for (int32_t j = 0; j < n; j++) { s += v[j] * m[j]; }
-    r[i] = s;
+inline float e5m2_to_float(uint b) {
+    const uint e = (b >> 2) & 0x1F;
+    const uint m = b & 0x3;
+    const float x = e == 0  ? (float)m * (1.0f / 65536) :
+                    e == 31 ? (m == 0 ? INFINITY : NAN) :
+                              as_float(((e + 112) << 23) | (m << 21));
+    return (b & 0x80) ? -x : x;
 }
 
-#ifndef fp16_surrogate
+#define gemv_fp8(to_float) do {                                         \
+    const int32_t row   = get_group_id(0);                              \
+    const int32_t lid   = get_local_id(0);                              \
+    const int32_t items = get_local_size(0);                            \
+    __global const uchar* m = mx + (int64_t)mx_offset +                 \
+                              (int64_t)row * row_stride;                \
+    fp_ro_t const v = vc + v_offset;                                    \
+    float s = 0;                                                        \
+    for (int32_t j = lid; j < n; j += items) {                          \
+        s += to_float(m[j]) * (float)load1(j * v_stride, v);            \
+    }                                                                   \
+    acc_t sum = group_sum(partial, (acc_t)s);                           \
+    if (lid == 0) { store1(sum, r_offset + row, r); }                   \
+} while (0)
+
+__kernel void name(gemv_e4m3, suffix)(
+        __global const uchar* mx, const int32_t mx_offset, const int32_t row_stride,
+        fp_ro_t const vc, const int32_t v_offset, const int32_t v_stride,
+        fp_wr_t r, const int32_t r_offset, const int32_t n,
+        __local acc_t* partial) {
+    gemv_fp8(e4m3_to_float);
+}
 
-__kernel void name(gemv4, suffix)(fp_ro_t mx, fp_ro_t v, fp_wr_t r, int32_t n) {
-    const int32_t i = get_global_id(0);
-    fp_ro_t m = mx + i * n;
-    fp_t s = 0;
-    while (n > 4) {
-        s += dot(*(__global vec4*)v, *(__global vec4*)m);
-        v += 4; m += 4; n -= 4;
+__kernel void name(gemv_e5m2, suffix)(
+        __global const uchar* mx, const int32_t mx_offset, const int32_t row_stride,
+        fp_ro_t const vc, const int32_t v_offset, const int32_t v_stride,
+        fp_wr_t r, const int32_t r_offset, const int32_t n,
+        __local acc_t* partial) {
+    gemv_fp8(e5m2_to_float);
+}
+
+// Level 1 element-wise kernels walk the vectors in grid-stride loops,
+// thus any n is covered by at most max_groups work-groups. Compact (_c)
+// kernels have unit strides and move 4 elements per iteration with
+// vector loads and stores, the first work-item also does the last
+// n % 4 elements. Offset and stride (_os) kernels move one element
+// per iteration. Arithmetic is in acc_t (float for fp16 and bf16), the
+// compiler is free to contract a * x + y into mad() or fma().
+// copy() and swap() move raw bits.
+
+#define raw_ro_t __global const raw_t*
+#define raw_rw_t __global raw_t*
+
+#define grid_stride(i, count)                                           \
+    for (int32_t i = get_global_id(0); i < (count); i += get_global_size(0))
+
+#define tail(i, n) if (get_global_id(0) == 0) for (int32_t i = (n) & ~3; i < (n); i++)
+
+__kernel void name(copy_c, suffix)(
+        fp_ro_t x, const int32_t ox, fp_wr_t y, const int32_t oy,
+        const int32_t n) {
+    raw_ro_t const a = (raw_ro_t)(x + ox);
+    raw_rw_t const b = (raw_rw_t)(y + oy);
+    grid_stride(i, n / 4) { vstore4(vload4(i, a), i, b); }
+    tail(i, n) { b[i] = a[i]; }
+}
+
+__kernel void name(copy_os, suffix)(
+        fp_ro_t x, const int32_t ox, const int32_t sx,
+        fp_wr_t y, const int32_t oy, const int32_t sy, const int32_t n) {
+    raw_ro_t const a = (raw_ro_t)(x + ox);
+    raw_rw_t const b = (raw_rw_t)(y + oy);
+    grid_stride(i, n) { b[i * sy] = a[i * sx]; }
+}
+
+__kernel void name(swap_c, suffix)(
+        fp_wr_t x, const int32_t ox, fp_wr_t y, const int32_t oy,
+        const int32_t n) {
+    raw_rw_t const a = (raw_rw_t)(x + ox);
+    raw_rw_t const b = (raw_rw_t)(y + oy);
+    grid_stride(i, n / 4) {
+        const raw4_t t = vload4(i, a);
+        vstore4(vload4(i, b), i, a);
+        vstore4(t, i, b);
     }
-    while (n > 0) {
-        s += *v++ * *m++;
-        n--;
+    tail(i, n) { const raw_t t = a[i]; a[i] = b[i]; b[i] = t; }
+}
+
+__kernel void name(swap_os, suffix)(
+        fp_wr_t x, const int32_t ox, const int32_t sx,
+        fp_wr_t y, const int32_t oy, const int32_t sy, const int32_t n) {
+    raw_rw_t const a = (raw_rw_t)(x + ox);
+    raw_rw_t const b = (raw_rw_t)(y + oy);
+    grid_stride(i, n) {
+        const raw_t t = a[i * sx];
+        a[i * sx] = b[i * sy];
+        b[i * sy] = t;
     }
-    r[i] = s;
 }
 
-#endif
+__kernel void name(scal_c, suffix)(const acc_t alpha,
+        fp_wr_t x, const int32_t ox, const int32_t n) {
+    fp_wr_t const a = x + ox;
+    grid_stride(i, n / 4) { store4(alpha * load4(i, a), i, a); }
+    tail(i, n) { store1(alpha * load1(i, a), i, a); }
+}
+
+__kernel void name(scal_os, suffix)(const acc_t alpha,
+        fp_wr_t x, const int32_t ox, const int32_t sx, const int32_t n) {
+    fp_wr_t const a = x + ox;
+    grid_stride(i, n) { store1(alpha * load1(i * sx, a), i * sx, a); }
+}
+
+// mad_c() and mad_os() are axpy() y = alpha * x + y
+
+__kernel void name(mad_c, suffix)(const acc_t alpha,
+        fp_ro_t x, const int32_t ox, fp_wr_t y, const int32_t oy,
+        const int32_t n) {
+    fp_ro_t const a = x + ox;
+    fp_wr_t const b = y + oy;
+    grid_stride(i, n / 4) { store4(alpha * load4(i, a) + load4(i, b), i, b); }
+    tail(i, n) { store1(alpha * load1(i, a) + load1(i, b), i, b); }
+}
+
+__kernel void name(mad_os, suffix)(const acc_t alpha,
+        fp_ro_t x, const int32_t ox, const int32_t sx,
+        fp_wr_t y, const int32_t oy, const int32_t sy, const int32_t n) {
+    fp_ro_t const a = x + ox;
+    fp_wr_t const b = y + oy;
+    grid_stride(i, n) {
+        store1(alpha * load1(i * sx, a) + load1(i * sy, b), i * sy, b);
+    }
+}
+
+// rot_c() and rot_os() x, y = c * x + s * y, c * y - s * x
+
+__kernel void name(rot_c, suffix)(const acc_t c, const acc_t s,
+        fp_wr_t x, const int32_t ox, fp_wr_t y, const int32_t oy,
+        const int32_t n) {
+    fp_wr_t const a = x + ox;
+    fp_wr_t const b = y + oy;
+    grid_stride(i, n / 4) {
+        const acc4_t xi = load4(i, a);
+        const acc4_t yi = load4(i, b);
+        store4(c * xi + s * yi, i, a);
+        store4(c * yi - s * xi, i, b);
+    }
+    tail(i, n) {
+        const acc_t xi = load1(i, a);
+        const acc_t yi = load1(i, b);
+        store1(c * xi + s * yi, i, a);
+        store1(c * yi - s * xi, i, b);
+    }
+}
+
+__kernel void name(rot_os, suffix)(const acc_t c, const acc_t s,
+        fp_wr_t x, const int32_t ox, const int32_t sx,
+        fp_wr_t y, const int32_t oy, const int32_t sy, const int32_t n) {
+    fp_wr_t const a = x + ox;
+    fp_wr_t const b = y + oy;
+    grid_stride(i, n) {
+        const acc_t xi = load1(i * sx, a);
+        const acc_t yi = load1(i * sy, b);
+        store1(c * xi + s * yi, i * sx, a);
+        store1(c * yi - s * xi, i * sy, b);
+    }
+}
+
+// Level 1 reductions are computed in two dispatches like dot():
+// 1. *_os() kernels make a single pass over the vector and leave one
+//    partial result per work-group
+// 2. a single work-group combines the partial results and stores the
+//    result (sum() and asum() reuse sum_partials())
+// nrm2() keeps (scale, ssq) pairs that stand for scale^2 * ssq with
+// scale = max(|x[i]|), so squares neither overflow nor underflow acc_t.
+// iamax() and iamin() keep (|x[i]|, i) pairs, NaNs are skipped and ties
+// go to the smallest index.
+
+#define reduce_os(f) do {                                               \
+    acc_t s = 0;                                                        \
+    grid_stride(i, n) { const acc_t v = load1(ox + i * sx, x); s += f; }\
+    s = group_sum(partial, s);                                          \
+    if (get_local_id(0) == 0) { r[get_group_id(0)] = s; }               \
+} while (0)
+
+__kernel void name(sum_os, suffix)(
+        fp_ro_t const x, const int32_t ox, const int32_t sx,
+        const int32_t n, __global acc_t* r, __local acc_t* partial) {
+    reduce_os(v);
+}
+
+__kernel void name(asum_os, suffix)(
+        fp_ro_t const x, const int32_t ox, const int32_t sx,
+        const int32_t n, __global acc_t* r, __local acc_t* partial) {
+    reduce_os(fabs(v));
+}
+
+// nrm2_merge() adds scale^2 * ssq (a NaN scale poisons the result)
+
+inline void nrm2_merge(acc_t* scale, acc_t* ssq, const acc_t s, const acc_t q) {
+    if (isnan(s)) {
+        *scale = s;
+    } else if (s > *scale) {
+        const acc_t t = *scale / s;
+        *ssq = q + *ssq * (t * t);
+        *scale = s;
+    } else if (s > 0) {
+        const acc_t t = s == *scale ? 1 : s / *scale;
+        *ssq += q * (t * t);
+    }
+}
+
+// group_nrm2() is group_sum() for (scale, ssq) pairs in partial[2 * items]
+// the result is returned to the first work-item of the group.
+
+inline void group_nrm2(__local acc_t* partial, acc_t* scale, acc_t* ssq) {
+    const int32_t i = get_local_id(0);
+    int32_t n = get_local_size(0);
+    __local acc_t* q = partial + n;
+    partial[i] = *scale;
+    q[i] = *ssq;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    while (n > 1) {
+        const int32_t h = (n + 1) / 2;
+        if (i < n - h) {
+            nrm2_merge(scale, ssq, partial[i + h], q[i + h]);
+            partial[i] = *scale;
+            q[i] = *ssq;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        n = h;
+    }
+}
+
+// nrm2_os() leaves r[group * 2] = scale, r[group * 2 + 1] = ssq
+
+__kernel void name(nrm2_os, suffix)(
+        fp_ro_t const x, const int32_t ox, const int32_t sx,
+        const int32_t n, __global acc_t* r, __local acc_t* partial) {
+    acc_t scale = 0;
+    acc_t ssq = 0;
+    grid_stride(i, n) { nrm2_merge(&scale, &ssq, fabs(load1(ox + i * sx, x)), 1); }
+    group_nrm2(partial, &scale, &ssq);
+    if (get_local_id(0) == 0) {
+        r[get_group_id(0) * 2] = scale;
+        r[get_group_id(0) * 2 + 1] = ssq;
+    }
+}
+
+// nrm2_partials() must be enqueued as a single work-group.
+
+__kernel void name(nrm2_partials, suffix)(__global const acc_t* v,
+        const int32_t n, fp_wr_t r, const int32_t offset,
+        __local acc_t* partial) {
+    const int32_t items = get_local_size(0);
+    acc_t scale = 0;
+    acc_t ssq = 0;
+    for (int32_t i = get_local_id(0); i < n; i += items) {
+        nrm2_merge(&scale, &ssq, v[i * 2], v[i * 2 + 1]);
+    }
+    group_nrm2(partial, &scale, &ssq);
+    if (get_local_id(0) == 0) { store1(scale * sqrt(ssq), offset, r); }
+}
+
+inline bool amax_better(const bool minimum, const acc_t a, const int32_t i,
+        const acc_t b, const int32_t j) {
+    return (minimum ? a < b : a > b) || (a == b && i < j);
+}
+
+// group_amax() reduces (v, k) pairs in pv[items] and pk[items]
+// the result is returned to the first work-item of the group.
+
+inline void group_amax(const bool minimum, __local acc_t* pv,
+        __local int32_t* pk, acc_t* v, int32_t* k) {
+    const int32_t i = get_local_id(0);
+    int32_t n = get_local_size(0);
+    pv[i] = *v;
+    pk[i] = *k;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    while (n > 1) {
+        const int32_t h = (n + 1) / 2;
+        if (i < n - h && amax_better(minimum, pv[i + h], pk[i + h], *v, *k)) {
+            *v = pv[i + h];
+            *k = pk[i + h];
+            pv[i] = *v;
+            pk[i] = *k;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+        n = h;
+    }
+}
+
+// amax_os() leaves (rv[group], rk[group]) pairs, rk[group] == INT_MAX
+// when the work-group has seen only NaNs (or nothing)
+
+inline void amax_os(const bool minimum,
+        fp_ro_t const x, const int32_t ox, const int32_t sx,
+        const int32_t n, __global acc_t* rv, __global int32_t* rk,
+        __local acc_t* pv, __local int32_t* pk) {
+    acc_t v = minimum ? INFINITY : -1;
+    int32_t k = INT_MAX;
+    grid_stride(i, n) {
+        const acc_t a = fabs(load1(ox + i * sx, x));
+        if (amax_better(minimum, a, i, v, k)) { v = a; k = i; }
+    }
+    group_amax(minimum, pv, pk, &v, &k);
+    if (get_local_id(0) == 0) {
+        rv[get_group_id(0)] = v;
+        rk[get_group_id(0)] = k;
+    }
+}
+
+// amax_partials() must be enqueued as a single work-group, it stores
+// the index into int32_t r[offset] (0 if all elements are NaNs)
+
+inline void amax_partials(const bool minimum,
+        __global const acc_t* rv, __global const int32_t* rk,
+        const int32_t n, __global int32_t* r, const int32_t offset,
+        __local acc_t* pv, __local int32_t* pk) {
+    const int32_t items = get_local_size(0);
+    acc_t v = minimum ? INFINITY : -1;
+    int32_t k = INT_MAX;
+    for (int32_t i = get_local_id(0); i < n; i += items) {
+        if (amax_better(minimum, rv[i], rk[i], v, k)) { v = rv[i]; k = rk[i]; }
+    }
+    group_amax(minimum, pv, pk, &v, &k);
+    if (get_local_id(0) == 0) { r[offset] = k == INT_MAX ? 0 : k; }
+}
+
+__kernel void name(iamax_os, suffix)(
+        fp_ro_t const x, const int32_t ox, const int32_t sx,
+        const int32_t n, __global acc_t* rv, __global int32_t* rk,
+        __local acc_t* pv, __local int32_t* pk) {
+    amax_os(false, x, ox, sx, n, rv, rk, pv, pk);
+}
+
+__kernel void name(iamin_os, suffix)(
+        fp_ro_t const x, const int32_t ox, const int32_t sx,
+        const int32_t n, __global acc_t* rv, __global int32_t* rk,
+        __local acc_t* pv, __local int32_t* pk) {
+    amax_os(true, x, ox, sx, n, rv, rk, pv, pk);
+}
+
+__kernel void name(iamax_partials, suffix)(
+        __global const acc_t* rv, __global const int32_t* rk,
+        const int32_t n, __global int32_t* r, const int32_t offset,
+        __local acc_t* pv, __local int32_t* pk) {
+    amax_partials(false, rv, rk, n, r, offset, pv, pk);
+}
+
+__kernel void name(iamin_partials, suffix)(
+        __global const acc_t* rv, __global const int32_t* rk,
+        const int32_t n, __global int32_t* r, const int32_t offset,
+        __local acc_t* pv, __local int32_t* pk) {
+    amax_partials(true, rv, rk, n, r, offset, pv, pk);
+}
 
 // example, for:
 // mx = [ m00 m01 m02 m03 ]
@@ -185,64 +834,9 @@ __kernel void name(gemv_os, suffix)(
     const int32_t i = get_global_id(0);
     fp_ro_t m = mx + mx_offset + i * row_stride;
     fp_ro_t v = vc + offset;
-    fp_t s = 0;
+    acc_t s = 0;
     for (int32_t j = 0; j < n; j++) {
-        s += v[j * stride] * mx[j * column_stride];
-    }
-    r[i] = s;
-}
-
-#if defined(fp16_t) && defined(fp16_surrogate)
-
-#define fp16ro_t __global const fp16_t*
-#define fp16wr_t __global fp16_t*
-
-inline float dot_fp16x4(fp16ro_t const a, fp16ro_t const b) {
-    return dot((float4)*a, (float4)*b);
-}
-
-inline float dot_fp16x8(fp16ro_t a, fp16ro_t b) {
-    return dot_fp16x4(a + 0, b + 0) + dot_fp16x4(a +  4, b +  4);
-}
-
-inline float dot_fp16x16(fp16ro_t a, fp16ro_t b) {
-    return dot_fp16x8(a + 0, b + 0) + dot_fp16x8(a +  8, b +  8);
-}
-
-__kernel void gemv4_fp16(fp16ro_t mx, fp16ro_t v, fp16wr_t r, int32_t n) {
-    const int32_t i = get_global_id(0);
-    fp16ro_t m = mx + i * n;
-    fp32_t s = 0;
-    while (n >= 4) {
-        s += dot_fp16x4(v, m);
-        n -= 4; v += 4; m += 4;
-    }
-    while (n >= 0) {
-        s += *v++ * *m++; n--;
+        s += load1(j * stride, v) * load1(j * column_stride, m);
     }
-    r[i] = (fp16_t)s;
+    store1(s, i, r);
 }
-
-__kernel void gemv16_fp16(fp16ro_t mx, fp16ro_t v, fp16wr_t r, int32_t n) {
-    const int32_t i = get_global_id(0);
-    fp16ro_t m = mx + i * n;
-    fp32_t s = 0;
-    while (n >= 16) {
-        s += dot_fp16x16(v, m);
-        n -= 16; v += 16; m += 16;
-    }
-    while (n >= 8) {
-        s += dot_fp16x8(v, m);
-        n -= 8; v += 8; m += 8;
-    }
-    while (n >= 4) {
-        s += dot_fp16x4(v, m);
-        n -= 4; v += 4; m += 4;
-    }
-    while (n >= 0) {
-        s += *v++ * *m++; n--;
-    }
-    r[i] = (fp16_t)s;
-}
-
-#endif // fp16_surrogate
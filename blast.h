@@ -7,10 +7,22 @@ extern "C"
 #endif
 
 // float point precision index
-enum { blast_fpp16 = 0, blast_fpp32 = 1, blast_fpp64 = 2 };
+// bf16 is bf16_t (see fp16.h) computed in fp32_t, it does not require
+// device support for half or double.
+enum { blast_fpp16 = 0, blast_fpp32 = 1, blast_fpp64 = 2, blast_fppbf16 = 3 };
 
-extern const char* blast_fpp_names[3];
-extern const int   blast_fpp_bytes[3]; // { 2, 4, 8 }
+extern const char* blast_fpp_names[4];
+extern const int   blast_fpp_bytes[4]; // { 2, 4, 8, 2 }
+
+// quantized matrix formats of gemv_q(), layouts of q8_t and q4_t
+// in quant.h: 32 elements per block with fp16_t scale (and min for q4)
+// fp8_e4m3_t and fp8_e5m2_t in fp16.h: blocks of a single element
+enum { blast_format_q8 = 0, blast_format_q4 = 1,
+       blast_format_e4m3 = 2, blast_format_e5m2 = 3 };
+
+extern const char* blast_format_names[4];
+extern const int   blast_format_bytes[4]; // bytes per block { 34, 20, 1, 1 }
+extern const int   blast_format_block[4]; // elements per block { 32, 32, 1, 1 }
 
 enum { // .allocate()/.map() flags
     blast_access_read  = 0, // not a bitset!
@@ -24,39 +36,201 @@ typedef struct blast_memory_s { // treat as read only, will change don't cache
     void*   m; // mapped memory address in virtual memory. TODO: can be eliminated?
     void*   h; // handle
     int64_t s; // size in bytes
+    int64_t mo; // mapped range offset in bytes (valid when m != null)
+    int64_t ms; // mapped range size in bytes
+    int32_t access; // blast_access_*
     blast_t* b;
 } blast_memory_t;
 
+// Small device buffers (up to max_groups * max_items fp64_t elements) are
+// recycled through power of 2 size classes instead of being released to
+// the driver. Scratch buffers of dot(), gemv() and reductions come from the
+// pool, so repeated calls do not allocate in steady state.
+
+enum {
+    blast_pool_min_bytes = 256, // size of class 0, class k is 256 << k
+    blast_pool_classes   = 24,
+    blast_pool_depth     = 4    // free buffers kept per access x class
+};
+
+typedef struct blast_pool_s {
+    int64_t max_bytes; // larger allocations bypass the pool
+    int32_t count[3][blast_pool_classes]; // [access][class]
+    ocl_memory_t free[3][blast_pool_classes][blast_pool_depth];
+} blast_pool_t;
+
+// Adaptive dispatch: dot_auto() and gemv_auto() run on the device only
+// when the problem is at least as large as the crossover. Crossovers are
+// measured at blast.init() or loaded from the cache written by earlier
+// runs. Smaller problems, precisions the device lacks and operands that
+// are currently mapped by the caller are computed by dot.c on the host
+// directly in the mapped device memory without copying.
+// With BLAST_CALIBRATE=1 in the environment gemv() on the device also
+// uses the fastest of its kernel variants for the shape class of the
+// matrix (few or many rows, short or long rows), otherwise always gemv_wg.
+
+enum { // gemv() kernel variants, see gemv_wg(), gemv(), gemv4() in blast.cl
+    blast_gemv_wg     = 0, // work-group per row (default)
+    blast_gemv_item   = 1, // work-item per row
+    blast_gemv_item4  = 2, // work-item per row, vec4 loads
+    blast_gemv_item16 = 3  // work-item per row, 4 vec4 loads per iteration
+};
+
+typedef struct blast_crossover_s { // INT64_MAX: host is always faster
+    int64_t dot[4];  // n
+    int64_t gemv[4]; // m * n
+    int32_t gemv_variant[4][4]; // [fpp][shape class] blast_gemv_*
+} blast_crossover_t;
+
+enum { blast_batch_max = 32 }; // max number of vectors of gemv_batch()
+
+typedef struct blast_dot_pair_s { // dot_batch() pair of vectors
+    int64_t offset0; // in elements
+    int64_t stride0;
+    int64_t offset1;
+    int64_t stride1;
+    int64_t n;
+} blast_dot_pair_t;
+
+typedef struct blast_event_s { // completion handle of async operation
+    ocl_event_t e;
+} blast_event_t;
+
 typedef struct blast_s {
     ocl_context_t* c;
+    blast_pool_t pool;
+    blast_crossover_t crossover;
     // BLAS like operations
     // The offset parameters could be useful when multiple tensors reside in
     // a single memory region.
     // The function pointers below can be null if fp16 or fp64 is not supported:
     // dot()
-    fp64_t (*dot[3])(
+    fp64_t (*dot[4])(
         blast_memory_t* v0, int64_t offset0, int64_t stride0,
         blast_memory_t* v1, int64_t offset1, int64_t stride1, int64_t n);
-    // gemv()
-    void (*gemv[3])(
+    // dot_batch() result[offset_r + k] = dot() of pairs[k] vectors of v0
+    // and v1 rounded to fpp precision for k in [0..count). All products
+    // are computed in a single dispatch and the result memory can be
+    // mapped once (in-order command queue). Meant for many short pairs.
+    void (*dot_batch[4])(blast_memory_t* v0, blast_memory_t* v1,
+        const blast_dot_pair_t* pairs, int64_t count,
+        blast_memory_t* result, int64_t offset_r);
+    // gemv() result[i] = matrix[offset_m + i * stride_m][0..n-1] dot vector
+    // stride_m is the distance between rows in elements (stride_m >= n)
+    void (*gemv[4])(
+        blast_memory_t* matrix/*[m][n]*/, int64_t offset_m, int64_t stride_m,
+        blast_memory_t* vector/*[n]*/,    int64_t offset_v, int64_t stride_v,
+        blast_memory_t* result/*[m]*/, int64_t m, int64_t n);
+    // gemv_batch() multiplies the matrix by k vectors in a single pass:
+    // result[b * stride_r + i] = matrix row i dot vector b
+    // vector b element j is vectors[offset_v + j * stride_v + b * stride_b]
+    // for b in [0..k), k <= blast_batch_max. V[n][k] is stride_v = k,
+    // stride_b = 1 and k consecutive vectors is stride_v = 1, stride_b = n.
+    void (*gemv_batch[4])(
+        blast_memory_t* matrix/*[m][n]*/, int64_t offset_m, int64_t stride_m,
+        blast_memory_t* vectors, int64_t offset_v, int64_t stride_v,
+        int64_t stride_b,
+        blast_memory_t* result/*[k][stride_r]*/, int64_t stride_r,
+        int64_t m, int64_t n, int64_t k);
+    // gemv_q() is gemv() of quantized matrix [format] by fpp vector.
+    // offset_m, stride_m and n are in elements, multiples of the format
+    // blast_format_block[format] (32 for q8 and q4, 1 for fp8)
+    void (*gemv_q[4][4])(
+        blast_memory_t* matrix/*[m][n]*/, int64_t offset_m, int64_t stride_m,
+        blast_memory_t* vector/*[n]*/,    int64_t offset_v, int64_t stride_v,
+        blast_memory_t* result/*[m]*/, int64_t m, int64_t n);
+    // dot_auto() and gemv_auto() are never null, see blast_crossover_t
+    fp64_t (*dot_auto[4])(
+        blast_memory_t* v0, int64_t offset0, int64_t stride0,
+        blast_memory_t* v1, int64_t offset1, int64_t stride1, int64_t n);
+    void (*gemv_auto[4])(
+        blast_memory_t* matrix/*[m][n]*/, int64_t offset_m, int64_t stride_m,
+        blast_memory_t* vector/*[n]*/,    int64_t offset_v, int64_t stride_v,
+        blast_memory_t* result/*[m]*/, int64_t m, int64_t n);
+    // Asynchronous dot() and gemv() return as soon as the kernels are
+    // enqueued. dot_async() stores the result rounded to fpp precision
+    // into result[offset_r]. See blast.wait(), blast.poll(), blast.then().
+    blast_event_t (*dot_async[4])(
+        blast_memory_t* v0, int64_t offset0, int64_t stride0,
+        blast_memory_t* v1, int64_t offset1, int64_t stride1, int64_t n,
+        blast_memory_t* result, int64_t offset_r);
+    blast_event_t (*gemv_async[4])(
         blast_memory_t* matrix/*[m][n]*/, int64_t offset_m, int64_t stride_m,
         blast_memory_t* vector/*[n]*/,    int64_t offset_v, int64_t stride_v,
         blast_memory_t* result/*[m]*/, int64_t m, int64_t n);
+    // Level 1 element-wise operations, offsets and strides are in elements,
+    // unit strides use compact kernels with vector loads and stores.
+    // x and y must not overlap. Scalars are rounded to fp32_t for fp16
+    // and bf16. Results are available to the following operations
+    // without waiting (in-order command queue).
+    // axpy() y = a * x + y
+    void (*axpy[4])(fp64_t a,
+        blast_memory_t* x, int64_t offset_x, int64_t stride_x,
+        blast_memory_t* y, int64_t offset_y, int64_t stride_y, int64_t n);
+    // scal() x = a * x
+    void (*scal[4])(fp64_t a,
+        blast_memory_t* x, int64_t offset_x, int64_t stride_x, int64_t n);
+    // copy() y = x bit exact
+    void (*copy[4])(
+        blast_memory_t* x, int64_t offset_x, int64_t stride_x,
+        blast_memory_t* y, int64_t offset_y, int64_t stride_y, int64_t n);
+    // swap() x <-> y bit exact
+    void (*swap[4])(
+        blast_memory_t* x, int64_t offset_x, int64_t stride_x,
+        blast_memory_t* y, int64_t offset_y, int64_t stride_y, int64_t n);
+    // rot() x, y = c * x + s * y, c * y - s * x
+    void (*rot[4])(fp64_t c, fp64_t s,
+        blast_memory_t* x, int64_t offset_x, int64_t stride_x,
+        blast_memory_t* y, int64_t offset_y, int64_t stride_y, int64_t n);
+    // Level 1 reductions store the result into result[offset_r] without
+    // a map per scalar: several results can share a small result memory
+    // mapped once after all of them are enqueued (in-order command queue).
+    // sum(), asum() and nrm2() results are fp_t rounded to fpp precision,
+    // iamax() and iamin() results are int32_t indices of the first element
+    // with the largest (smallest) |x[i]|, NaNs are skipped (0 if all are).
+    // sum() x[0] + x[1] + ... + x[n - 1]
+    void (*sum[4])(blast_memory_t* x, int64_t offset_x, int64_t stride_x,
+        int64_t n, blast_memory_t* result, int64_t offset_r);
+    // asum() |x[0]| + |x[1]| + ... + |x[n - 1]|
+    void (*asum[4])(blast_memory_t* x, int64_t offset_x, int64_t stride_x,
+        int64_t n, blast_memory_t* result, int64_t offset_r);
+    // nrm2() sqrt(x[0]^2 + ... + x[n - 1]^2) scaled, does not overflow
+    void (*nrm2[4])(blast_memory_t* x, int64_t offset_x, int64_t stride_x,
+        int64_t n, blast_memory_t* result, int64_t offset_r);
+    void (*iamax[4])(blast_memory_t* x, int64_t offset_x, int64_t stride_x,
+        int64_t n, blast_memory_t* result/*int32_t[]*/, int64_t offset_r);
+    void (*iamin[4])(blast_memory_t* x, int64_t offset_x, int64_t stride_x,
+        int64_t n, blast_memory_t* result/*int32_t[]*/, int64_t offset_r);
     // kernels are properties of c.c ocl_context:
-    ocl_kernel_t dot_c[3];   // compact
-    ocl_kernel_t dot_os[3];  // offset + stride
-    ocl_kernel_t sum_odd[3];
-    ocl_kernel_t sum_odd_os[3];
-    ocl_kernel_t sum_even[3];
-    ocl_kernel_t sum_even_os[3];
-    ocl_kernel_t gemv_c[3];
-    ocl_kernel_t gemv_os[3];
-    // TODO:
-    // TODO:
-    ocl_kernel_t copy[3]; // for performance measurements
-    ocl_kernel_t fma_os[3];
-    ocl_kernel_t mad_c[3];
-    ocl_kernel_t mad_os[3];
+    ocl_kernel_t dot_c[4];   // compact
+    ocl_kernel_t dot_os[4];  // offset + stride
+    ocl_kernel_t dot_batch_k[4]; // work-group per pair
+    ocl_kernel_t sum_partials[4];
+    ocl_kernel_t gemv_c[4];   // work-item per row
+    ocl_kernel_t gemv4_c[4];  // ... vec4
+    ocl_kernel_t gemv16_c[4]; // ... 4 x vec4
+    ocl_kernel_t gemv_os[4];
+    ocl_kernel_t gemv_wg[4]; // work-group per row
+    ocl_kernel_t gemv_batch_k[4]; // work-group per row, k vectors
+    ocl_kernel_t gemv_q_k[4][4];  // [format][fpp]
+    ocl_kernel_t copy_c[4];  // Level 1 element-wise compact
+    ocl_kernel_t copy_os[4]; // and offset + stride
+    ocl_kernel_t swap_c[4];
+    ocl_kernel_t swap_os[4];
+    ocl_kernel_t scal_c[4];
+    ocl_kernel_t scal_os[4];
+    ocl_kernel_t mad_c[4];   // axpy()
+    ocl_kernel_t mad_os[4];
+    ocl_kernel_t rot_c[4];
+    ocl_kernel_t rot_os[4];
+    ocl_kernel_t sum_os[4];  // Level 1 reductions
+    ocl_kernel_t asum_os[4];
+    ocl_kernel_t nrm2_os[4];
+    ocl_kernel_t nrm2_partials[4];
+    ocl_kernel_t iamax_os[4];
+    ocl_kernel_t iamin_os[4];
+    ocl_kernel_t iamax_partials[4];
+    ocl_kernel_t iamin_partials[4];
 } blast_t;
 
 typedef struct blast_if {
@@ -70,6 +244,12 @@ typedef struct blast_if {
     // and unmap before invocation of any other blast operation
     void* (*map)(blast_memory_t* gm, int access, int64_t offset, int64_t bytes);
     void  (*unmap)(blast_memory_t* gm);
+    // completion of asynchronous operations:
+    void (*wait)(blast_event_t* e); // waits and releases the handle
+    bool (*poll)(blast_event_t* e); // true if operation has completed
+    // done(that) is called on a driver thread when operation completes,
+    // the handle still must be released with .wait()
+    void (*then)(blast_event_t* e, void (*done)(void* that), void* that);
     void (*fini)(blast_t* b);
 } blast_if;
 
@@ -81,23 +261,23 @@ extern blast_if blast;
 
 #ifdef TODO // (on "as needed" basis)
     Level 1 BLAS (14 subprograms):
-    [ ] asum
-        axpy
-        copy
+    [x] asum
+    [x] axpy
+    [x] copy
     [x] dot
-        iamax
-        nrm2
-        rot
+    [x] iamax
+    [x] nrm2
+    [x] rot
         rotg
         rotm
         rotmg
-        scal
-        swap
+    [x] scal
+    [x] swap
         sdsdot
         dsdot
 
     Level 2 BLAS (6 subprograms):
-    [ ] gemv
+    [x] gemv
         gbmv
         hemv
         hbmv
@@ -4,6 +4,8 @@
 #include <math.h>
 #include <immintrin.h>
 #include "dot.h"
+#include "isa.h"
+#include "workers.h"
 
 // prefetch2_L1L2L3 - reportedly on 11th gen Intel processors it is 64 bytes (512 bits)
 #define prefetch2_L1L2L3(v0, v1) do {             \
@@ -15,14 +17,22 @@
 
 typedef struct avx2_if {
     void   (*init)(void);
+    fp64_t (*dot16_c)(const fp16_t* restrict v0, const fp16_t* restrict v1, int64_t n);
+    fp64_t (*dot16_s)(const fp16_t* v0, int64_t s0, const fp16_t* v1, int64_t s1, int64_t n);
+    fp64_t (*dot32_s)(const fp32_t* v0, int64_t s0, const fp32_t* v1, int64_t s1, int64_t n);
+    fp64_t (*dot64_s)(const fp64_t* v0, int64_t s0, const fp64_t* v1, int64_t s1, int64_t n);
     fp64_t (*dot32_c)(const fp32_t* restrict v0, const fp32_t* restrict v1, int64_t n);
     fp64_t (*dot64_c)(const fp64_t* restrict v0, const fp64_t* restrict v1, int64_t n);
+    fp64_t (*dotbf16_c)(const bf16_t* restrict v0, const bf16_t* restrict v1, int64_t n);
 } avx2_if;
 
 typedef struct avx512_if {
     void   (*init)(void);
     fp64_t (*dot32_c)(const fp32_t* restrict v0, const fp32_t* restrict v1, int64_t n);
     fp64_t (*dot64_c)(const fp64_t* restrict v0, const fp64_t* restrict v1, int64_t n);
+    fp64_t (*dot32_s)(const fp32_t* v0, int64_t s0, const fp32_t* v1, int64_t s1, int64_t n);
+    fp64_t (*dot64_s)(const fp64_t* v0, int64_t s0, const fp64_t* v1, int64_t s1, int64_t n);
+    fp64_t (*dotbf16_c)(const bf16_t* restrict v0, const bf16_t* restrict v1, int64_t n);
 } avx512_if;
 
 // _MM_HINT_T0 (temporal data)  prefetch data into all levels of the caches.
@@ -87,9 +97,30 @@ static inline fp64_t cpu_dot64_s(const fp64_t* restrict v0, int64_t s0,
     return sum;
 }
 
+static inline fp64_t cpu_dotbf16_c(const bf16_t* restrict v0,
+        const bf16_t* restrict v1, int64_t n) {
+    fp64_t sum = 0;
+    const bf16_t* e = v0 + n;
+    while (v0 < e) { sum += bf16to32(*v0++) * bf16to32(*v1++); }
+    return sum;
+}
+
+static inline fp64_t cpu_dotbf16_s(const bf16_t* restrict v0, int64_t s0,
+        const bf16_t* restrict v1, int64_t s1, int64_t n) {
+    fp64_t sum = 0;
+    while (n > 0) { sum += bf16to32(*v0) * bf16to32(*v1); v0 += s0; v1 += s1; n--; }
+    return sum;
+}
+
 static fp64_t dot16_c(const fp16_t *v0, const fp16_t* v1, int64_t n) {
     prefetch2_L1L2L3(v0, v1);
-    return cpu_dot16_c(v0, v1, n);
+    static bool init;
+    if (!init) { avx2.init(); avx512.init(); init = true;}
+    if (n >= 8 && avx2.dot16_c != null) {
+        return avx2.dot16_c(v0, v1, n);
+    } else {
+        return cpu_dot16_c(v0, v1, n);
+    }
 }
 
 static fp64_t dot32_c(const fp32_t *v0, const fp32_t* v1, int64_t n) {
@@ -118,11 +149,149 @@ static fp64_t dot64_c(const fp64_t *v0, const fp64_t* v1, int64_t n) {
     }
 }
 
+static fp64_t dotbf16_c(const bf16_t *v0, const bf16_t* v1, int64_t n) {
+    prefetch2_L1L2L3(v0, v1);
+    static bool init;
+    if (!init) { avx2.init(); avx512.init(); init = true;}
+    if (n >= 32 && avx512.dotbf16_c != null) {
+        return avx512.dotbf16_c(v0, v1, n);
+    } else if (n >= 8 && avx2.dotbf16_c != null) {
+        return avx2.dotbf16_c(v0, v1, n);
+    } else {
+        return cpu_dotbf16_c(v0, v1, n);
+    }
+}
+
+// Strided vectors: for small positive strides elements are gathered
+// (_mm256_i32gather_*) directly into registers. For larger strides every
+// element lives in its own cache line anyway, so blocks of dot_pack
+// elements are first copied (transposed) into contiguous L1 resident
+// buffers and passed to the compact kernels.
+
+enum {
+    dot_gather_min_n      = 16,
+    dot_gather_max_stride = 16,
+    dot_pack              = 512 // elements
+};
+
+static bool dot_gather(int64_t s0, int64_t s1, int64_t n) {
+    return n >= dot_gather_min_n &&
+           1 <= s0 && s0 <= dot_gather_max_stride &&
+           1 <= s1 && s1 <= dot_gather_max_stride;
+}
+
+static fp64_t dot16_p(const fp16_t* v0, int64_t s0, const fp16_t* v1,
+        int64_t s1, int64_t n) {
+    fp16_t a0[dot_pack];
+    fp16_t a1[dot_pack];
+    fp64_t sum = 0;
+    while (n > 0) {
+        const int64_t k = min(n, (int64_t)dot_pack);
+        const fp16_t* p0 = v0;
+        const fp16_t* p1 = v1;
+        if (s0 != 1) { for (int64_t i = 0; i < k; i++) { a0[i] = v0[i * s0]; } p0 = a0; }
+        if (s1 != 1) { for (int64_t i = 0; i < k; i++) { a1[i] = v1[i * s1]; } p1 = a1; }
+        sum += dot16_c(p0, p1, k);
+        v0 += k * s0; v1 += k * s1; n -= k;
+    }
+    return sum;
+}
+
+static fp64_t dot32_p(const fp32_t* v0, int64_t s0, const fp32_t* v1,
+        int64_t s1, int64_t n) {
+    fp32_t a0[dot_pack];
+    fp32_t a1[dot_pack];
+    fp64_t sum = 0;
+    while (n > 0) {
+        const int64_t k = min(n, (int64_t)dot_pack);
+        const fp32_t* p0 = v0;
+        const fp32_t* p1 = v1;
+        if (s0 != 1) { for (int64_t i = 0; i < k; i++) { a0[i] = v0[i * s0]; } p0 = a0; }
+        if (s1 != 1) { for (int64_t i = 0; i < k; i++) { a1[i] = v1[i * s1]; } p1 = a1; }
+        sum += dot32_c(p0, p1, k);
+        v0 += k * s0; v1 += k * s1; n -= k;
+    }
+    return sum;
+}
+
+static fp64_t dot64_p(const fp64_t* v0, int64_t s0, const fp64_t* v1,
+        int64_t s1, int64_t n) {
+    fp64_t a0[dot_pack];
+    fp64_t a1[dot_pack];
+    fp64_t sum = 0;
+    while (n > 0) {
+        const int64_t k = min(n, (int64_t)dot_pack);
+        const fp64_t* p0 = v0;
+        const fp64_t* p1 = v1;
+        if (s0 != 1) { for (int64_t i = 0; i < k; i++) { a0[i] = v0[i * s0]; } p0 = a0; }
+        if (s1 != 1) { for (int64_t i = 0; i < k; i++) { a1[i] = v1[i * s1]; } p1 = a1; }
+        sum += dot64_c(p0, p1, k);
+        v0 += k * s0; v1 += k * s1; n -= k;
+    }
+    return sum;
+}
+
+// bf16_t has no gather kernels, strided vectors are always packed:
+
+static fp64_t dotbf16_p(const bf16_t* v0, int64_t s0, const bf16_t* v1,
+        int64_t s1, int64_t n) {
+    bf16_t a0[dot_pack];
+    bf16_t a1[dot_pack];
+    fp64_t sum = 0;
+    while (n > 0) {
+        const int64_t k = min(n, (int64_t)dot_pack);
+        const bf16_t* p0 = v0;
+        const bf16_t* p1 = v1;
+        if (s0 != 1) { for (int64_t i = 0; i < k; i++) { a0[i] = v0[i * s0]; } p0 = a0; }
+        if (s1 != 1) { for (int64_t i = 0; i < k; i++) { a1[i] = v1[i * s1]; } p1 = a1; }
+        sum += dotbf16_c(p0, p1, k);
+        v0 += k * s0; v1 += k * s1; n -= k;
+    }
+    return sum;
+}
+
+static fp64_t dot16_s(const fp16_t* v0, int64_t s0, const fp16_t* v1,
+        int64_t s1, int64_t n) {
+    if (dot_gather(s0, s1, n) && avx2.dot16_s != null) {
+        return avx2.dot16_s(v0, s0, v1, s1, n);
+    } else if (n >= dot_gather_min_n) {
+        return dot16_p(v0, s0, v1, s1, n);
+    } else {
+        return cpu_dot16_s(v0, s0, v1, s1, n);
+    }
+}
+
+static fp64_t dot32_s(const fp32_t* v0, int64_t s0, const fp32_t* v1,
+        int64_t s1, int64_t n) {
+    if (dot_gather(s0, s1, n) && avx512.dot32_s != null) {
+        return avx512.dot32_s(v0, s0, v1, s1, n);
+    } else if (dot_gather(s0, s1, n) && avx2.dot32_s != null) {
+        return avx2.dot32_s(v0, s0, v1, s1, n);
+    } else if (n >= dot_gather_min_n) {
+        return dot32_p(v0, s0, v1, s1, n);
+    } else {
+        return cpu_dot32_s(v0, s0, v1, s1, n);
+    }
+}
+
+static fp64_t dot64_s(const fp64_t* v0, int64_t s0, const fp64_t* v1,
+        int64_t s1, int64_t n) {
+    if (dot_gather(s0, s1, n) && avx512.dot64_s != null) {
+        return avx512.dot64_s(v0, s0, v1, s1, n);
+    } else if (dot_gather(s0, s1, n) && avx2.dot64_s != null) {
+        return avx2.dot64_s(v0, s0, v1, s1, n);
+    } else if (n >= dot_gather_min_n) {
+        return dot64_p(v0, s0, v1, s1, n);
+    } else {
+        return cpu_dot64_s(v0, s0, v1, s1, n);
+    }
+}
+
 fp64_t dot16(const fp16_t* v0, int64_t s0, const fp16_t* v1, int64_t s1, int64_t n) {
     if (s0 == 1 && s1 == 1) {
         return dot16_c(v0, v1, n);
     } else {
-        return cpu_dot16_s(v0, s0, v1, s1, n);
+        return dot16_s(v0, s0, v1, s1, n);
     }
 }
 
@@ -130,7 +299,7 @@ fp64_t dot32(const fp32_t* v0, int64_t s0, const fp32_t* v1, int64_t s1, int64_t
     if (s0 == 1 && s1 == 1) {
         return dot32_c(v0, v1, n);
     } else {
-        return cpu_dot32_s(v0, s0, v1, s1, n);
+        return dot32_s(v0, s0, v1, s1, n);
     }
 }
 
@@ -138,10 +307,101 @@ fp64_t dot64(const fp64_t* v0, int64_t s0, const fp64_t* v1, int64_t s1, int64_t
     if (s0 == 1 && s1 == 1) {
         return dot64_c(v0, v1, n);
     } else {
-        return cpu_dot64_s(v0, s0, v1, s1, n);
+        return dot64_s(v0, s0, v1, s1, n);
+    }
+}
+
+fp64_t dotbf16(const bf16_t* v0, int64_t s0, const bf16_t* v1, int64_t s1, int64_t n) {
+    if (s0 == 1 && s1 == 1) {
+        return dotbf16_c(v0, v1, n);
+    } else if (n >= dot_gather_min_n) {
+        return dotbf16_p(v0, s0, v1, s1, n);
+    } else {
+        return cpu_dotbf16_s(v0, s0, v1, s1, n);
+    }
+}
+
+// Parallel dot splits vectors into chunks, computes partial sums of
+// chunks on the workers pool and adds them in chunk order. The chunk size
+// only depends on n, thus results are reproducible and do not depend on
+// the number of threads or scheduling.
+
+enum {
+    dot_mt_chunk  = 64 * 1024, // elements, minimum chunk size
+    dot_mt_chunks = 1024       // maximum number of chunks
+};
+
+typedef struct dot_mt_s {
+    const void* v0;
+    int64_t s0;
+    const void* v1;
+    int64_t s1;
+    int64_t n;
+    int64_t chunk;
+    fp64_t (*dot)(const void* v0, int64_t s0, const void* v1, int64_t s1,
+                  int64_t n);
+    int32_t bytes; // element size
+    fp64_t  sum[dot_mt_chunks];
+} dot_mt_t;
+
+static void dot_mt_job(void* that, int32_t i) {
+    dot_mt_t* d = (dot_mt_t*)that;
+    const int64_t from = i * d->chunk;
+    const int64_t n = min(d->chunk, d->n - from);
+    const byte_t* v0 = (const byte_t*)d->v0 + from * d->s0 * d->bytes;
+    const byte_t* v1 = (const byte_t*)d->v1 + from * d->s1 * d->bytes;
+    d->sum[i] = d->dot(v0, d->s0, v1, d->s1, n);
+}
+
+static fp64_t dot_mt(dot_mt_t* d) {
+    if (d->n < 2 * dot_mt_chunk || workers.count() == 1) {
+        return d->dot(d->v0, d->s0, d->v1, d->s1, d->n);
+    } else {
+        d->chunk = max((int64_t)dot_mt_chunk,
+                       (d->n + dot_mt_chunks - 1) / dot_mt_chunks);
+        const int32_t chunks = (int32_t)((d->n + d->chunk - 1) / d->chunk);
+        workers.run(dot_mt_job, d, chunks);
+        fp64_t sum = 0;
+        for (int32_t i = 0; i < chunks; i++) { sum += d->sum[i]; }
+        return sum;
     }
 }
 
+// dot16(), dot32() and dot64() called via common signature:
+
+static fp64_t dot_mt_16(const void* v0, int64_t s0, const void* v1,
+        int64_t s1, int64_t n) {
+    return dot16((const fp16_t*)v0, s0, (const fp16_t*)v1, s1, n);
+}
+
+static fp64_t dot_mt_32(const void* v0, int64_t s0, const void* v1,
+        int64_t s1, int64_t n) {
+    return dot32((const fp32_t*)v0, s0, (const fp32_t*)v1, s1, n);
+}
+
+static fp64_t dot_mt_64(const void* v0, int64_t s0, const void* v1,
+        int64_t s1, int64_t n) {
+    return dot64((const fp64_t*)v0, s0, (const fp64_t*)v1, s1, n);
+}
+
+fp64_t dot16_mt(const fp16_t* v0, int64_t s0, const fp16_t* v1, int64_t s1, int64_t n) {
+    dot_mt_t d = { .v0 = v0, .s0 = s0, .v1 = v1, .s1 = s1, .n = n,
+                   .dot = dot_mt_16, .bytes = sizeof(fp16_t) };
+    return dot_mt(&d);
+}
+
+fp64_t dot32_mt(const fp32_t* v0, int64_t s0, const fp32_t* v1, int64_t s1, int64_t n) {
+    dot_mt_t d = { .v0 = v0, .s0 = s0, .v1 = v1, .s1 = s1, .n = n,
+                   .dot = dot_mt_32, .bytes = sizeof(fp32_t) };
+    return dot_mt(&d);
+}
+
+fp64_t dot64_mt(const fp64_t* v0, int64_t s0, const fp64_t* v1, int64_t s1, int64_t n) {
+    dot_mt_t d = { .v0 = v0, .s0 = s0, .v1 = v1, .s1 = s1, .n = n,
+                   .dot = dot_mt_64, .bytes = sizeof(fp64_t) };
+    return dot_mt(&d);
+}
+
 // f64_t fp64_t
 #define f64x2_t __m128d
 #define f64x4_t __m256d
@@ -156,98 +416,427 @@ fp64_t dot64(const fp64_t* v0, int64_t s0, const fp64_t* v1, int64_t s1, int64_t
 #define f16x16_t __m256bh
 #define f16x32_t __m512bh
 
-static fp64_t avx2_dot_f32(const fp32_t* restrict v0, const fp32_t* restrict v1,
+isa_target("avx2")
+static inline fp64_t avx2_sum_f32x8(f32x8_t v) {
+    f32x4_t f32x4 = _mm_add_ps(_mm256_castps256_ps128(v),  // 0,1,2,3
+                               _mm256_extractf128_ps(v, 1)); // 4,5,6,7
+    f32x4 = _mm_hadd_ps(f32x4, f32x4);
+    f32x4 = _mm_hadd_ps(f32x4, f32x4);
+    return _mm_cvtss_f32(f32x4);
+}
+
+// F16C _mm256_cvtph_ps() widens 8 x fp16_t to fp32_t. Products are not
+// rounded to fp16_t (unlike cpu_dot16_c) and accumulate in fp32_t
+// for blocks of 4K elements that are summed in fp64_t, so the result
+// does not degrade with the length of vectors.
+
+isa_target("avx2,fma,f16c")
+static fp64_t avx2_dot_f16(const fp16_t* restrict v0, const fp16_t* restrict v1,
         int64_t n) {
+    enum { block = 4 * 1024 };
     fp64_t sum = 0;
-    if (n >= 8) {
+    while (n >= 8) {
         f32x8_t mul_add_f32x8 = _mm256_setzero_ps();
-        while (n >= 8) {
-            f32x8_t a = _mm256_loadu_ps(v0);
-            f32x8_t b = _mm256_loadu_ps(v1);
-            n -= 8; v0 += 8; v1 += 8;
-            if (n > 0) { prefetch2_L1L2L3(v0, v1); }
+        int64_t k = n < block ? n & ~7LL : block;
+        n -= k;
+        while (k > 0) {
+            f32x8_t a = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)v0));
+            f32x8_t b = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)v1));
+            k -= 8; v0 += 8; v1 += 8;
+            if (k > 0) { prefetch2_L1L2L3(v0, v1); }
             mul_add_f32x8 = _mm256_fmadd_ps(a, b, mul_add_f32x8);
         }
-        f32x4_t f32x4 = _mm_add_ps(
-            _mm256_extractf32x4_ps(mul_add_f32x8, 0),  // 0,1,2,3
-            _mm256_extractf32x4_ps(mul_add_f32x8, 1)); // 4,5,6,7
-        sum = f32x4.m128_f32[0] + f32x4.m128_f32[1] + f32x4.m128_f32[2] + f32x4.m128_f32[3];
+        sum += avx2_sum_f32x8(mul_add_f32x8);
     }
-    if (n > 0) { sum += cpu_dot32_c(v0, v1, n); }
+    while (n > 0) { sum += fp16to32(*v0++) * fp16to32(*v1++); n--; }
     return sum;
 }
 
-static fp64_t avx2_dot_f64(const fp64_t* restrict v0,
-        const fp64_t* restrict v1, int64_t n) {
+// bf16_t is widened to fp32_t by shifting into the upper half of 32-bit
+// lanes. Two accumulators, fp32_t blocks of 4K elements summed in fp64_t
+// as in avx2_dot_f16().
+
+isa_target("avx2,fma")
+static fp64_t avx2_dot_bf16(const bf16_t* restrict v0, const bf16_t* restrict v1,
+        int64_t n) {
+    enum { block = 4 * 1024 };
+    #pragma push_macro("load")
+    #define load(p) _mm256_castsi256_ps(_mm256_slli_epi32(                 \
+        _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(p))), 16))
     fp64_t sum = 0;
-    if (n >= 4) {
-        f64x4_t mul_add_f64x4 = _mm256_setzero_pd();
-        while (n >= 4) {
-            f64x4_t a = _mm256_loadu_pd(v0);
-            f64x4_t b = _mm256_loadu_pd(v1);
-            n -= 4; v0 +=4; v1 += 4;
-            if (n > 0) { prefetch2_L1L2L3(v0, v1); }
-            mul_add_f64x4 = _mm256_fmadd_pd(a, b, mul_add_f64x4);
+    while (n >= 16) {
+        f32x8_t a0 = _mm256_setzero_ps();
+        f32x8_t a1 = _mm256_setzero_ps();
+        int64_t k = n < block ? n & ~15LL : block;
+        n -= k;
+        while (k > 0) {
+            a0 = _mm256_fmadd_ps(load(v0), load(v1), a0);
+            a1 = _mm256_fmadd_ps(load(v0 + 8), load(v1 + 8), a1);
+            k -= 16; v0 += 16; v1 += 16;
+            if (k > 0) { prefetch2_L1L2L3(v0, v1); }
         }
-        f64x2_t f64x2 = _mm_add_pd(
-            _mm256_castpd256_pd128(mul_add_f64x4),     // 0, 1
-            _mm256_extractf64x2_pd(mul_add_f64x4, 1)); // 2, 3
-        sum = f64x2.m128d_f64[0] + f64x2.m128d_f64[1];
+        sum += avx2_sum_f32x8(_mm256_add_ps(a0, a1));
     }
-    if (n > 0) { sum += cpu_dot64_c(v0, v1, n); }
+    #pragma pop_macro("load")
+    while (n > 0) { sum += bf16to32(*v0++) * bf16to32(*v1++); n--; }
     return sum;
 }
 
-// avx512:
+// AVX512-BF16 _mm512_dpbf16_ps() multiplies 32 pairs of bf16_t and adds
+// adjacent products into 16 fp32_t lanes in a single instruction. The
+// tail is loaded with a mask (zeros do not change the sum).
 
-static fp64_t avx512_dot_f32(const fp32_t* restrict v0, const fp32_t* restrict v1, int64_t n) {
+#if defined(__GNUC__) || defined(__clang__)
+#define dot_bh(v) ((f16x32_t)(v)) // __m512bh is a distinct vector type
+#else
+#define dot_bh(v) (v)
+#endif
+
+isa_target("avx512f,avx512bw,avx512bf16")
+static fp64_t avx512_dot_bf16(const bf16_t* restrict v0, const bf16_t* restrict v1,
+        int64_t n) {
+    enum { block = 4 * 1024 };
     fp64_t sum = 0;
-    if (n >= 16) {
-        f32x16_t mul_add_f32x16 = _mm512_setzero_ps(); // multiply and add
-        while (n >= 16) {
-            f32x16_t a = _mm512_loadu_ps(v0); // f32x8
-            f32x16_t b = _mm512_loadu_ps(v1); // f32x8
-            n -= 16; v0 +=16; v1 += 16;
-            if (n > 0) { prefetch2_L1L2L3(v0, v1); }
-            mul_add_f32x16 = _mm512_fmadd_ps(a, b, mul_add_f32x16);
+    while (n > 0) {
+        f32x16_t a0 = _mm512_setzero_ps();
+        f32x16_t a1 = _mm512_setzero_ps();
+        int64_t k = min(n, (int64_t)block);
+        n -= k;
+        while (k >= 64) {
+            a0 = _mm512_dpbf16_ps(a0, dot_bh(_mm512_loadu_si512(v0)),
+                                      dot_bh(_mm512_loadu_si512(v1)));
+            a1 = _mm512_dpbf16_ps(a1, dot_bh(_mm512_loadu_si512(v0 + 32)),
+                                      dot_bh(_mm512_loadu_si512(v1 + 32)));
+            k -= 64; v0 += 64; v1 += 64;
+            if (k > 0) { prefetch2_L1L2L3(v0, v1); }
         }
-        // Reduce the 512-bit sum to a single 128-bit sum using AVX
-        f32x8_t f32x8 = _mm256_add_ps(
-            _mm512_castps512_ps256(mul_add_f32x16),     // 0,1,2,3,4,5,6,7
-            _mm512_extractf32x8_ps(mul_add_f32x16, 1)); // 8,9,10,11,12,13,14,15
-        f32x4_t f32x4 = _mm_add_ps(
-            _mm256_castps256_ps128(f32x8),     // 0,1,2,3
-            _mm256_extractf32x4_ps(f32x8, 1)); // 4,5,6,7
-        sum = f32x4.m128_f32[0] + f32x4.m128_f32[1] + f32x4.m128_f32[2] + f32x4.m128_f32[3];
-    }
-    if (n > 0) { sum += cpu_dot32_c(v0, v1, n); }
+        while (k > 0) {
+            const __mmask32 m = k >= 32 ? 0xFFFFFFFFu : (1u << k) - 1;
+            a0 = _mm512_dpbf16_ps(a0, dot_bh(_mm512_maskz_loadu_epi16(m, v0)),
+                                      dot_bh(_mm512_maskz_loadu_epi16(m, v1)));
+            const int64_t step = min(k, (int64_t)32);
+            k -= step; v0 += step; v1 += step;
+        }
+        sum += _mm512_reduce_add_ps(_mm512_add_ps(a0, a1));
+    }
     return sum;
 }
 
+// FMA latency is 4 cycles and 2 FMAs can issue per cycle, so a single
+// accumulator chain runs at 1/8 of the peak. DOT_UNROLL independent
+// accumulators (tunable at compile time) hide the latency. Tails shorter
+// than a vector are handled with masked loads that do not touch memory
+// past the end of the vectors.
+
+#ifndef DOT_UNROLL
+#define DOT_UNROLL 8 // 1, 2, 4 or 8 accumulators
+#endif
+
+enum { dot_unroll = DOT_UNROLL };
+
+// dot_repeat(f) expands to f(0) f(1) ... f(DOT_UNROLL - 1) so that all
+// accumulators have constant indices and live in registers:
+#if DOT_UNROLL == 1
+#define dot_repeat(f) f(0)
+#elif DOT_UNROLL == 2
+#define dot_repeat(f) f(0) f(1)
+#elif DOT_UNROLL == 4
+#define dot_repeat(f) f(0) f(1) f(2) f(3)
+#elif DOT_UNROLL == 8
+#define dot_repeat(f) f(0) f(1) f(2) f(3) f(4) f(5) f(6) f(7)
+#else
+#error "DOT_UNROLL must be 1, 2, 4 or 8"
+#endif
+
+isa_target("avx2,fma")
+static fp64_t avx2_dot_f32(const fp32_t* restrict v0, const fp32_t* restrict v1,
+        int64_t n) {
+    enum { lanes = 8, step = lanes * dot_unroll };
+    f32x8_t acc[dot_unroll];
+    #pragma push_macro("zero")
+    #pragma push_macro("madd")
+    #pragma push_macro("add")
+    #define zero(k) acc[k] = _mm256_setzero_ps();
+    #define madd(k) acc[k] = _mm256_fmadd_ps(_mm256_loadu_ps(v0 + k * lanes), \
+                                             _mm256_loadu_ps(v1 + k * lanes), acc[k]);
+    #define add(k) if (k > 0) { acc[0] = _mm256_add_ps(acc[0], acc[k]); }
+    dot_repeat(zero)
+    while (n >= step) {
+        dot_repeat(madd)
+        n -= step; v0 += step; v1 += step;
+        if (n > 0) { prefetch2_L1L2L3(v0, v1); }
+    }
+    while (n >= lanes) {
+        acc[0] = _mm256_fmadd_ps(_mm256_loadu_ps(v0), _mm256_loadu_ps(v1), acc[0]);
+        n -= lanes; v0 += lanes; v1 += lanes;
+    }
+    if (n > 0) {
+        __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int32_t)n),
+            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        acc[dot_unroll - 1] = _mm256_fmadd_ps(_mm256_maskload_ps(v0, mask),
+            _mm256_maskload_ps(v1, mask), acc[dot_unroll - 1]);
+    }
+    dot_repeat(add)
+    #pragma pop_macro("add")
+    #pragma pop_macro("madd")
+    #pragma pop_macro("zero")
+    return avx2_sum_f32x8(acc[0]);
+}
+
+isa_target("avx2,fma")
+static fp64_t avx2_dot_f64(const fp64_t* restrict v0,
+        const fp64_t* restrict v1, int64_t n) {
+    enum { lanes = 4, step = lanes * dot_unroll };
+    f64x4_t acc[dot_unroll];
+    #pragma push_macro("zero")
+    #pragma push_macro("madd")
+    #pragma push_macro("add")
+    #define zero(k) acc[k] = _mm256_setzero_pd();
+    #define madd(k) acc[k] = _mm256_fmadd_pd(_mm256_loadu_pd(v0 + k * lanes), \
+                                             _mm256_loadu_pd(v1 + k * lanes), acc[k]);
+    #define add(k) if (k > 0) { acc[0] = _mm256_add_pd(acc[0], acc[k]); }
+    dot_repeat(zero)
+    while (n >= step) {
+        dot_repeat(madd)
+        n -= step; v0 += step; v1 += step;
+        if (n > 0) { prefetch2_L1L2L3(v0, v1); }
+    }
+    while (n >= lanes) {
+        acc[0] = _mm256_fmadd_pd(_mm256_loadu_pd(v0), _mm256_loadu_pd(v1), acc[0]);
+        n -= lanes; v0 += lanes; v1 += lanes;
+    }
+    if (n > 0) {
+        __m256i mask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n),
+            _mm256_setr_epi64x(0, 1, 2, 3));
+        acc[dot_unroll - 1] = _mm256_fmadd_pd(_mm256_maskload_pd(v0, mask),
+            _mm256_maskload_pd(v1, mask), acc[dot_unroll - 1]);
+    }
+    dot_repeat(add)
+    #pragma pop_macro("add")
+    #pragma pop_macro("madd")
+    #pragma pop_macro("zero")
+    f64x2_t f64x2 = _mm_add_pd(
+        _mm256_castpd256_pd128(acc[0]),    // 0, 1
+        _mm256_extractf128_pd(acc[0], 1)); // 2, 3
+    return _mm_cvtsd_f64(_mm_hadd_pd(f64x2, f64x2));
+}
+
+// avx512:
+
+isa_target("avx512f")
+static fp64_t avx512_dot_f32(const fp32_t* restrict v0, const fp32_t* restrict v1, int64_t n) {
+    enum { lanes = 16, step = lanes * dot_unroll };
+    f32x16_t acc[dot_unroll]; // multiply and add
+    #pragma push_macro("zero")
+    #pragma push_macro("madd")
+    #pragma push_macro("add")
+    #define zero(k) acc[k] = _mm512_setzero_ps();
+    #define madd(k) acc[k] = _mm512_fmadd_ps(_mm512_loadu_ps(v0 + k * lanes), \
+                                             _mm512_loadu_ps(v1 + k * lanes), acc[k]);
+    #define add(k) if (k > 0) { acc[0] = _mm512_add_ps(acc[0], acc[k]); }
+    dot_repeat(zero)
+    while (n >= step) {
+        dot_repeat(madd)
+        n -= step; v0 += step; v1 += step;
+        if (n > 0) { prefetch2_L1L2L3(v0, v1); }
+    }
+    while (n > 0) { // at most dot_unroll iterations, last one is masked
+        __mmask16 mask = n >= lanes ? (__mmask16)0xFFFF :
+                                      (__mmask16)((1u << n) - 1);
+        acc[0] = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, v0),
+                                 _mm512_maskz_loadu_ps(mask, v1), acc[0]);
+        n -= lanes; v0 += lanes; v1 += lanes;
+    }
+    dot_repeat(add)
+    #pragma pop_macro("add")
+    #pragma pop_macro("madd")
+    #pragma pop_macro("zero")
+    return _mm512_reduce_add_ps(acc[0]); // AVX512F only sequence
+}
+
+isa_target("avx512f")
 static fp64_t avx512_dot_f64(const fp64_t* restrict v0, const fp64_t* restrict v1, int64_t n) {
+    enum { lanes = 8, step = lanes * dot_unroll };
+    f64x8_t acc[dot_unroll];
+    #pragma push_macro("zero")
+    #pragma push_macro("madd")
+    #pragma push_macro("add")
+    #define zero(k) acc[k] = _mm512_setzero_pd();
+    #define madd(k) acc[k] = _mm512_fmadd_pd(_mm512_loadu_pd(v0 + k * lanes), \
+                                             _mm512_loadu_pd(v1 + k * lanes), acc[k]);
+    #define add(k) if (k > 0) { acc[0] = _mm512_add_pd(acc[0], acc[k]); }
+    dot_repeat(zero)
+    while (n >= step) {
+        dot_repeat(madd)
+        n -= step; v0 += step; v1 += step;
+        if (n > 0) { prefetch2_L1L2L3(v0, v1); }
+    }
+    while (n > 0) {
+        __mmask8 mask = n >= lanes ? (__mmask8)0xFF : (__mmask8)((1u << n) - 1);
+        acc[0] = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, v0),
+                                 _mm512_maskz_loadu_pd(mask, v1), acc[0]);
+        n -= lanes; v0 += lanes; v1 += lanes;
+    }
+    dot_repeat(add)
+    #pragma pop_macro("add")
+    #pragma pop_macro("madd")
+    #pragma pop_macro("zero")
+    return _mm512_reduce_add_pd(acc[0]);
+}
+
+// Gather kernels: indices are relative to the current position, so they
+// never exceed (lanes - 1) * dot_gather_max_stride. Vectors with stride 1
+// are loaded directly.
+
+isa_target("avx2,fma")
+static inline f32x8_t avx2_load_f32_s(const fp32_t* v, int64_t s, __m256i ix) {
+    return s == 1 ? _mm256_loadu_ps(v) : _mm256_i32gather_ps(v, ix, 4);
+}
+
+isa_target("avx2,fma")
+static fp64_t avx2_dot_f32_s(const fp32_t* v0, int64_t s0,
+        const fp32_t* v1, int64_t s1, int64_t n) {
+    enum { lanes = 8 };
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i ix0 = _mm256_mullo_epi32(_mm256_set1_epi32((int32_t)s0), lane);
+    const __m256i ix1 = _mm256_mullo_epi32(_mm256_set1_epi32((int32_t)s1), lane);
+    f32x8_t acc0 = _mm256_setzero_ps();
+    f32x8_t acc1 = _mm256_setzero_ps();
+    while (n >= 2 * lanes) {
+        acc0 = _mm256_fmadd_ps(avx2_load_f32_s(v0, s0, ix0),
+                               avx2_load_f32_s(v1, s1, ix1), acc0);
+        v0 += lanes * s0; v1 += lanes * s1;
+        acc1 = _mm256_fmadd_ps(avx2_load_f32_s(v0, s0, ix0),
+                               avx2_load_f32_s(v1, s1, ix1), acc1);
+        v0 += lanes * s0; v1 += lanes * s1;
+        n -= 2 * lanes;
+    }
+    fp64_t sum = avx2_sum_f32x8(_mm256_add_ps(acc0, acc1));
+    if (n > 0) { sum += cpu_dot32_s(v0, s0, v1, s1, n); }
+    return sum;
+}
+
+isa_target("avx2,fma")
+static inline f64x4_t avx2_load_f64_s(const fp64_t* v, int64_t s, __m128i ix) {
+    return s == 1 ? _mm256_loadu_pd(v) : _mm256_i32gather_pd(v, ix, 8);
+}
+
+isa_target("avx2,fma")
+static fp64_t avx2_dot_f64_s(const fp64_t* v0, int64_t s0,
+        const fp64_t* v1, int64_t s1, int64_t n) {
+    enum { lanes = 4 };
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i ix0 = _mm_mullo_epi32(_mm_set1_epi32((int32_t)s0), lane);
+    const __m128i ix1 = _mm_mullo_epi32(_mm_set1_epi32((int32_t)s1), lane);
+    f64x4_t acc0 = _mm256_setzero_pd();
+    f64x4_t acc1 = _mm256_setzero_pd();
+    while (n >= 2 * lanes) {
+        acc0 = _mm256_fmadd_pd(avx2_load_f64_s(v0, s0, ix0),
+                               avx2_load_f64_s(v1, s1, ix1), acc0);
+        v0 += lanes * s0; v1 += lanes * s1;
+        acc1 = _mm256_fmadd_pd(avx2_load_f64_s(v0, s0, ix0),
+                               avx2_load_f64_s(v1, s1, ix1), acc1);
+        v0 += lanes * s0; v1 += lanes * s1;
+        n -= 2 * lanes;
+    }
+    f64x4_t acc = _mm256_add_pd(acc0, acc1);
+    f64x2_t f64x2 = _mm_add_pd(_mm256_castpd256_pd128(acc),
+                               _mm256_extractf128_pd(acc, 1));
+    fp64_t sum = _mm_cvtsd_f64(_mm_hadd_pd(f64x2, f64x2));
+    if (n > 0) { sum += cpu_dot64_s(v0, s0, v1, s1, n); }
+    return sum;
+}
+
+// There is no 16-bit gather: 32-bit words are gathered at fp16_t addresses
+// and the upper halves dropped. The word at the last element would read
+// past the end of the vector, thus the last element is never gathered.
+
+isa_target("avx2,fma,f16c")
+static inline f32x8_t avx2_load_f16_s(const fp16_t* v, int64_t s, __m256i ix) {
+    if (s == 1) {
+        return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)v));
+    } else {
+        const byte_t* base = (const byte_t*)v; // gather needs byte address
+        __m256i w = _mm256_i32gather_epi32((const int*)base, ix, 2);
+        w = _mm256_and_si256(w, _mm256_set1_epi32(0xFFFF));
+        w = _mm256_packus_epi32(w, w); // 0..3 0..3 4..7 4..7
+        w = _mm256_permute4x64_epi64(w, 0x08); // 0..3 4..7
+        return _mm256_cvtph_ps(_mm256_castsi256_si128(w));
+    }
+}
+
+isa_target("avx2,fma,f16c")
+static fp64_t avx2_dot_f16_s(const fp16_t* v0, int64_t s0,
+        const fp16_t* v1, int64_t s1, int64_t n) {
+    enum { lanes = 8 };
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i ix0 = _mm256_mullo_epi32(_mm256_set1_epi32((int32_t)s0), lane);
+    const __m256i ix1 = _mm256_mullo_epi32(_mm256_set1_epi32((int32_t)s1), lane);
     fp64_t sum = 0;
-    if (n >= 8) {
-        f64x8_t mul_add_f64x8 = _mm512_setzero_pd(); // multiply and add
-        while (n >= 8) {
-            f64x8_t a = _mm512_loadu_pd(v0); // f64x8
-            f64x8_t b = _mm512_loadu_pd(v1); // f64x8
-            n -= 8; v0 +=8; v1 += 8;
-            if (n > 0) { prefetch2_L1L2L3(v0, v1); }
-            mul_add_f64x8 = _mm512_fmadd_pd(a, b, mul_add_f64x8);
-        }
-        // Reduce the 512-bit sum to a single 128-bit sum using AVX
-        f64x4_t f64x4 = _mm256_add_pd(
-                _mm512_castpd512_pd256(mul_add_f64x8),     // 0,1,2,3
-                _mm512_extractf64x4_pd(mul_add_f64x8, 1)); // 4,5,6,7
-        f64x2_t f64x2 = _mm_add_pd(
-            _mm256_castpd256_pd128(f64x4),     // 0,1
-            _mm256_extractf64x2_pd(f64x4, 1)); // 2,3
-        sum = f64x2.m128d_f64[0] + f64x2.m128d_f64[1];
-    }
-    if (n > 0) { sum += cpu_dot64_c(v0, v1, n); }
+    f32x8_t acc = _mm256_setzero_ps();
+    int64_t k = 0; // accumulated in fp32_t for at most 4K elements
+    while (n > lanes) {
+        acc = _mm256_fmadd_ps(avx2_load_f16_s(v0, s0, ix0),
+                              avx2_load_f16_s(v1, s1, ix1), acc);
+        v0 += lanes * s0; v1 += lanes * s1;
+        n -= lanes;
+        k += lanes;
+        if (k == 4 * 1024) { sum += avx2_sum_f32x8(acc); acc = _mm256_setzero_ps(); k = 0; }
+    }
+    sum += avx2_sum_f32x8(acc);
+    while (n > 0) { sum += fp16to32(*v0) * fp16to32(*v1); v0 += s0; v1 += s1; n--; }
     return sum;
 }
 
+isa_target("avx512f")
+static fp64_t avx512_dot_f32_s(const fp32_t* v0, int64_t s0,
+        const fp32_t* v1, int64_t s1, int64_t n) {
+    enum { lanes = 16 };
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                           8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i ix0 = _mm512_mullo_epi32(_mm512_set1_epi32((int32_t)s0), lane);
+    const __m512i ix1 = _mm512_mullo_epi32(_mm512_set1_epi32((int32_t)s1), lane);
+    f32x16_t acc = _mm512_setzero_ps();
+    while (n >= lanes) {
+        acc = _mm512_fmadd_ps(_mm512_i32gather_ps(ix0, v0, 4),
+                              _mm512_i32gather_ps(ix1, v1, 4), acc);
+        v0 += lanes * s0; v1 += lanes * s1;
+        n -= lanes;
+    }
+    if (n > 0) { // masked gather does not touch inactive lanes
+        __mmask16 mask = (__mmask16)((1u << n) - 1);
+        acc = _mm512_fmadd_ps(
+            _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, ix0, v0, 4),
+            _mm512_mask_i32gather_ps(_mm512_setzero_ps(), mask, ix1, v1, 4),
+            acc);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+isa_target("avx512f")
+static fp64_t avx512_dot_f64_s(const fp64_t* v0, int64_t s0,
+        const fp64_t* v1, int64_t s1, int64_t n) {
+    enum { lanes = 8 };
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i ix0 = _mm256_mullo_epi32(_mm256_set1_epi32((int32_t)s0), lane);
+    const __m256i ix1 = _mm256_mullo_epi32(_mm256_set1_epi32((int32_t)s1), lane);
+    f64x8_t acc = _mm512_setzero_pd();
+    while (n >= lanes) {
+        acc = _mm512_fmadd_pd(_mm512_i32gather_pd(ix0, v0, 8),
+                              _mm512_i32gather_pd(ix1, v1, 8), acc);
+        v0 += lanes * s0; v1 += lanes * s1;
+        n -= lanes;
+    }
+    if (n > 0) {
+        __mmask8 mask = (__mmask8)((1u << n) - 1);
+        acc = _mm512_fmadd_pd(
+            _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, ix0, v0, 8),
+            _mm512_mask_i32gather_pd(_mm512_setzero_pd(), mask, ix1, v1, 8),
+            acc);
+    }
+    return _mm512_reduce_add_pd(acc);
+}
+
 // 1. AXV512 on Gen-11 Intel CPU's measures slower then AVX2
 // 2. AVX512-FP16
 // https://cdrdv2-public.intel.com/678970/intel-avx512-fp16.pdf
@@ -259,44 +848,34 @@ static fp64_t avx512_dot_f64(const fp64_t* restrict v0, const fp64_t* restrict v
 // https://learn.microsoft.com/en-us/windows/win32/dxmath/half-data-type
 
 
+// Dispatch tables are filled from CPUID (see isa.c) instead of probing
+// kernels for illegal instruction faults.
+
 static void avx2_init(void) {
-    __try {
-        fp32_t d0[16] = { 0 };
-        fp32_t d1[16] = { 0 };
-        fp64_t r = avx2_dot_f32(d0, d1, countof(d0));
+    isa.init();
+    if (isa.avx2 && isa.fma) {
         avx2.dot32_c = avx2_dot_f32;
-        fatal_if(r != 0); // prevents optimizing out
-    }
-    __except (1) {
-    }
-    __try {
-        fp64_t d0[16] = { 0 };
-        fp64_t d1[16] = { 0 };
-        fp64_t r = avx2_dot_f64(d0, d1, countof(d0));
         avx2.dot64_c = avx2_dot_f64;
-        fatal_if(r != 0);
-    } __except(1) {
+        avx2.dot32_s = avx2_dot_f32_s;
+        avx2.dot64_s = avx2_dot_f64_s;
+        avx2.dotbf16_c = avx2_dot_bf16;
+        if (isa.f16c) {
+            avx2.dot16_c = avx2_dot_f16;
+            avx2.dot16_s = avx2_dot_f16_s;
+        }
     }
 }
 
 static void avx512_init(void) {
-    __try {
-        fp32_t d0[16] = { 0 };
-        fp32_t d1[16] = { 0 };
-        fp64_t r = avx512_dot_f32(d0, d1, countof(d0));
+    isa.init();
+    if (isa.avx512f) {
         avx512.dot32_c = avx512_dot_f32;
-        fatal_if(r != 0);
-    }
-    __except (1) {
-    }
-    __try {
-        fp64_t d0[16] = { 0 };
-        fp64_t d1[16] = { 0 };
-        fp64_t r = avx512_dot_f64(d0, d1, countof(d0));
         avx512.dot64_c = avx512_dot_f64;
-        fatal_if(r != 0);
-    }
-    __except (1) {
+        avx512.dot32_s = avx512_dot_f32_s;
+        avx512.dot64_s = avx512_dot_f64_s;
+        if (isa.avx512bw && isa.avx512bf16) {
+            avx512.dotbf16_c = avx512_dot_bf16;
+        }
     }
 }
 
@@ -304,6 +883,52 @@ static void avx512_init(void) {
 
 #ifndef DOT_TEST
 
+static void test_dot16_c() {
+    fp16_t a[21];
+    fp16_t b[21];
+    for (int i = 0; i < countof(a); i++) {
+        a[i] = fp32to16((fp32_t)(i + 1) / 4);
+        b[i] = fp32to16((fp32_t)(countof(a) - i) / 8);
+    }
+    for (int i = 1; i < countof(a); i++) {
+        fp64_t sum = 0; // all products and sums are exact in fp32_t
+        for (int j = 0; j < i; j++) { sum += fp16to32(a[j]) * fp16to32(b[j]); }
+        if (avx2.dot16_c != null) {
+            fp64_t sum1 = avx2.dot16_c(a, b, i);
+            fatal_if(sum1 != sum, "avx: %.16f expected: %.16f", sum1, sum);
+        }
+    }
+}
+
+static void test_dotbf16() {
+    // small integers are exact in bf16_t and so are their dot products:
+    enum { n = 200 };
+    bf16_t a[n * 3];
+    bf16_t b[n * 3];
+    for (int i = 0; i < countof(a); i++) {
+        a[i] = fp32tobf16((fp32_t)(i % 9 - 4));
+        b[i] = fp32tobf16((fp32_t)(i % 7 - 3));
+    }
+    for (int k = 1; k <= n; k += (k < 40 ? 1 : 17)) {
+        fp64_t sum = 0;
+        for (int j = 0; j < k; j++) { sum += bf16to32(a[j]) * bf16to32(b[j]); }
+        if (avx2.dotbf16_c != null && k >= 8) {
+            fp64_t sum1 = avx2.dotbf16_c(a, b, k);
+            fatal_if(sum1 != sum, "avx2: %.16f expected: %.16f", sum1, sum);
+        }
+        if (avx512.dotbf16_c != null && k >= 32) {
+            fp64_t sum2 = avx512.dotbf16_c(a, b, k);
+            fatal_if(sum2 != sum, "avx512: %.16f expected: %.16f", sum2, sum);
+        }
+        fp64_t sum3 = dotbf16(a, 1, b, 1, k);
+        fatal_if(sum3 != sum, "dotbf16: %.16f expected: %.16f", sum3, sum);
+        sum = 0;
+        for (int j = 0; j < k; j++) { sum += bf16to32(a[j * 3]) * bf16to32(b[j * 2]); }
+        fp64_t sum4 = dotbf16(a, 3, b, 2, k);
+        fatal_if(sum4 != sum, "dotbf16 strided: %.16f expected: %.16f", sum4, sum);
+    }
+}
+
 static void test_dot32_c() {
     fp32_t a[21];
     fp32_t b[21];
@@ -362,13 +987,65 @@ static void test_dot64_c() {
     }
 }
 
+static void test_dot_s() {
+    enum { n = 600, stride = 40 };
+    static fp16_t a16[n * stride], b16[n * stride];
+    static fp32_t a32[n * stride], b32[n * stride];
+    static fp64_t a64[n * stride], b64[n * stride];
+    for (int i = 0; i < n * stride; i++) {
+        a64[i] = a32[i] = (fp32_t)(i % 7 - 3);
+        b64[i] = b32[i] = (fp32_t)(i % 5 - 2);
+        a16[i] = fp32to16(a32[i]);
+        b16[i] = fp32to16(b32[i]);
+    }
+    // gather (strides up to dot_gather_max_stride) and pack paths:
+    static const int strides[] = { 1, 2, 3, 8, 16, 17, 40 };
+    static const int lengths[] = { 1, 15, 16, 17, 33, 513, 600 };
+    for (int i = 0; i < countof(strides); i++) {
+        for (int j = 0; j < countof(strides); j++) {
+            for (int k = 0; k < countof(lengths); k++) {
+                const int s0 = strides[i];
+                const int s1 = strides[j];
+                const int m = lengths[k];
+                fp64_t sum = 0; // exact: small integers
+                for (int e = 0; e < m; e++) { sum += a64[e * s0] * b64[e * s1]; }
+                fatal_if(dot16(a16, s0, b16, s1, m) != sum, "s0: %d s1: %d n: %d", s0, s1, m);
+                fatal_if(dot32(a32, s0, b32, s1, m) != sum, "s0: %d s1: %d n: %d", s0, s1, m);
+                fatal_if(dot64(a64, s0, b64, s1, m) != sum, "s0: %d s1: %d n: %d", s0, s1, m);
+            }
+        }
+    }
+}
+
+static void test_dot_mt() {
+    enum { n = 1024 * 1024 + 123 };
+    fp32_t* a = (fp32_t*)malloc(n * sizeof(fp32_t));
+    fp32_t* b = (fp32_t*)malloc(n * sizeof(fp32_t));
+    fatal_if(a == null || b == null);
+    for (int i = 0; i < n; i++) {
+        a[i] = (fp32_t)(i % 7 - 3);
+        b[i] = (fp32_t)(i % 5 - 2);
+    }
+    fp64_t sum = 0; // exact: all partial sums are small integers
+    for (int i = 0; i < n; i++) { sum += a[i] * b[i]; }
+    fp64_t sum0 = dot32_mt(a, 1, b, 1, n);
+    fatal_if(sum0 != sum, "mt: %.16f expected: %.16f", sum0, sum);
+    fp64_t sum1 = dot32_mt(a, 2, b, 2, n / 2);
+    fp64_t sum2 = dot32(a, 2, b, 2, n / 2);
+    fatal_if(sum1 != sum2, "mt: %.16f expected: %.16f", sum1, sum2);
+    // small n is computed by the calling thread:
+    fatal_if(dot32_mt(a, 1, b, 1, 1000) != dot32(a, 1, b, 1, 1000));
+    free(b);
+    free(a);
+}
+
 static uint64_t flushL1L2L3() {
     enum { count = 16 * 1024 * 1024 }; // 128MB
     uint64_t* L1L2L3 = (uint64_t*)malloc(count * sizeof(uint64_t));
     uint64_t sum = 0;
     if (L1L2L3 != null) {
         memset(L1L2L3, 0xFF, count * sizeof(uint64_t));
-        for (int i = 0; i < countof(L1L2L3); i++) { sum |= L1L2L3[i]; }
+        for (int i = 0; i < count; i++) { sum |= L1L2L3[i]; }
         free(L1L2L3);
     }
     return sum;
@@ -378,8 +1055,50 @@ typedef struct dot_performance_s { // per element
     fp64_t ns_c;
     fp64_t ns_avx2;
     fp64_t ns_avx512;
+    fp64_t ns_mt; // all n vectors as one on all cores
 } dot_performance_t;
 
+static void measure_dot16(int n, dot_performance_t* p) {
+    enum { m = 256 * 1024 };
+    typedef fp16_t vector_t[m];
+    vector_t* a = (vector_t*)malloc(n * sizeof(vector_t));
+    vector_t* b = (vector_t*)malloc(n * sizeof(vector_t));
+    if (a != null && b != null) {
+        fp64_t t = 0;
+        uint32_t seed = 0;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < m; j++) {
+                a[i][j] = fp32to16(random32(&seed) / (fp32_t)UINT32_MAX - 0.5f);
+                b[i][j] = fp32to16(random32(&seed) / (fp32_t)UINT32_MAX - 0.5f);
+            }
+        }
+        // C
+        if (n > 1) { fatal_if(flushL1L2L3() == 0); }
+        fp64_t ns_c = seconds() * NSEC_IN_SEC;
+        for (int i = 0; i < n; i++) { t += cpu_dot16_c(a[i], b[i], m); }
+        ns_c = seconds() * NSEC_IN_SEC - ns_c;
+        p->ns_c = ns_c / (n * m);
+        // AVX-2 + F16C
+        if (avx2.dot16_c != null) {
+            if (n > 1) { fatal_if(flushL1L2L3() == 0); }
+            fp64_t ns_avx2 = seconds() * NSEC_IN_SEC;
+            for (int i = 0; i < n; i++) { t += avx2.dot16_c(a[i], b[i], m); }
+            ns_avx2 = seconds() * NSEC_IN_SEC - ns_avx2;
+            p->ns_avx2 = ns_avx2 / (n * m);
+        }
+        // multithreaded
+        if (n > 1) { fatal_if(flushL1L2L3() == 0); }
+        fp64_t ns_mt = seconds() * NSEC_IN_SEC;
+        t += dot16_mt(a[0], 1, b[0], 1, (int64_t)n * m);
+        ns_mt = seconds() * NSEC_IN_SEC - ns_mt;
+        p->ns_mt = ns_mt / (n * m);
+        // t referenced to prevent compiler from optimizing out
+        fatal_if(t == 0); // what are the odds of that?!
+    }
+    free(b); // free(null) is OK
+    free(a);
+}
+
 static void measure_dot32(int n, dot_performance_t* p) {
     enum { m = 128 * 1024 };
     typedef fp32_t vector_t[m];
@@ -417,6 +1136,12 @@ static void measure_dot32(int n, dot_performance_t* p) {
             ns_avx512 = seconds() * NSEC_IN_SEC - ns_avx512;
             p->ns_avx512 = ns_avx512 / (n * m);
         }
+        // multithreaded
+        if (n > 1) { fatal_if(flushL1L2L3() == 0); }
+        fp64_t ns_mt = seconds() * NSEC_IN_SEC;
+        t += dot32_mt(a[0], 1, b[0], 1, (int64_t)n * m);
+        ns_mt = seconds() * NSEC_IN_SEC - ns_mt;
+        p->ns_mt = ns_mt / (n * m);
         // t referenced to prevent compiler from optimizing out
         fatal_if(t == 0); // what are the odds of that?!
     }
@@ -460,6 +1185,12 @@ static void measure_dot64(int n, dot_performance_t* p) {
             ns_avx512 = seconds() * NSEC_IN_SEC - ns_avx512;
             p->ns_avx512 = ns_avx512 / (n * m);
         }
+        // multithreaded
+        if (n > 1) { fatal_if(flushL1L2L3() == 0); }
+        fp64_t ns_mt = seconds() * NSEC_IN_SEC;
+        t += dot64_mt(a[0], 1, b[0], 1, (int64_t)n * m);
+        ns_mt = seconds() * NSEC_IN_SEC - ns_mt;
+        p->ns_mt = ns_mt / (n * m);
         // t referenced to prevent compiler from optimizing out
         fatal_if(t == 0); // what are the odds of that?!
     }
@@ -476,6 +1207,7 @@ static void performance(int n, int bestof, dot_performance_t* m,
         m->ns_c      = min(m->ns_c, p.ns_c);
         m->ns_avx2   = min(m->ns_avx2, p.ns_avx2);
         m->ns_avx512 = min(m->ns_avx512, p.ns_avx512);
+        m->ns_mt     = min(m->ns_mt, p.ns_mt);
     }
 }
 
@@ -491,10 +1223,16 @@ static void report_preformance(dot_performance_t* p, const char* label) {
     traceln("C     : %7.3f Gflops", gfps_c);
     if (p->ns_avx2   != 0) { traceln("avx2  : %7.3f Gflops", gfps_avx2); }
     if (p->ns_avx512 != 0) { traceln("avx512: %7.3f Gflops", gfps_avx512); }
+    if (p->ns_mt != 0) {
+        traceln("x%-3d  : %7.3f Gflops", workers.count(), 2.0 / p->ns_mt);
+    }
 }
 
 static void dot_test_performance() {
     dot_performance_t p = {0};
+    performance(1,   100, &p, measure_dot16); report_preformance(&p, "fp16 L1");
+    performance(128,  25, &p, measure_dot16); report_preformance(&p, "fp16 RAM");
+    p = (dot_performance_t){0};
     performance(1,   100, &p, measure_dot32); report_preformance(&p, "fp32 L1");
     performance(128,  25, &p, measure_dot32); report_preformance(&p, "fp32 RAM");
     performance(1,   100, &p, measure_dot64); report_preformance(&p, "fp64 L1");
@@ -503,13 +1241,17 @@ static void dot_test_performance() {
 
 void dot_init() {
     static bool init;
-    if (!init) { avx2.init(); avx512.init(); init = true; }
+    if (!init) { avx2.init(); avx512.init(); workers.init(); init = true; }
 }
 
 void dot_test() {
     dot_init();
+    test_dot16_c();
+    test_dotbf16();
     test_dot32_c();
     test_dot64_c();
+    test_dot_s();
+    test_dot_mt();
     dot_test_performance();
 }
 
@@ -8,6 +8,13 @@ extern "C" {
 fp64_t dot16(const fp16_t* v0, int64_t s0, const fp16_t* v1, int64_t s1, int64_t n);
 fp64_t dot32(const fp32_t* v0, int64_t s0, const fp32_t* v1, int64_t s1, int64_t n);
 fp64_t dot64(const fp64_t* v0, int64_t s0, const fp64_t* v1, int64_t s1, int64_t n);
+fp64_t dotbf16(const bf16_t* v0, int64_t s0, const bf16_t* v1, int64_t s1, int64_t n);
+
+// multithreaded versions (see workers.h) for large n, same result for
+// any number of threads:
+fp64_t dot16_mt(const fp16_t* v0, int64_t s0, const fp16_t* v1, int64_t s1, int64_t n);
+fp64_t dot32_mt(const fp32_t* v0, int64_t s0, const fp32_t* v1, int64_t s1, int64_t n);
+fp64_t dot64_mt(const fp64_t* v0, int64_t s0, const fp64_t* v1, int64_t s1, int64_t n);
 
 void dot_init();
 void dot_test();
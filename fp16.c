@@ -0,0 +1,334 @@
+#include <immintrin.h>
+#include "rt.h"
+#include "isa.h"
+#include "workers.h"
+
+// Bulk conversions. Results are bit identical to the scalar functions
+// in fp16.h for all inputs including NaNs, infinities and subnormals.
+
+static void cpu_fp16_to_fp32_n(const fp16_t* s, fp32_t* d, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { d[i] = fp16to32(s[i]); }
+}
+
+static void cpu_fp32_to_fp16_n(const fp32_t* s, fp16_t* d, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { d[i] = fp32to16(s[i]); }
+}
+
+isa_target("avx2,f16c")
+static void f16c_fp16_to_fp32_n(const fp16_t* s, fp32_t* d, int64_t n) {
+    int64_t i = 0;
+    while (i + 8 <= n) {
+        _mm256_storeu_ps(d + i,
+            _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(s + i))));
+        i += 8;
+    }
+    cpu_fp16_to_fp32_n(s + i, d + i, n - i);
+}
+
+isa_target("avx2,f16c")
+static void f16c_fp32_to_fp16_n(const fp32_t* s, fp16_t* d, int64_t n) {
+    int64_t i = 0;
+    while (i + 8 <= n) {
+        _mm_storeu_si128((__m128i*)(d + i), _mm256_cvtps_ph(
+            _mm256_loadu_ps(s + i), _MM_FROUND_TO_NEAREST_INT));
+        i += 8;
+    }
+    cpu_fp32_to_fp16_n(s + i, d + i, n - i);
+}
+
+// AVX2 without F16C: exponent is rebiased with integer adds. fp16_t
+// subnormals become fp32_t normals by subtracting pow(2, -14) and
+// fp32_t values below pow(2, -14) are rounded to fp16_t subnormals
+// by adding 0.5f (ulp of 0.5f is pow(2, -24)).
+
+isa_target("avx2")
+static void avx2_fp16_to_fp32_n(const fp16_t* s, fp32_t* d, int64_t n) {
+    const __m256i rebias   = _mm256_set1_epi32((127 - 15) << 23);
+    const __m256i exponent = _mm256_set1_epi32(0x1F << 23);
+    const __m256i hidden   = _mm256_set1_epi32(1 << 23);
+    const __m256i inf      = _mm256_set1_epi32(0x7C00);
+    const __m256i quiet    = _mm256_set1_epi32(0x00400000);
+    const __m256  magic    = _mm256_castsi256_ps(_mm256_set1_epi32(113 << 23));
+    int64_t i = 0;
+    while (i + 8 <= n) {
+        __m256i h = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(s + i)));
+        __m256i a = _mm256_and_si256(h, _mm256_set1_epi32(0x7FFF));
+        __m256i o = _mm256_slli_epi32(a, 13);
+        __m256i e = _mm256_and_si256(o, exponent);
+        o = _mm256_add_epi32(o, rebias);
+        __m256i special = _mm256_cmpeq_epi32(e, exponent); // inf, NaN
+        o = _mm256_add_epi32(o, _mm256_and_si256(special, rebias));
+        __m256i tiny = _mm256_cmpeq_epi32(e, _mm256_setzero_si256());
+        __m256 t = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_add_epi32(o, hidden)), magic);
+        o = _mm256_blendv_epi8(o, _mm256_castps_si256(t), tiny);
+        __m256i nan = _mm256_cmpgt_epi32(a, inf);
+        o = _mm256_or_si256(o, _mm256_and_si256(nan, quiet));
+        __m256i sign = _mm256_slli_epi32(_mm256_xor_si256(h, a), 16);
+        _mm256_storeu_si256((__m256i*)(d + i), _mm256_or_si256(o, sign));
+        i += 8;
+    }
+    cpu_fp16_to_fp32_n(s + i, d + i, n - i);
+}
+
+isa_target("avx2")
+static void avx2_fp32_to_fp16_n(const fp32_t* s, fp16_t* d, int64_t n) {
+    const __m256i abs_mask = _mm256_set1_epi32(0x7FFFFFFF);
+    const __m256i rebias   = _mm256_set1_epi32(0xFFF - ((127 - 15) << 23));
+    const __m256i one      = _mm256_set1_epi32(1);
+    const __m256i normal   = _mm256_set1_epi32(0x38800000); // pow(2, -14)
+    const __m256i big      = _mm256_set1_epi32(0x477FEFFF); // >= 65520: inf
+    const __m256i inf32    = _mm256_set1_epi32(0x7F800000);
+    const __m256i inf      = _mm256_set1_epi32(0x7C00);
+    const __m256i nan16    = _mm256_set1_epi32(0x7E00);
+    const __m256i payload  = _mm256_set1_epi32(0x3FF);
+    const __m256  half     = _mm256_set1_ps(0.5f);
+    int64_t i = 0;
+    while (i + 8 <= n) {
+        __m256i u = _mm256_castps_si256(_mm256_loadu_ps(s + i));
+        __m256i a = _mm256_and_si256(u, abs_mask);
+        __m256i m13 = _mm256_srli_epi32(a, 13);
+        __m256i r = _mm256_add_epi32(_mm256_add_epi32(a, rebias),
+                                     _mm256_and_si256(m13, one));
+        r = _mm256_srli_epi32(r, 13);
+        __m256i t = _mm256_sub_epi32(_mm256_castps_si256(_mm256_add_ps(
+            _mm256_castsi256_ps(a), half)), _mm256_castps_si256(half));
+        r = _mm256_blendv_epi8(r, t, _mm256_cmpgt_epi32(normal, a));
+        r = _mm256_blendv_epi8(r, inf, _mm256_cmpgt_epi32(a, big));
+        r = _mm256_blendv_epi8(r, _mm256_or_si256(nan16, _mm256_and_si256(m13, payload)),
+                               _mm256_cmpgt_epi32(a, inf32));
+        r = _mm256_or_si256(r, _mm256_srli_epi32(_mm256_andnot_si256(abs_mask, u), 16));
+        __m128i h = _mm_packus_epi32(_mm256_castsi256_si128(r),
+                                     _mm256_extracti128_si256(r, 1));
+        _mm_storeu_si128((__m128i*)(d + i), h);
+        i += 8;
+    }
+    cpu_fp32_to_fp16_n(s + i, d + i, n - i);
+}
+
+static void cpu_bf16_to_fp32_n(const bf16_t* s, fp32_t* d, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { d[i] = bf16to32(s[i]); }
+}
+
+static void cpu_fp32_to_bf16_n(const fp32_t* s, bf16_t* d, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { d[i] = fp32tobf16(s[i]); }
+}
+
+isa_target("avx2")
+static void avx2_bf16_to_fp32_n(const bf16_t* s, fp32_t* d, int64_t n) {
+    int64_t i = 0;
+    while (i + 8 <= n) {
+        __m256i u = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(s + i)));
+        _mm256_storeu_ps(d + i, _mm256_castsi256_ps(_mm256_slli_epi32(u, 16)));
+        i += 8;
+    }
+    cpu_bf16_to_fp32_n(s + i, d + i, n - i);
+}
+
+isa_target("avx2")
+static void avx2_fp32_to_bf16_n(const fp32_t* s, bf16_t* d, int64_t n) {
+    const __m256i abs_mask = _mm256_set1_epi32(0x7FFFFFFF);
+    const __m256i inf      = _mm256_set1_epi32(0x7F800000);
+    const __m256i quiet    = _mm256_set1_epi32(0x00400000);
+    const __m256i half     = _mm256_set1_epi32(0x7FFF);
+    const __m256i one      = _mm256_set1_epi32(1);
+    int64_t i = 0;
+    while (i + 8 <= n) {
+        __m256i u = _mm256_castps_si256(_mm256_loadu_ps(s + i));
+        __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(u, abs_mask), inf);
+        __m256i odd = _mm256_and_si256(_mm256_srli_epi32(u, 16), one);
+        __m256i r = _mm256_add_epi32(u, _mm256_add_epi32(half, odd));
+        r = _mm256_blendv_epi8(r, _mm256_or_si256(u, quiet), nan);
+        r = _mm256_srli_epi32(r, 16);
+        __m128i b = _mm_packus_epi32(_mm256_castsi256_si128(r),
+                                     _mm256_extracti128_si256(r, 1));
+        _mm_storeu_si128((__m128i*)(d + i), b);
+        i += 8;
+    }
+    cpu_fp32_to_bf16_n(s + i, d + i, n - i);
+}
+
+typedef struct fp16_conversions_s {
+    void (*bf16_to_fp32_n)(const bf16_t* s, fp32_t* d, int64_t n);
+    void (*fp32_to_bf16_n)(const fp32_t* s, bf16_t* d, int64_t n);
+    void (*fp16_to_fp32_n)(const fp16_t* s, fp32_t* d, int64_t n);
+    void (*fp32_to_fp16_n)(const fp32_t* s, fp16_t* d, int64_t n);
+} fp16_conversions_t;
+
+static fp16_conversions_t fp16_conversions;
+
+static void fp16_init(void) {
+    static bool init;
+    if (!init) {
+        isa.init();
+        workers.init();
+        fp16_conversions.bf16_to_fp32_n = isa.avx2 ?
+            avx2_bf16_to_fp32_n : cpu_bf16_to_fp32_n;
+        fp16_conversions.fp32_to_bf16_n = isa.avx2 ?
+            avx2_fp32_to_bf16_n : cpu_fp32_to_bf16_n;
+        fp16_conversions.fp16_to_fp32_n = isa.avx2 && isa.f16c ?
+            f16c_fp16_to_fp32_n : isa.avx2 ?
+            avx2_fp16_to_fp32_n : cpu_fp16_to_fp32_n;
+        fp16_conversions.fp32_to_fp16_n = isa.avx2 && isa.f16c ?
+            f16c_fp32_to_fp16_n : isa.avx2 ?
+            avx2_fp32_to_fp16_n : cpu_fp32_to_fp16_n;
+        init = true;
+    }
+}
+
+// Arrays of at least two chunks are split into chunks converted on
+// the workers pool (conversions are memory bound, a single core does
+// not saturate memory bandwidth).
+
+enum { fp16_mt_chunk = 256 * 1024 }; // elements
+
+typedef struct fp16_mt_s {
+    const void* s;
+    void* d;
+    int64_t n;
+    int32_t sb; // source element bytes
+    int32_t db; // destination element bytes
+    void (*convert)(const void* s, void* d, int64_t n);
+} fp16_mt_t;
+
+static void fp16_mt_job(void* that, int32_t i) {
+    fp16_mt_t* c = (fp16_mt_t*)that;
+    const int64_t from = (int64_t)i * fp16_mt_chunk;
+    const int64_t n = min((int64_t)fp16_mt_chunk, c->n - from);
+    c->convert((const byte_t*)c->s + from * c->sb,
+               (byte_t*)c->d + from * c->db, n);
+}
+
+static void fp16_mt(fp16_mt_t* c) {
+    fp16_init();
+    if (c->n < 2 * fp16_mt_chunk || workers.count() == 1) {
+        c->convert(c->s, c->d, c->n);
+    } else {
+        const int64_t chunks = (c->n + fp16_mt_chunk - 1) / fp16_mt_chunk;
+        fatal_if(chunks > INT32_MAX, "n: %lld", c->n);
+        workers.run(fp16_mt_job, c, (int32_t)chunks);
+    }
+}
+
+// conversions called via common signature:
+
+static void fp16_mt_bf16_to_fp32(const void* s, void* d, int64_t n) {
+    fp16_conversions.bf16_to_fp32_n((const bf16_t*)s, (fp32_t*)d, n);
+}
+
+static void fp16_mt_fp32_to_bf16(const void* s, void* d, int64_t n) {
+    fp16_conversions.fp32_to_bf16_n((const fp32_t*)s, (bf16_t*)d, n);
+}
+
+static void fp16_mt_fp16_to_fp32(const void* s, void* d, int64_t n) {
+    fp16_conversions.fp16_to_fp32_n((const fp16_t*)s, (fp32_t*)d, n);
+}
+
+static void fp16_mt_fp32_to_fp16(const void* s, void* d, int64_t n) {
+    fp16_conversions.fp32_to_fp16_n((const fp32_t*)s, (fp16_t*)d, n);
+}
+
+void bf16_to_fp32_n(const bf16_t* s, fp32_t* d, int64_t n) {
+    fp16_mt_t c = { s, d, n, 2, 4, fp16_mt_bf16_to_fp32 };
+    fp16_mt(&c);
+}
+
+void fp32_to_bf16_n(const fp32_t* s, bf16_t* d, int64_t n) {
+    fp16_mt_t c = { s, d, n, 4, 2, fp16_mt_fp32_to_bf16 };
+    fp16_mt(&c);
+}
+
+void fp16_to_fp32_n(const fp16_t* s, fp32_t* d, int64_t n) {
+    fp16_mt_t c = { s, d, n, 2, 4, fp16_mt_fp16_to_fp32 };
+    fp16_mt(&c);
+}
+
+void fp32_to_fp16_n(const fp32_t* s, fp16_t* d, int64_t n) {
+    fp16_mt_t c = { s, d, n, 4, 2, fp16_mt_fp32_to_fp16 };
+    fp16_mt(&c);
+}
+
+// fp32_t test values: random bits mixed with rounding ties of bf16_t and
+// fp16_t, NaNs, infinities, subnormals and values around fp16_t max
+
+static void fp16_n_test_values(fp32_t* f, int64_t n) {
+    uint32_t seed = 1;
+    for (int64_t i = 0; i < n; i++) {
+        uint32_t u = random32(&seed);
+        const uint32_t s = u & 0x80000000;
+        switch (i % 8) {
+            case 0: u = (u & 0xFFFF0000) | 0x8000; break;
+            case 1: u |= 0x7F800001; break;
+            case 2: u = s | 0x7F800000; break;
+            case 3: u &= 0x807FFFFF; break;
+            case 4: u = s | ((102 + (u >> 8) % 42) << 23) | (u & 0x7FE000) | 0x1000;
+                    break;
+            case 5: u = s | (0x477FE000 + (u & 0x3FFF)); break;
+            default: break;
+        }
+        memcpy(&f[i], &u, sizeof(u));
+    }
+}
+
+void fp16_n_test(void) {
+    fp16_init();
+    enum { n = 64 * 1024 + 7 }; // all 16-bit values and a tail
+    static uint16_t h[n];
+    static uint16_t c[n];
+    static fp32_t f[n];
+    static fp32_t e[n];
+    for (int32_t i = 0; i < n; i++) { h[i] = (uint16_t)i; }
+    // every implementation present on this cpu vs scalar fp16.h:
+    void (*h2f[3])(const fp16_t* s, fp32_t* d, int64_t n) = {
+        cpu_fp16_to_fp32_n,
+        isa.avx2 ? avx2_fp16_to_fp32_n : null,
+        isa.avx2 && isa.f16c ? f16c_fp16_to_fp32_n : null
+    };
+    void (*f2h[3])(const fp32_t* s, fp16_t* d, int64_t n) = {
+        cpu_fp32_to_fp16_n,
+        isa.avx2 ? avx2_fp32_to_fp16_n : null,
+        isa.avx2 && isa.f16c ? f16c_fp32_to_fp16_n : null
+    };
+    for (int32_t i = 0; i < n; i++) { e[i] = fp16to32(((fp16_t*)h)[i]); }
+    for (int k = 0; k < countof(h2f); k++) {
+        if (h2f[k] == null) { continue; }
+        h2f[k]((const fp16_t*)h, f, n);
+        fatal_if(memcmp(f, e, sizeof(f)) != 0, "fp16_to_fp32_n[%d]", k);
+    }
+    fp16_n_test_values(f, n);
+    for (int32_t i = 0; i < n; i++) { c[i] = fp32to16(f[i]).bytes; }
+    for (int k = 0; k < countof(f2h); k++) {
+        if (f2h[k] == null) { continue; }
+        f2h[k](f, (fp16_t*)h, n);
+        for (int32_t i = 0; i < n; i++) {
+            fatal_if(h[i] != c[i], "fp32_to_fp16_n[%d] %.9e 0x%04X "
+                     "expected 0x%04X", k, f[i], h[i], c[i]);
+        }
+    }
+    for (int32_t i = 0; i < n; i++) { h[i] = (uint16_t)i; }
+    bf16_to_fp32_n((const bf16_t*)h, f, n);
+    for (int32_t i = 0; i < n; i++) {
+        e[i] = bf16to32(((bf16_t*)h)[i]);
+        fatal_if(memcmp(&f[i], &e[i], sizeof(e[i])) != 0, "bf16 0x%04X", h[i]);
+    }
+    fp16_n_test_values(f, n);
+    fp32_to_bf16_n(f, (bf16_t*)c, n);
+    for (int32_t i = 0; i < n; i++) {
+        const uint16_t b = fp32tobf16(f[i]).bytes;
+        fatal_if(c[i] != b, "%.9e 0x%04X expected 0x%04X", f[i], c[i], b);
+    }
+    // multithreaded path: result must not depend on chunking
+    enum { m = 4 * fp16_mt_chunk + 3 };
+    fp32_t* a = (fp32_t*)malloc(m * (sizeof(fp32_t) * 2 + sizeof(fp16_t) * 2));
+    fatal_if(a == null);
+    fp32_t* b = a + m;
+    fp16_t* x = (fp16_t*)(b + m);
+    fp16_t* y = x + m;
+    fp16_n_test_values(a, m);
+    fp32_to_fp16_n(a, x, m);
+    fp16_conversions.fp32_to_fp16_n(a, y, m);
+    fatal_if(memcmp(x, y, m * sizeof(fp16_t)) != 0, "fp32_to_fp16_n");
+    fp16_to_fp32_n(x, a, m);
+    fp16_conversions.fp16_to_fp32_n(x, b, m);
+    fatal_if(memcmp(a, b, m * sizeof(fp32_t)) != 0, "fp16_to_fp32_n");
+    free(a);
+}
@@ -1,8 +1,6 @@
 #pragma once
 #include "rt.h"
 
-// TODO: mf8_t  https://en.wikipedia.org/wiki/Minifloat
-// TODO: bf16_t https://en.wikipedia.org/wiki/Bfloat16_floating-point_format
 // AVX512 support both fp16 and bf16 but only on three (server grade) processors so far
 // https://en.wikichip.org/wiki/x86/avx512_bf16
 
@@ -38,9 +36,9 @@ static_assert(sizeof(fp16_t) == 2, "fp16_t size must be 2");
 #define F16_RADIX        2             // exponent radix
 #define F16_TRUE_MIN     fp16x(0x0001) // 2.9802322E-08 subnormal pow(2,-24) ~5.96E-8
 
-inline bool fp16_isnan(fp16_t v) { return ((v.bytes >> 10) & 0x1F) == 0x1F && (v.bytes & 0x3FF) != 0; }
+static inline bool fp16_isnan(fp16_t v) { return ((v.bytes >> 10) & 0x1F) == 0x1F && (v.bytes & 0x3FF) != 0; }
 
-inline bool fp16_isfinite(fp16_t v) { return ((v.bytes >> 10) & 0x1F) != 0x1F; }
+static inline bool fp16_isfinite(fp16_t v) { return ((v.bytes >> 10) & 0x1F) != 0x1F; }
 
 // Terminology:
 // "normal" actually "normalized" as in "shifted left till highest bit of
@@ -60,7 +58,7 @@ inline bool fp16_isfinite(fp16_t v) { return ((v.bytes >> 10) & 0x1F) != 0x1F; }
 // See:
 // https://en.wikipedia.org/wiki/Half-precision_floating-point_format
 
-inline fp16_t fp32to16(fp32_t f32) {
+static inline fp16_t fp32to16(fp32_t f32) {
 	// Float structure:
 	// 1-bit sign
 	// 8-bit exponent
@@ -90,62 +88,48 @@ inline fp16_t fp32to16(fp32_t f32) {
 	//      if the exponent is too large, result is +inf/-inf.
 	//      If the exponent is too small, the result will be zero.
 	// +/- inf, +/- zero: conversion does not affect the value.
-	// NaN and signaling NaN: conversion preseres signalling.
-	uint32_t v = *(uint32_t*)&f32;
-	uint32_t biased_exponent = (v & 0x7F800000) >> 23;
-	uint32_t mantissa = v & 0x7FFFFF;
-	uint32_t sign = (v & 0x80000000) >> 16;
+	// NaN: stays NaN with the quiet bit set and upper bits of the payload
+    //      (the same as F16C _mm256_cvtps_ph() does).
+    // Rounding is to nearest even for normals and subnormals, results are
+    // bit identical to F16C and to bulk fp32_to_fp16_n().
+    uint32_t v;
+    memcpy(&v, &f32, sizeof(v));
+    const uint32_t sign = (v >> 16) & 0x8000;
+    const uint32_t a = v & 0x7FFFFFFF; // absolute value
     uint32_t result;
-	const uint32_t maxbiased_exponent = (1 << 5) - 1;
-	int true_exponent = biased_exponent - 127;
-	int new_biased_exponent;
-	// Compute the new biased exponent value to send.
-	if (biased_exponent != 0xFF && biased_exponent != 0) {
-		new_biased_exponent = true_exponent + 15;
-		if (new_biased_exponent >= (int)maxbiased_exponent) {
-			new_biased_exponent = maxbiased_exponent;
-			mantissa = 0; // inf, not NaN
-		} else if (new_biased_exponent < -10) {
-            // too small for subnormal
-            new_biased_exponent = 0;
-            mantissa = 0;
-        } else if (new_biased_exponent < 0) {
-            assert(0 <= 1 - new_biased_exponent);
-            mantissa |= 0x800000;  // add hidden bit
-            mantissa >>= (1 - new_biased_exponent);
-            new_biased_exponent = 0;
-        } else {
-        }
-        mantissa = (mantissa >> (23 - 10)) & 0x3FF;
-        result = sign | (new_biased_exponent << 10) | mantissa;
-	} else {
-        // either all zeroes (+/-zero or denormal) or all ones (nan or inf).
-		new_biased_exponent = biased_exponent & 0x1F;
-	    uint32_t new_mantissa = (mantissa >> (23 - 10)) & 0x3FF;
-    	// If the float was a signaling NaN, make sure it stays
-        // a signaling NaN:
-	    if (biased_exponent == 0x1F && mantissa != 0 && new_mantissa == 0) {
-	    	new_mantissa = 1; // denotes a NaN but not a signaling NaN
-        }
-        result = sign | (new_biased_exponent << 10) | new_mantissa;
+    if (a > 0x7F800000) { // NaN
+        result = 0x7E00 | ((a >> 13) & 0x3FF);
+    } else if (a >= 0x477FF000) { // >= 65520 rounds to infinity
+        result = 0x7C00;
+    } else if (a >= 0x38800000) { // normal: rebias exponent 127 -> 15
+        const uint32_t r = a - ((127 - 15) << 23);
+        result = (r + 0xFFF + ((r >> 13) & 1)) >> 13;
+    } else if (a > 0x33000000) { // subnormal: (a * 2^24) rounded
+        const uint32_t shift = 126 - (a >> 23);
+        const uint32_t mantissa = (a & 0x7FFFFF) | 0x800000; // hidden bit
+        const uint32_t half = 1U << (shift - 1);
+        const uint32_t rest = mantissa & ((half << 1) - 1);
+        result = mantissa >> shift;
+        if (rest > half || (rest == half && (result & 1) != 0)) { result++; }
+    } else { // <= pow(2, -25) rounds to zero
+        result = 0;
     }
-    assert(0 <= result && result <= UINT16_MAX);
-	return (fp16_t){ .bytes = (uint16_t)result };
+	return (fp16_t){ .bytes = (uint16_t)(sign | result) };
 }
 
-inline fp32_t fp16to32(fp16_t fp16) {
+static inline fp32_t fp16to32(fp16_t fp16) {
 	uint32_t sign = (fp16.bytes & 0x8000) << 16;
 	uint32_t exponent = (fp16.bytes & 0x7C00) >> 10;
 	uint32_t mantissa = fp16.bytes & 0x03FF;
     uint32_t result;
     // Shift back the decoded mantissa to proper position.
     if (exponent == 0 && mantissa == 0) {  // +/- zero
-        result = sign << 31;
+        result = sign;
     } else if (exponent == 0x1f && mantissa == 0) {  // +/- infinity
         result = sign | (0xFF << 23);
     } else if (exponent == 0x1f && mantissa != 0) {  // NaN
-        // preserve mantisa for signaling NaN (highest bit of mantissa)
-        result = sign | (0xFF << 23) | (mantissa << 13);
+        // quiet NaN with the payload like F16C _mm256_cvtph_ps()
+        result = sign | (0xFF << 23) | 0x00400000 | (mantissa << 13);
 	} else if (exponent != 0) { // normal exponent is not zero
         exponent = exponent + (127 - 15);
         mantissa = mantissa << 13;
@@ -166,34 +150,165 @@ inline fp32_t fp16to32(fp16_t fp16) {
         assert(mantissa == 0 && exponent == 0, "+/- zero");
         result = sign;
     }
-	return *(fp32_t*)&result;
+    fp32_t f;
+    memcpy(&f, &result, sizeof(f));
+	return f;
 }
 
-inline fp16_t fp16_add(fp16_t x, fp16_t y) {
+static inline fp16_t fp16_add(fp16_t x, fp16_t y) {
     return fp32to16(fp16to32(x) + fp16to32(y));
 }
 
-inline fp16_t fp16_sub(fp16_t x, fp16_t y) {
+static inline fp16_t fp16_sub(fp16_t x, fp16_t y) {
     return fp32to16(fp16to32(x) - fp16to32(y));
 }
-inline fp16_t fp16_mul(fp16_t x, fp16_t y) {
+static inline fp16_t fp16_mul(fp16_t x, fp16_t y) {
     return fp32to16(fp16to32(x) * fp16to32(y));
 }
-inline fp16_t fp16_div(fp16_t x, fp16_t y) {
+static inline fp16_t fp16_div(fp16_t x, fp16_t y) {
     return fp32to16(fp16to32(x) / fp16to32(y));
 }
 
-inline int fp16_compare(fp16_t x, fp16_t y) {
+static inline int fp16_compare(fp16_t x, fp16_t y) {
     fp16_t diff = fp16_sub(x, y);
     return (diff.bytes & 0x8000) ? -1 : (diff.bytes == 0) ? 0 : +1;
 }
 
-inline bool fp16_equ(fp16_t x, fp16_t y) { return fp16_compare(x, y) == 0; }
-inline bool fp16_leq(fp16_t x, fp16_t y) { return fp16_compare(x, y) <= 0; }
-inline bool fp16_les(fp16_t x, fp16_t y) { return fp16_compare(x, y) <  0; }
-inline bool fp16_gtr(fp16_t x, fp16_t y) { return fp16_compare(x, y) >  0; }
-inline bool fp16_gte(fp16_t x, fp16_t y) { return fp16_compare(x, y) >= 0; }
-inline bool fp16_neq(fp16_t x, fp16_t y) { return fp16_compare(x, y) != 0; }
+static inline bool fp16_equ(fp16_t x, fp16_t y) { return fp16_compare(x, y) == 0; }
+static inline bool fp16_leq(fp16_t x, fp16_t y) { return fp16_compare(x, y) <= 0; }
+static inline bool fp16_les(fp16_t x, fp16_t y) { return fp16_compare(x, y) <  0; }
+static inline bool fp16_gtr(fp16_t x, fp16_t y) { return fp16_compare(x, y) >  0; }
+static inline bool fp16_gte(fp16_t x, fp16_t y) { return fp16_compare(x, y) >= 0; }
+static inline bool fp16_neq(fp16_t x, fp16_t y) { return fp16_compare(x, y) != 0; }
+
+// https://en.wikipedia.org/wiki/Bfloat16_floating-point_format
+// bf16_t is the upper half of fp32_t: the same 8-bit exponent (and range)
+// with 7-bit mantissa. Conversion to fp32_t is a shift, conversion from
+// fp32_t rounds to nearest even and keeps NaNs quiet NaNs.
+
+typedef begin_packed struct _bf16_u_ {
+    uint16_t bytes;
+} end_packed _bf16_t_;
+
+#undef bf16_t
+#define bf16_t _bf16_t_
+
+static_assert(sizeof(bf16_t) == 2, "bf16_t size must be 2");
+
+#define bf16x(hex) ((bf16_t){ .bytes = hex })
+
+static inline fp32_t bf16to32(bf16_t v) {
+    uint32_t u = (uint32_t)v.bytes << 16;
+    fp32_t f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static inline bf16_t fp32tobf16(fp32_t f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    if ((u & 0x7FFFFFFF) > 0x7F800000) { // NaN: truncate and set quiet bit
+        return bf16x((uint16_t)((u >> 16) | 0x0040));
+    }
+    u += 0x7FFF + ((u >> 16) & 1); // round to nearest even
+    return bf16x((uint16_t)(u >> 16));
+}
+
+// https://en.wikipedia.org/wiki/Minifloat
+// 8-bit floats (OCP FP8):
+//   e4m3: bias 7, no infinities, S.1111.111 is NaN, max 448
+//   e5m2: bias 15, upper byte of fp16_t with infinities and NaNs, max 57344
+// Conversions from fp32_t round to nearest even. e4m3 saturates to +/-448
+// (infinities too), e5m2 overflows to infinity like fp32to16().
+
+typedef begin_packed struct _fp8_e4m3_u_ {
+    uint8_t bytes;
+} end_packed fp8_e4m3_t;
+
+typedef begin_packed struct _fp8_e5m2_u_ {
+    uint8_t bytes;
+} end_packed fp8_e5m2_t;
+
+static_assert(sizeof(fp8_e4m3_t) == 1 && sizeof(fp8_e5m2_t) == 1, "size must be 1");
+
+#define e4m3x(hex) ((fp8_e4m3_t){ .bytes = hex })
+#define e5m2x(hex) ((fp8_e5m2_t){ .bytes = hex })
+
+static inline fp32_t e4m3to32(fp8_e4m3_t v) {
+    const uint32_t sign = (uint32_t)(v.bytes & 0x80) << 24;
+    const uint32_t exponent = (v.bytes >> 3) & 0xF;
+    const uint32_t mantissa = v.bytes & 0x7;
+    uint32_t u;
+    if (exponent == 0xF && mantissa == 0x7) {
+        u = sign | 0x7FC00000; // NaN
+    } else if (exponent != 0) {
+        u = sign | ((exponent + 127 - 7) << 23) | (mantissa << 20);
+    } else { // subnormal: mantissa * pow(2, -9)
+        const fp32_t f = (fp32_t)mantissa / 512;
+        memcpy(&u, &f, sizeof(u));
+        u |= sign;
+    }
+    fp32_t f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static inline fp32_t e5m2to32(fp8_e5m2_t v) {
+    return fp16to32(fp16x((uint16_t)(v.bytes << 8)));
+}
+
+// fp8_round() rounds finite absolute value a (fp32_t bits) to nearest
+// even minifloat with bias and mbits of mantissa, not handling overflow.
+
+static inline uint32_t fp8_round(uint32_t a, uint32_t bias, uint32_t mbits) {
+    const uint32_t e = a >> 23;
+    if (e >= 127 + 1 - bias) { // normal: rebias exponent
+        const uint32_t drop = 23 - mbits;
+        const uint32_t r = a - ((127 - bias) << 23);
+        return (r + (1U << (drop - 1)) - 1 + ((r >> drop) & 1)) >> drop;
+    } else {
+        const uint32_t shift = 151 - bias - mbits - e;
+        if (shift > 24) { return 0; } // below half of smallest subnormal
+        const uint32_t mantissa = (a & 0x7FFFFF) | 0x800000; // hidden bit
+        const uint32_t half = 1U << (shift - 1);
+        const uint32_t rest = mantissa & ((half << 1) - 1);
+        uint32_t r = mantissa >> shift;
+        if (rest > half || (rest == half && (r & 1) != 0)) { r++; }
+        return r;
+    }
+}
+
+static inline fp8_e4m3_t fp32toe4m3(fp32_t f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    const uint8_t sign = (uint8_t)((u >> 24) & 0x80);
+    const uint32_t a = u & 0x7FFFFFFF;
+    if (a > 0x7F800000) { return e4m3x(sign | 0x7F); } // NaN
+    const uint32_t r = a >= 0x43E00000 ? 0x7E : fp8_round(a, 7, 3); // 448
+    return e4m3x(sign | (uint8_t)min(r, 0x7EU));
+}
+
+static inline fp8_e5m2_t fp32toe5m2(fp32_t f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    const uint8_t sign = (uint8_t)((u >> 24) & 0x80);
+    const uint32_t a = u & 0x7FFFFFFF;
+    if (a > 0x7F800000) { return e5m2x(sign | 0x7E); } // quiet NaN
+    if (a >= 0x47700000) { return e5m2x(sign | 0x7C); } // >= 61440: inf
+    return e5m2x(sign | (uint8_t)fp8_round(a, 15, 2));
+}
+
+// Bulk conversions of arrays (fp16.c) use SIMD when available:
+
+void bf16_to_fp32_n(const bf16_t* s, fp32_t* d, int64_t n);
+void fp32_to_bf16_n(const fp32_t* s, bf16_t* d, int64_t n);
+// F16C (or AVX2 integer) fp16_t conversions bit identical to fp16to32()
+// and fp32to16(). Large arrays are converted on the workers pool thus
+// these must not be called from inside of workers.run() jobs.
+void fp16_to_fp32_n(const fp16_t* s, fp32_t* d, int64_t n);
+void fp32_to_fp16_n(const fp32_t* s, fp16_t* d, int64_t n);
+
+void fp16_n_test(void); // bulk vs scalar conversions
 
 #ifdef RT_IMPLEMENTATION
 
@@ -230,7 +345,9 @@ void fp16_test() {
             small = fp16_add(small, small);
         }
         assert(!fp16_isfinite(a), "should not be able to add anything to MAX");
-        assert( fp16_equ(small, fp32to16(32)), "density between: 32768 65519 is 32");
+        // density between 32768 and 65504 is 32, MAX + 16 is a tie
+        // that rounds to even (infinity):
+        assert( fp16_equ(small, fp32to16(16)), "density between: 32768 65504 is 32");
         dump_f16("a    :", a);
         dump_f16("small:", small);
     }
@@ -0,0 +1,667 @@
+#include <immintrin.h>
+#include "gemv.h"
+#include "dot.h"
+#include "isa.h"
+
+// The vector is converted to contiguous fp32_t (fp64_t) once per call
+// and is reused from L1/L2 by 8 rows at a time: each 8 (or 4) column
+// vector load feeds 8 independent FMA chains, one per row.
+//
+// Batched gemv walks the matrix once for all k vectors: a pair of rows
+// is multiplied by the vectors 4 at a time while the rows are still in
+// L1, so the matrix is streamed from memory once instead of k times.
+
+enum {
+    gemv_rows  = 8,        // rows processed at once
+    gemv_stack = 4 * 1024, // vector elements converted on stack
+    gemv_tile_rows = 2,    // batch: rows x vectors accumulated in registers
+    gemv_tile_vectors = 4
+};
+
+#define f32x4_t __m128
+#define f32x8_t __m256
+#define f64x2_t __m128d
+#define f64x4_t __m256d
+
+typedef struct gemv_avx2_s { // null if not supported by CPU
+    void (*rows16)(const fp16_t* mx, int64_t sm, const fp32_t* v, int64_t n,
+                   fp64_t r[gemv_rows]);
+    void (*rows32)(const fp32_t* mx, int64_t sm, const fp32_t* v, int64_t n,
+                   fp64_t r[gemv_rows]);
+    void (*rows64)(const fp64_t* mx, int64_t sm, const fp64_t* v, int64_t n,
+                   fp64_t r[gemv_rows]);
+    void (*rowsbf16)(const bf16_t* mx, int64_t sm, const fp32_t* v, int64_t n,
+                     fp64_t r[gemv_rows]);
+    fp64_t (*row16)(const fp16_t* mx, const fp32_t* v, int64_t n);
+    // batch tiles: 2 rows x 4 vectors, r[row * 4 + vector]
+    void (*tile16)(const fp16_t* m0, const fp16_t* m1, const fp32_t* v[4],
+                   int64_t n, fp64_t r[8]);
+    void (*tile32)(const fp32_t* m0, const fp32_t* m1, const fp32_t* v[4],
+                   int64_t n, fp64_t r[8]);
+    void (*tile64)(const fp64_t* m0, const fp64_t* m1, const fp64_t* v[4],
+                   int64_t n, fp64_t r[8]);
+} gemv_avx2_t;
+
+static gemv_avx2_t gemv_avx2;
+
+// r[0..7] = horizontal sums of a[0..7]
+isa_target("avx2")
+static void avx2_gemv_sum8_f32(const f32x8_t a[8], fp64_t r[8]) {
+    f32x8_t s01 = _mm256_hadd_ps(a[0], a[1]);
+    f32x8_t s23 = _mm256_hadd_ps(a[2], a[3]);
+    f32x8_t s45 = _mm256_hadd_ps(a[4], a[5]);
+    f32x8_t s67 = _mm256_hadd_ps(a[6], a[7]);
+    f32x8_t s0123 = _mm256_hadd_ps(s01, s23); // [0 1 2 3 | 0 1 2 3] halves
+    f32x8_t s4567 = _mm256_hadd_ps(s45, s67);
+    f32x4_t r0123 = _mm_add_ps(_mm256_castps256_ps128(s0123),
+                               _mm256_extractf128_ps(s0123, 1));
+    f32x4_t r4567 = _mm_add_ps(_mm256_castps256_ps128(s4567),
+                               _mm256_extractf128_ps(s4567, 1));
+    fp32_t f[8];
+    _mm_storeu_ps(f + 0, r0123);
+    _mm_storeu_ps(f + 4, r4567);
+    for (int i = 0; i < 8; i++) { r[i] = f[i]; }
+}
+
+isa_target("avx2")
+static inline __m256i avx2_gemv_mask32(int64_t n) { // n < 8 lanes
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32((int32_t)n),
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+isa_target("avx2,fma")
+static void avx2_gemv_rows32(const fp32_t* mx, int64_t sm, const fp32_t* v,
+        int64_t n, fp64_t r[gemv_rows]) {
+    f32x8_t a[gemv_rows];
+    for (int i = 0; i < gemv_rows; i++) { a[i] = _mm256_setzero_ps(); }
+    int64_t j = 0;
+    #pragma push_macro("row")
+    #define row(i, load) a[i] = _mm256_fmadd_ps(load(mx + (i) * sm + j), x, a[i])
+    #define row_all(load) \
+        row(0, load); row(1, load); row(2, load); row(3, load); \
+        row(4, load); row(5, load); row(6, load); row(7, load)
+    #define loadu(p) _mm256_loadu_ps(p)
+    #define maskload(p) _mm256_maskload_ps(p, mask)
+    while (j + 8 <= n) {
+        f32x8_t x = _mm256_loadu_ps(v + j);
+        row_all(loadu);
+        j += 8;
+    }
+    if (j < n) {
+        __m256i mask = avx2_gemv_mask32(n - j);
+        f32x8_t x = _mm256_maskload_ps(v + j, mask);
+        row_all(maskload);
+    }
+    #undef maskload
+    #undef loadu
+    #undef row_all
+    #pragma pop_macro("row")
+    avx2_gemv_sum8_f32(a, r);
+}
+
+isa_target("avx2,fma,f16c")
+static void avx2_gemv_rows16(const fp16_t* mx, int64_t sm, const fp32_t* v,
+        int64_t n, fp64_t r[gemv_rows]) {
+    f32x8_t a[gemv_rows];
+    for (int i = 0; i < gemv_rows; i++) { a[i] = _mm256_setzero_ps(); }
+    int64_t j = 0;
+    #pragma push_macro("row")
+    #define row(i) a[i] = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_loadu_si128( \
+                   (const __m128i*)(mx + (i) * sm + j))), x, a[i])
+    while (j + 8 <= n) {
+        f32x8_t x = _mm256_loadu_ps(v + j);
+        row(0); row(1); row(2); row(3); row(4); row(5); row(6); row(7);
+        j += 8;
+    }
+    #pragma pop_macro("row")
+    avx2_gemv_sum8_f32(a, r);
+    if (j < n) { // there is no masked 16-bit load in AVX2
+        for (int i = 0; i < gemv_rows; i++) {
+            const fp16_t* p = mx + i * sm;
+            for (int64_t k = j; k < n; k++) { r[i] += fp16to32(p[k]) * v[k]; }
+        }
+    }
+}
+
+// bf16_t is the upper half of fp32_t: zero extended and shifted by 16
+
+isa_target("avx2,fma")
+static void avx2_gemv_rowsbf16(const bf16_t* mx, int64_t sm, const fp32_t* v,
+        int64_t n, fp64_t r[gemv_rows]) {
+    f32x8_t a[gemv_rows];
+    for (int i = 0; i < gemv_rows; i++) { a[i] = _mm256_setzero_ps(); }
+    int64_t j = 0;
+    #pragma push_macro("row")
+    #define row(i) a[i] = _mm256_fmadd_ps(_mm256_castsi256_ps(             \
+                   _mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128( \
+                   (const __m128i*)(mx + (i) * sm + j))), 16)), x, a[i])
+    while (j + 8 <= n) {
+        f32x8_t x = _mm256_loadu_ps(v + j);
+        row(0); row(1); row(2); row(3); row(4); row(5); row(6); row(7);
+        j += 8;
+    }
+    #pragma pop_macro("row")
+    avx2_gemv_sum8_f32(a, r);
+    if (j < n) { // there is no masked 16-bit load in AVX2
+        for (int i = 0; i < gemv_rows; i++) {
+            const bf16_t* p = mx + i * sm;
+            for (int64_t k = j; k < n; k++) { r[i] += bf16to32(p[k]) * v[k]; }
+        }
+    }
+}
+
+isa_target("avx2,fma,f16c")
+static fp64_t avx2_gemv_row16(const fp16_t* mx, const fp32_t* v, int64_t n) {
+    f32x8_t a0 = _mm256_setzero_ps();
+    f32x8_t a1 = _mm256_setzero_ps();
+    int64_t j = 0;
+    while (j + 16 <= n) {
+        a0 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_loadu_si128(
+            (const __m128i*)(mx + j))), _mm256_loadu_ps(v + j), a0);
+        a1 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_loadu_si128(
+            (const __m128i*)(mx + j + 8))), _mm256_loadu_ps(v + j + 8), a1);
+        j += 16;
+    }
+    f32x8_t a = _mm256_add_ps(a0, a1);
+    f32x4_t s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    fp64_t sum = _mm_cvtss_f32(s);
+    while (j < n) { sum += fp16to32(mx[j]) * v[j]; j++; }
+    return sum;
+}
+
+isa_target("avx2,fma")
+static void avx2_gemv_rows64(const fp64_t* mx, int64_t sm, const fp64_t* v,
+        int64_t n, fp64_t r[gemv_rows]) {
+    f64x4_t a[gemv_rows];
+    for (int i = 0; i < gemv_rows; i++) { a[i] = _mm256_setzero_pd(); }
+    int64_t j = 0;
+    #pragma push_macro("row")
+    #define row(i, load) a[i] = _mm256_fmadd_pd(load(mx + (i) * sm + j), x, a[i])
+    #define row_all(load) \
+        row(0, load); row(1, load); row(2, load); row(3, load); \
+        row(4, load); row(5, load); row(6, load); row(7, load)
+    #define loadu(p) _mm256_loadu_pd(p)
+    #define maskload(p) _mm256_maskload_pd(p, mask)
+    while (j + 4 <= n) {
+        f64x4_t x = _mm256_loadu_pd(v + j);
+        row_all(loadu);
+        j += 4;
+    }
+    if (j < n) {
+        __m256i mask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n - j),
+            _mm256_setr_epi64x(0, 1, 2, 3));
+        f64x4_t x = _mm256_maskload_pd(v + j, mask);
+        row_all(maskload);
+    }
+    #undef maskload
+    #undef loadu
+    #undef row_all
+    #pragma pop_macro("row")
+    for (int i = 0; i < gemv_rows; i++) {
+        f64x2_t s = _mm_add_pd(_mm256_castpd256_pd128(a[i]),
+                               _mm256_extractf128_pd(a[i], 1));
+        r[i] = _mm_cvtsd_f64(_mm_hadd_pd(s, s));
+    }
+}
+
+// Batch tiles accumulate 2 rows x 4 vectors in 8 registers. Missing
+// rows or vectors at the edges are passed as duplicates of the last one.
+
+isa_target("avx2,fma")
+static void avx2_gemv_tile32(const fp32_t* m0, const fp32_t* m1,
+        const fp32_t* v[4], int64_t n, fp64_t r[8]) {
+    f32x8_t a[8];
+    for (int i = 0; i < 8; i++) { a[i] = _mm256_setzero_ps(); }
+    int64_t j = 0;
+    #pragma push_macro("tile")
+    #define tile(load) do {                                         \
+        f32x8_t x0 = load(m0 + j);                                  \
+        f32x8_t x1 = load(m1 + j);                                  \
+        f32x8_t y = load(v[0] + j);                                 \
+        a[0] = _mm256_fmadd_ps(x0, y, a[0]);                        \
+        a[4] = _mm256_fmadd_ps(x1, y, a[4]);                        \
+        y = load(v[1] + j);                                         \
+        a[1] = _mm256_fmadd_ps(x0, y, a[1]);                        \
+        a[5] = _mm256_fmadd_ps(x1, y, a[5]);                        \
+        y = load(v[2] + j);                                         \
+        a[2] = _mm256_fmadd_ps(x0, y, a[2]);                        \
+        a[6] = _mm256_fmadd_ps(x1, y, a[6]);                        \
+        y = load(v[3] + j);                                         \
+        a[3] = _mm256_fmadd_ps(x0, y, a[3]);                        \
+        a[7] = _mm256_fmadd_ps(x1, y, a[7]);                        \
+    } while (0)
+    #define loadu(p) _mm256_loadu_ps(p)
+    #define maskload(p) _mm256_maskload_ps(p, mask)
+    while (j + 8 <= n) { tile(loadu); j += 8; }
+    if (j < n) {
+        __m256i mask = avx2_gemv_mask32(n - j);
+        tile(maskload);
+    }
+    #undef maskload
+    #undef loadu
+    #pragma pop_macro("tile")
+    avx2_gemv_sum8_f32(a, r);
+}
+
+isa_target("avx2,fma,f16c")
+static void avx2_gemv_tile16(const fp16_t* m0, const fp16_t* m1,
+        const fp32_t* v[4], int64_t n, fp64_t r[8]) {
+    f32x8_t a[8];
+    for (int i = 0; i < 8; i++) { a[i] = _mm256_setzero_ps(); }
+    int64_t j = 0;
+    while (j + 8 <= n) {
+        f32x8_t x0 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(m0 + j)));
+        f32x8_t x1 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(m1 + j)));
+        #pragma push_macro("vector")
+        #define vector(k) do {                                      \
+            f32x8_t y = _mm256_loadu_ps(v[k] + j);                  \
+            a[k]     = _mm256_fmadd_ps(x0, y, a[k]);                \
+            a[k + 4] = _mm256_fmadd_ps(x1, y, a[k + 4]);            \
+        } while (0)
+        vector(0); vector(1); vector(2); vector(3);
+        #pragma pop_macro("vector")
+        j += 8;
+    }
+    avx2_gemv_sum8_f32(a, r);
+    while (j < n) { // there is no masked 16-bit load in AVX2
+        const fp32_t x0 = fp16to32(m0[j]);
+        const fp32_t x1 = fp16to32(m1[j]);
+        for (int k = 0; k < 4; k++) {
+            r[k]     += x0 * v[k][j];
+            r[k + 4] += x1 * v[k][j];
+        }
+        j++;
+    }
+}
+
+isa_target("avx2,fma")
+static void avx2_gemv_tile64(const fp64_t* m0, const fp64_t* m1,
+        const fp64_t* v[4], int64_t n, fp64_t r[8]) {
+    f64x4_t a[8];
+    for (int i = 0; i < 8; i++) { a[i] = _mm256_setzero_pd(); }
+    int64_t j = 0;
+    #pragma push_macro("tile")
+    #define tile(load) do {                                         \
+        f64x4_t x0 = load(m0 + j);                                  \
+        f64x4_t x1 = load(m1 + j);                                  \
+        f64x4_t y = load(v[0] + j);                                 \
+        a[0] = _mm256_fmadd_pd(x0, y, a[0]);                        \
+        a[4] = _mm256_fmadd_pd(x1, y, a[4]);                        \
+        y = load(v[1] + j);                                         \
+        a[1] = _mm256_fmadd_pd(x0, y, a[1]);                        \
+        a[5] = _mm256_fmadd_pd(x1, y, a[5]);                        \
+        y = load(v[2] + j);                                         \
+        a[2] = _mm256_fmadd_pd(x0, y, a[2]);                        \
+        a[6] = _mm256_fmadd_pd(x1, y, a[6]);                        \
+        y = load(v[3] + j);                                         \
+        a[3] = _mm256_fmadd_pd(x0, y, a[3]);                        \
+        a[7] = _mm256_fmadd_pd(x1, y, a[7]);                        \
+    } while (0)
+    #define loadu(p) _mm256_loadu_pd(p)
+    #define maskload(p) _mm256_maskload_pd(p, mask)
+    while (j + 4 <= n) { tile(loadu); j += 4; }
+    if (j < n) {
+        __m256i mask = _mm256_cmpgt_epi64(_mm256_set1_epi64x(n - j),
+            _mm256_setr_epi64x(0, 1, 2, 3));
+        tile(maskload);
+    }
+    #undef maskload
+    #undef loadu
+    #pragma pop_macro("tile")
+    for (int i = 0; i < 8; i++) {
+        f64x2_t s = _mm_add_pd(_mm256_castpd256_pd128(a[i]),
+                               _mm256_extractf128_pd(a[i], 1));
+        r[i] = _mm_cvtsd_f64(_mm_hadd_pd(s, s));
+    }
+}
+
+static void gemv_init(void) {
+    static bool init;
+    if (!init) {
+        isa.init();
+        if (isa.avx2 && isa.fma) {
+            gemv_avx2.rows32 = avx2_gemv_rows32;
+            gemv_avx2.rows64 = avx2_gemv_rows64;
+            gemv_avx2.tile32 = avx2_gemv_tile32;
+            gemv_avx2.tile64 = avx2_gemv_tile64;
+            gemv_avx2.rowsbf16 = avx2_gemv_rowsbf16;
+            if (isa.f16c) {
+                gemv_avx2.rows16 = avx2_gemv_rows16;
+                gemv_avx2.row16  = avx2_gemv_row16;
+                gemv_avx2.tile16 = avx2_gemv_tile16;
+            }
+        }
+        init = true;
+    }
+}
+
+// Contiguous fp32_t copy of the vector: on stack for short vectors.
+
+typedef struct gemv_vector32_s {
+    fp32_t  stack[gemv_stack];
+    fp32_t* v;
+} gemv_vector32_t;
+
+enum { gemv_fp32, gemv_fp16, gemv_bf16 }; // vector element type
+
+static const fp32_t* gemv_vector32(gemv_vector32_t* t, const void* vector,
+        int type, int64_t sv, int64_t n) {
+    if (type == gemv_fp32 && sv == 1) { return (const fp32_t*)vector; }
+    t->v = n <= gemv_stack ? t->stack : (fp32_t*)malloc(n * sizeof(fp32_t));
+    fatal_if(t->v == null, "out of memory n: %lld", n);
+    if (type == gemv_fp16 && sv == 1) {
+        fp16_to_fp32_n((const fp16_t*)vector, t->v, n);
+    } else if (type == gemv_fp16) {
+        const fp16_t* v16 = (const fp16_t*)vector;
+        for (int64_t j = 0; j < n; j++) { t->v[j] = fp16to32(v16[j * sv]); }
+    } else if (type == gemv_bf16 && sv == 1) {
+        bf16_to_fp32_n((const bf16_t*)vector, t->v, n);
+    } else if (type == gemv_bf16) {
+        const bf16_t* vb = (const bf16_t*)vector;
+        for (int64_t j = 0; j < n; j++) { t->v[j] = bf16to32(vb[j * sv]); }
+    } else {
+        const fp32_t* v32 = (const fp32_t*)vector;
+        for (int64_t j = 0; j < n; j++) { t->v[j] = v32[j * sv]; }
+    }
+    return t->v;
+}
+
+static void gemv_vector32_free(gemv_vector32_t* t) {
+    if (t->v != null && t->v != t->stack) { free(t->v); }
+}
+
+static void gemv16_any(const fp16_t* mx, int64_t sm, const void* vector,
+        bool fp16, int64_t sv, void* result, int64_t m, int64_t n) {
+    gemv_init();
+    gemv_vector32_t t = { .v = null };
+    const fp32_t* v = gemv_vector32(&t, vector,
+        fp16 ? gemv_fp16 : gemv_fp32, sv, n);
+    fp64_t r[gemv_rows];
+    int64_t i = 0;
+    while (i < m) {
+        int rows = 1;
+        if (gemv_avx2.rows16 != null && m - i >= gemv_rows) {
+            gemv_avx2.rows16(mx + i * sm, sm, v, n, r);
+            rows = gemv_rows;
+        } else if (gemv_avx2.row16 != null) {
+            r[0] = gemv_avx2.row16(mx + i * sm, v, n);
+        } else {
+            const fp16_t* p = mx + i * sm;
+            fp32_t s = 0;
+            for (int64_t j = 0; j < n; j++) { s += fp16to32(p[j]) * v[j]; }
+            r[0] = s;
+        }
+        for (int k = 0; k < rows; k++) {
+            if (fp16) {
+                ((fp16_t*)result)[i + k] = fp32to16((fp32_t)r[k]);
+            } else {
+                ((fp32_t*)result)[i + k] = (fp32_t)r[k];
+            }
+        }
+        i += rows;
+    }
+    gemv_vector32_free(&t);
+}
+
+void gemv16(const fp16_t* matrix, int64_t stride_m,
+            const fp16_t* vector, int64_t stride_v,
+            fp16_t* result, int64_t m, int64_t n) {
+    gemv16_any(matrix, stride_m, vector, true, stride_v, result, m, n);
+}
+
+void gemv16_32(const fp16_t* matrix, int64_t stride_m,
+               const fp32_t* vector, int64_t stride_v,
+               fp32_t* result, int64_t m, int64_t n) {
+    gemv16_any(matrix, stride_m, vector, false, stride_v, result, m, n);
+}
+
+void gemv32(const fp32_t* matrix, int64_t stride_m,
+            const fp32_t* vector, int64_t stride_v,
+            fp32_t* result, int64_t m, int64_t n) {
+    gemv_init();
+    gemv_vector32_t t = { .v = null };
+    const fp32_t* v = gemv_vector32(&t, vector, gemv_fp32, stride_v, n);
+    fp64_t r[gemv_rows];
+    int64_t i = 0;
+    if (gemv_avx2.rows32 != null) {
+        while (m - i >= gemv_rows) {
+            gemv_avx2.rows32(matrix + i * stride_m, stride_m, v, n, r);
+            for (int k = 0; k < gemv_rows; k++) { result[i + k] = (fp32_t)r[k]; }
+            i += gemv_rows;
+        }
+    }
+    while (i < m) {
+        result[i] = (fp32_t)dot32(matrix + i * stride_m, 1, v, 1, n);
+        i++;
+    }
+    gemv_vector32_free(&t);
+}
+
+void gemvbf16(const bf16_t* matrix, int64_t stride_m,
+              const bf16_t* vector, int64_t stride_v,
+              bf16_t* result, int64_t m, int64_t n) {
+    gemv_init();
+    gemv_vector32_t t = { .v = null };
+    const fp32_t* v = gemv_vector32(&t, vector, gemv_bf16, stride_v, n);
+    fp64_t r[gemv_rows];
+    int64_t i = 0;
+    if (gemv_avx2.rowsbf16 != null) {
+        while (m - i >= gemv_rows) {
+            gemv_avx2.rowsbf16(matrix + i * stride_m, stride_m, v, n, r);
+            for (int k = 0; k < gemv_rows; k++) {
+                result[i + k] = fp32tobf16((fp32_t)r[k]);
+            }
+            i += gemv_rows;
+        }
+    }
+    while (i < m) {
+        const bf16_t* p = matrix + i * stride_m;
+        fp32_t s = 0;
+        for (int64_t j = 0; j < n; j++) { s += bf16to32(p[j]) * v[j]; }
+        result[i] = fp32tobf16(s);
+        i++;
+    }
+    gemv_vector32_free(&t);
+}
+
+void gemv64(const fp64_t* matrix, int64_t stride_m,
+            const fp64_t* vector, int64_t stride_v,
+            fp64_t* result, int64_t m, int64_t n) {
+    gemv_init();
+    fp64_t  stack[gemv_stack / 2];
+    fp64_t* v = (fp64_t*)vector;
+    if (stride_v != 1) {
+        v = n <= countof(stack) ? stack : (fp64_t*)malloc(n * sizeof(fp64_t));
+        fatal_if(v == null, "out of memory n: %lld", n);
+        for (int64_t j = 0; j < n; j++) { v[j] = vector[j * stride_v]; }
+    }
+    int64_t i = 0;
+    if (gemv_avx2.rows64 != null) {
+        while (m - i >= gemv_rows) {
+            gemv_avx2.rows64(matrix + i * stride_m, stride_m, v, n, result + i);
+            i += gemv_rows;
+        }
+    }
+    while (i < m) {
+        result[i] = dot64(matrix + i * stride_m, 1, v, 1, n);
+        i++;
+    }
+    if (v != vector && v != stack) { free(v); }
+}
+
+// Batched gemv: rows are visited in pairs, vectors in fours. Edge tiles
+// repeat the last row or vector and drop the duplicate results.
+
+static void gemv_scalar_tile16(const fp16_t* m0, const fp16_t* m1,
+        const fp32_t* v[4], int64_t n, fp64_t r[8]) {
+    for (int k = 0; k < 4; k++) {
+        fp32_t s0 = 0, s1 = 0;
+        for (int64_t j = 0; j < n; j++) {
+            s0 += fp16to32(m0[j]) * v[k][j];
+            s1 += fp16to32(m1[j]) * v[k][j];
+        }
+        r[k] = s0; r[k + 4] = s1;
+    }
+}
+
+static void gemv_scalar_tile32(const fp32_t* m0, const fp32_t* m1,
+        const fp32_t* v[4], int64_t n, fp64_t r[8]) {
+    for (int k = 0; k < 4; k++) {
+        fp32_t s0 = 0, s1 = 0;
+        for (int64_t j = 0; j < n; j++) {
+            s0 += m0[j] * v[k][j];
+            s1 += m1[j] * v[k][j];
+        }
+        r[k] = s0; r[k + 4] = s1;
+    }
+}
+
+static void gemv_scalar_tile64(const fp64_t* m0, const fp64_t* m1,
+        const fp64_t* v[4], int64_t n, fp64_t r[8]) {
+    for (int k = 0; k < 4; k++) {
+        fp64_t s0 = 0, s1 = 0;
+        for (int64_t j = 0; j < n; j++) {
+            s0 += m0[j] * v[k][j];
+            s1 += m1[j] * v[k][j];
+        }
+        r[k] = s0; r[k + 4] = s1;
+    }
+}
+
+#pragma push_macro("gemv_batch")
+
+#define gemv_batch(tile, fp_m, fp_v, fp_r) do {                         \
+    fatal_if(k < 1 || k > gemv_batch_max, "k: %lld", k);                \
+    for (int64_t i = 0; i < m; i += gemv_tile_rows) {                   \
+        const fp_m* m0 = matrix + i * stride_m;                         \
+        const fp_m* m1 = i + 1 < m ? m0 + stride_m : m0;                \
+        for (int64_t b = 0; b < k; b += gemv_tile_vectors) {            \
+            const fp_v* v[gemv_tile_vectors];                           \
+            for (int64_t t = 0; t < gemv_tile_vectors; t++) {           \
+                v[t] = vectors + min(b + t, k - 1) * stride_b;          \
+            }                                                           \
+            fp64_t r[gemv_tile_rows * gemv_tile_vectors];               \
+            tile(m0, m1, v, n, r);                                      \
+            const int64_t rows = min(gemv_tile_rows, m - i);            \
+            const int64_t count = min(gemv_tile_vectors, k - b);        \
+            for (int64_t y = 0; y < rows; y++) {                        \
+                for (int64_t t = 0; t < count; t++) {                   \
+                    results[(b + t) * stride_r + i + y] =               \
+                        (fp_r)r[y * gemv_tile_vectors + t];             \
+                }                                                       \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+} while (0)
+
+void gemv16_32_batch(const fp16_t* matrix, int64_t stride_m,
+                     const fp32_t* vectors, int64_t stride_b,
+                     fp32_t* results, int64_t stride_r,
+                     int64_t m, int64_t n, int64_t k) {
+    gemv_init();
+    if (gemv_avx2.tile16 != null) {
+        gemv_batch(gemv_avx2.tile16, fp16_t, fp32_t, fp32_t);
+    } else {
+        gemv_batch(gemv_scalar_tile16, fp16_t, fp32_t, fp32_t);
+    }
+}
+
+void gemv32_batch(const fp32_t* matrix, int64_t stride_m,
+                  const fp32_t* vectors, int64_t stride_b,
+                  fp32_t* results, int64_t stride_r,
+                  int64_t m, int64_t n, int64_t k) {
+    gemv_init();
+    if (gemv_avx2.tile32 != null) {
+        gemv_batch(gemv_avx2.tile32, fp32_t, fp32_t, fp32_t);
+    } else {
+        gemv_batch(gemv_scalar_tile32, fp32_t, fp32_t, fp32_t);
+    }
+}
+
+void gemv64_batch(const fp64_t* matrix, int64_t stride_m,
+                  const fp64_t* vectors, int64_t stride_b,
+                  fp64_t* results, int64_t stride_r,
+                  int64_t m, int64_t n, int64_t k) {
+    gemv_init();
+    if (gemv_avx2.tile64 != null) {
+        gemv_batch(gemv_avx2.tile64, fp64_t, fp64_t, fp64_t);
+    } else {
+        gemv_batch(gemv_scalar_tile64, fp64_t, fp64_t, fp64_t);
+    }
+}
+
+#pragma pop_macro("gemv_batch")
+
+static void gemv_test_batch() {
+    enum { m = 11, n = 21, sm = 23, k = gemv_batch_max, sb = 25, sr = 13 };
+    static fp16_t mx16[m * sm];
+    static fp32_t mx32[m * sm], vc32[k * sb], r32[k * sr], r16_32[k * sr];
+    static fp64_t mx64[m * sm], vc64[k * sb], r64[k * sr];
+    for (int i = 0; i < m * sm; i++) {
+        mx64[i] = mx32[i] = (fp32_t)(i % 7 - 3);
+        mx16[i] = fp32to16(mx32[i]);
+    }
+    for (int j = 0; j < k * sb; j++) { vc64[j] = vc32[j] = (fp32_t)(j % 5 - 2); }
+    for (int64_t batch = 1; batch <= k; batch++) {
+        for (int64_t rows = 1; rows <= m; rows += 3) {
+            gemv16_32_batch(mx16, sm, vc32, sb, r16_32, sr, rows, n, batch);
+            gemv32_batch(mx32, sm, vc32, sb, r32, sr, rows, n, batch);
+            gemv64_batch(mx64, sm, vc64, sb, r64, sr, rows, n, batch);
+            for (int64_t b = 0; b < batch; b++) {
+                for (int64_t i = 0; i < rows; i++) {
+                    fp64_t e = 0;
+                    for (int j = 0; j < n; j++) {
+                        e += mx64[i * sm + j] * vc64[b * sb + j];
+                    }
+                    const int64_t x = b * sr + i;
+                    fatal_if(r16_32[x] != e || r32[x] != e || r64[x] != e,
+                        "k: %lld m: %lld r[%lld][%lld] %.1f %.1f %.1f "
+                        "expected: %.1f", batch, rows, b, i,
+                        r16_32[x], r32[x], r64[x], e);
+                }
+            }
+        }
+    }
+}
+
+void gemv_test() {
+    // small integers keep all sums exact in fp16_t, bf16_t, fp32_t and fp64_t
+    enum { m = 19, n = 37, sm = 41, sv = 3 };
+    static fp16_t mx16[m * sm], vc16[n * sv], r16[m];
+    static bf16_t mxbf[m * sm], vcbf[n * sv], rbf[m];
+    static fp32_t mx32[m * sm], vc32[n * sv], r32[m], r16_32[m];
+    static fp64_t mx64[m * sm], vc64[n * sv], r64[m];
+    for (int i = 0; i < m * sm; i++) {
+        mx64[i] = mx32[i] = (fp32_t)(i % 5 - 2);
+        mx16[i] = fp32to16(mx32[i]);
+        mxbf[i] = fp32tobf16(mx32[i]);
+    }
+    for (int j = 0; j < n * sv; j++) {
+        vc64[j] = vc32[j] = (fp32_t)(j % 3 - 1);
+        vc16[j] = fp32to16(vc32[j]);
+        vcbf[j] = fp32tobf16(vc32[j]);
+    }
+    for (int64_t columns = 1; columns <= n; columns += 4) {
+        for (int64_t stride_v = 1; stride_v <= sv; stride_v += 2) {
+            gemv16(mx16, sm, vc16, stride_v, r16, m, columns);
+            gemv16_32(mx16, sm, vc32, stride_v, r16_32, m, columns);
+            gemvbf16(mxbf, sm, vcbf, stride_v, rbf, m, columns);
+            gemv32(mx32, sm, vc32, stride_v, r32, m, columns);
+            gemv64(mx64, sm, vc64, stride_v, r64, m, columns);
+            for (int i = 0; i < m; i++) {
+                fp64_t e = 0;
+                for (int j = 0; j < columns; j++) {
+                    e += mx64[i * sm + j] * vc64[j * stride_v];
+                }
+                fatal_if(fp16to32(r16[i]) != e || r16_32[i] != e ||
+                         bf16to32(rbf[i]) != e || r32[i] != e || r64[i] != e,
+                    "n: %lld sv: %lld r[%d] %.1f %.1f %.1f %.1f %.1f "
+                    "expected: %.1f", columns, stride_v, i, fp16to32(r16[i]),
+                    r16_32[i], bf16to32(rbf[i]), r32[i], r64[i], e);
+            }
+        }
+    }
+    gemv_test_batch();
+}
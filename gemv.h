@@ -0,0 +1,63 @@
+#pragma once
+#include "rt.h"
+
+#ifdef cplusplus
+extern "C" {
+#endif
+
+// Host matrix x vector with the semantics of the gemv_os kernel:
+//   result[i] = sum(matrix[i * stride_m + j] * vector[j * stride_v])
+//   for i in [0..m) and j in [0..n), stride_m >= n, stride_v >= 1
+// Matrix offsets are expressed by the matrix and vector pointers.
+// gemv16() is fp16_t weights with fp16_t vector and result (like device
+// blast_fpp16), gemv16_32() is fp16_t weights with fp32_t vector and result,
+// gemvbf16() is bf16_t weights, vector and result (like blast_fppbf16).
+// Products are accumulated in fp32_t (fp64_t for gemv64()).
+
+void gemv16(const fp16_t* matrix, int64_t stride_m,
+            const fp16_t* vector, int64_t stride_v,
+            fp16_t* result, int64_t m, int64_t n);
+
+void gemv16_32(const fp16_t* matrix, int64_t stride_m,
+               const fp32_t* vector, int64_t stride_v,
+               fp32_t* result, int64_t m, int64_t n);
+
+void gemv32(const fp32_t* matrix, int64_t stride_m,
+            const fp32_t* vector, int64_t stride_v,
+            fp32_t* result, int64_t m, int64_t n);
+
+void gemv64(const fp64_t* matrix, int64_t stride_m,
+            const fp64_t* vector, int64_t stride_v,
+            fp64_t* result, int64_t m, int64_t n);
+
+void gemvbf16(const bf16_t* matrix, int64_t stride_m,
+              const bf16_t* vector, int64_t stride_v,
+              bf16_t* result, int64_t m, int64_t n);
+
+// Batched gemv multiplies the matrix by k vectors in a single pass:
+//   results[b * stride_r + i] = sum(matrix[i * stride_m + j] *
+//                                   vectors[b * stride_b + j])
+//   for b in [0..k), k in [1..gemv_batch_max], vectors are contiguous.
+
+enum { gemv_batch_max = 16 };
+
+void gemv16_32_batch(const fp16_t* matrix, int64_t stride_m,
+                     const fp32_t* vectors, int64_t stride_b,
+                     fp32_t* results, int64_t stride_r,
+                     int64_t m, int64_t n, int64_t k);
+
+void gemv32_batch(const fp32_t* matrix, int64_t stride_m,
+                  const fp32_t* vectors, int64_t stride_b,
+                  fp32_t* results, int64_t stride_r,
+                  int64_t m, int64_t n, int64_t k);
+
+void gemv64_batch(const fp64_t* matrix, int64_t stride_m,
+                  const fp64_t* vectors, int64_t stride_b,
+                  fp64_t* results, int64_t stride_r,
+                  int64_t m, int64_t n, int64_t k);
+
+void gemv_test();
+
+#ifdef cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,66 @@
+#include "isa.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static void isa_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t r[4]) {
+    #if defined(_MSC_VER)
+        int regs[4] = {0};
+        __cpuidex(regs, (int)leaf, (int)subleaf);
+        for (int i = 0; i < 4; i++) { r[i] = (uint32_t)regs[i]; }
+    #else
+        __cpuid_count(leaf, subleaf, r[0], r[1], r[2], r[3]);
+    #endif
+}
+
+static uint64_t isa_xgetbv(void) { // only valid if CPUID.1:ECX.OSXSAVE
+    #if defined(_MSC_VER)
+        return _xgetbv(0);
+    #else
+        uint32_t eax = 0;
+        uint32_t edx = 0;
+        __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((uint64_t)edx << 32) | eax;
+    #endif
+}
+
+#define isa_bit(r, b) (((r) >> (b)) & 1)
+
+static void isa_init(void) {
+    static bool init;
+    if (init) { return; }
+    init = true;
+    enum { eax = 0, ebx = 1, ecx = 2, edx = 3 };
+    uint32_t r0[4] = {0}; // max leaf
+    uint32_t r1[4] = {0}; // leaf 1
+    uint32_t r7[4] = {0}; // leaf 7 subleaf 0
+    uint32_t r71[4] = {0}; // leaf 7 subleaf 1
+    isa_cpuid(0, 0, r0);
+    if (r0[eax] >= 1) { isa_cpuid(1, 0, r1); }
+    if (r0[eax] >= 7) {
+        isa_cpuid(7, 0, r7);
+        if (r7[eax] >= 1) { isa_cpuid(7, 1, r71); }
+    }
+    const bool osxsave = isa_bit(r1[ecx], 27);
+    const uint64_t xcr0 = osxsave ? isa_xgetbv() : 0;
+    // XCR0: 1 SSE, 2 AVX (upper YMM), 5 opmask, 6 ZMM_Hi256, 7 Hi16_ZMM
+    const bool ymm = (xcr0 & 0x06) == 0x06;
+    const bool zmm = ymm && (xcr0 & 0xE0) == 0xE0;
+    const bool avx = ymm && isa_bit(r1[ecx], 28);
+    isa.fma        = avx && isa_bit(r1[ecx], 12);
+    isa.f16c       = avx && isa_bit(r1[ecx], 29);
+    isa.avx2       = avx && isa_bit(r7[ebx], 5);
+    isa.avx_vnni   = avx && isa_bit(r71[eax], 4);
+    isa.avx512f    = zmm && isa_bit(r7[ebx], 16);
+    isa.avx512bw   = isa.avx512f && isa_bit(r7[ebx], 30);
+    isa.avx512vl   = isa.avx512f && isa_bit(r7[ebx], 31);
+    isa.avx512vnni = isa.avx512f && isa_bit(r7[ecx], 11);
+    isa.avx512fp16 = isa.avx512f && isa_bit(r7[edx], 23);
+    isa.avx512bf16 = isa.avx512f && isa_bit(r71[eax], 5);
+}
+
+#undef isa_bit
+
+isa_if isa = { .init = isa_init };
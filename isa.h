@@ -0,0 +1,38 @@
+#pragma once
+#include "rt.h"
+
+#ifdef cplusplus
+extern "C" {
+#endif
+
+// Instruction set extensions reported by CPUID and enabled by the OS
+// in XCR0 (XGETBV) for the register state they need. isa.init() is
+// idempotent and cheap; flags are false until it is called.
+
+typedef struct isa_if {
+    void (*init)(void);
+    bool avx2;
+    bool fma;
+    bool f16c;
+    bool avx512f;
+    bool avx512vl;
+    bool avx512bw;
+    bool avx512vnni;
+    bool avx512fp16;
+    bool avx512bf16;
+    bool avx_vnni;
+} isa_if;
+
+extern isa_if isa;
+
+// GCC and Clang need per function target attribute to emit instructions
+// not enabled by -m flags of the translation unit, MSVC does not:
+#if defined(__GNUC__) || defined(__clang__)
+#define isa_target(features) __attribute__((target(features)))
+#else
+#define isa_target(features)
+#endif // usage: isa_target("avx2,fma") static void foo(void) { ... }
+
+#ifdef cplusplus
+} // extern "C"
+#endif
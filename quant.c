@@ -0,0 +1,618 @@
+#include <immintrin.h>
+#include "quant.h"
+#include "isa.h"
+
+// Weights stay quantized in memory and are expanded to int8_t lanes in
+// registers only. The fp32_t vector is quantized to int8_t blocks
+// (quant_v_t) so that a block product is a single integer dot product:
+//   q8: sum(dw * qw * dv * qv)       = dw * dv * sum(qw * qv)
+//   q4: sum((dw * qw + mw) * dv * qv) = dw * dv * sum(qw * qv) + mw * dv * s
+// where s = sum(qv) is precomputed per vector block.
+// AVX2 _mm256_maddubs_epi16() multiplies unsigned by signed bytes, q8
+// weights are made unsigned by moving their sign onto the vector:
+//   qw * qv = abs(qw) * sign(qv, qw)
+// With |q| <= 127 adjacent pair sums fit into int16_t without saturation.
+
+typedef struct quant_v_s {
+    fp32_t  d;
+    int32_t s; // sum(q[i])
+    int8_t  q[quant_block];
+} quant_v_t;
+
+enum { quant_stack = 128 }; // quantized vector blocks on stack (4K elements)
+
+typedef struct quant_simd_s {
+    fp64_t (*dot_q8)(const q8_t* w, const quant_v_t* v, int64_t blocks);
+    fp64_t (*dot_q4)(const q4_t* w, const quant_v_t* v, int64_t blocks);
+    fp64_t (*dot_e4m3)(const fp8_e4m3_t* w, const fp32_t* v, int64_t n);
+    fp64_t (*dot_e5m2)(const fp8_e5m2_t* w, const fp32_t* v, int64_t n);
+} quant_simd_t;
+
+// fp8 to fp32_t conversion tables filled by quant_init():
+static fp32_t quant_e4m3[256];
+static fp32_t quant_e5m2[256];
+
+static fp64_t cpu_dot_q8(const q8_t* w, const quant_v_t* v, int64_t blocks) {
+    fp64_t sum = 0;
+    for (int64_t b = 0; b < blocks; b++) {
+        int32_t s = 0;
+        for (int i = 0; i < quant_block; i++) { s += w[b].q[i] * v[b].q[i]; }
+        sum += (fp32_t)s * (fp16to32(w[b].d) * v[b].d);
+    }
+    return sum;
+}
+
+static fp64_t cpu_dot_q4(const q4_t* w, const quant_v_t* v, int64_t blocks) {
+    enum { half = quant_block / 2 };
+    fp64_t sum = 0;
+    for (int64_t b = 0; b < blocks; b++) {
+        int32_t s = 0;
+        for (int i = 0; i < half; i++) {
+            s += (w[b].q[i] & 0xF) * v[b].q[i] + (w[b].q[i] >> 4) * v[b].q[i + half];
+        }
+        sum += (fp32_t)s * (fp16to32(w[b].d) * v[b].d) +
+               fp16to32(w[b].m) * v[b].d * (fp32_t)v[b].s;
+    }
+    return sum;
+}
+
+static fp64_t cpu_dot_e4m3(const fp8_e4m3_t* w, const fp32_t* v, int64_t n) {
+    fp64_t sum = 0;
+    for (int64_t i = 0; i < n; i++) { sum += quant_e4m3[w[i].bytes] * v[i]; }
+    return sum;
+}
+
+static fp64_t cpu_dot_e5m2(const fp8_e5m2_t* w, const fp32_t* v, int64_t n) {
+    fp64_t sum = 0;
+    for (int64_t i = 0; i < n; i++) { sum += quant_e5m2[w[i].bytes] * v[i]; }
+    return sum;
+}
+
+static quant_simd_t quant_simd = {
+    .dot_q8 = cpu_dot_q8,
+    .dot_q4 = cpu_dot_q4,
+    .dot_e4m3 = cpu_dot_e4m3,
+    .dot_e5m2 = cpu_dot_e5m2
+};
+
+#define f32x8_t __m256
+#define f32x4_t __m128
+#define i8x32_t __m256i
+
+isa_target("f16c")
+static inline fp32_t f16c_fp16to32(fp16_t v) {
+    return _mm_cvtss_f32(_mm_cvtph_ps(_mm_cvtsi32_si128(v.bytes)));
+}
+
+isa_target("avx2")
+static inline fp64_t avx2_quant_sum(f32x8_t a) {
+    f32x4_t s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    return _mm_cvtss_f32(s);
+}
+
+// unsigned x signed byte products summed to int32_t lanes:
+
+isa_target("avx2")
+static inline __m256i avx2_dpbusd(i8x32_t u, i8x32_t s) {
+    return _mm256_madd_epi16(_mm256_maddubs_epi16(u, s), _mm256_set1_epi16(1));
+}
+
+#define avx_vnni_dpbusd(u, s)    _mm256_dpbusd_avx_epi32(_mm256_setzero_si256(), u, s)
+#define avx512_vnni_dpbusd(u, s) _mm256_dpbusd_epi32(_mm256_setzero_si256(), u, s)
+
+// q4_t bytes to 32 unsigned lanes: low nibbles 0..15, high nibbles 16..31
+isa_target("avx2")
+static inline i8x32_t avx2_q4_unpack(const uint8_t* q) {
+    const __m128i b = _mm_loadu_si128((const __m128i*)q);
+    const __m128i mask = _mm_set1_epi8(0xF);
+    return _mm256_set_m128i(_mm_and_si128(_mm_srli_epi16(b, 4), mask),
+                            _mm_and_si128(b, mask));
+}
+
+// Kernel bodies are shared by AVX2 and VNNI versions that differ only
+// in dpbusd(). Two independent accumulators hide FMA latency.
+
+#define quant_dot_q8_body(dpbusd) do {                                  \
+    f32x8_t a[2] = { _mm256_setzero_ps(), _mm256_setzero_ps() };        \
+    for (int64_t b = 0; b < blocks; b++) {                              \
+        const i8x32_t x = _mm256_loadu_si256((const __m256i*)w[b].q);   \
+        const i8x32_t y = _mm256_loadu_si256((const __m256i*)v[b].q);   \
+        const __m256i p = dpbusd(_mm256_sign_epi8(x, x),                \
+                                 _mm256_sign_epi8(y, x));               \
+        const f32x8_t d = _mm256_set1_ps(f16c_fp16to32(w[b].d) * v[b].d); \
+        a[b & 1] = _mm256_fmadd_ps(_mm256_cvtepi32_ps(p), d, a[b & 1]); \
+    }                                                                   \
+    return avx2_quant_sum(_mm256_add_ps(a[0], a[1]));                   \
+} while (0)
+
+#define quant_dot_q4_body(dpbusd) do {                                  \
+    f32x8_t a[2] = { _mm256_setzero_ps(), _mm256_setzero_ps() };        \
+    fp32_t sm = 0; /* sum of mw * dv * s */                             \
+    for (int64_t b = 0; b < blocks; b++) {                              \
+        const i8x32_t x = avx2_q4_unpack(w[b].q);                       \
+        const i8x32_t y = _mm256_loadu_si256((const __m256i*)v[b].q);   \
+        const __m256i p = dpbusd(x, y);                                 \
+        const f32x8_t d = _mm256_set1_ps(f16c_fp16to32(w[b].d) * v[b].d); \
+        a[b & 1] = _mm256_fmadd_ps(_mm256_cvtepi32_ps(p), d, a[b & 1]); \
+        sm += f16c_fp16to32(w[b].m) * v[b].d * (fp32_t)v[b].s;          \
+    }                                                                   \
+    return avx2_quant_sum(_mm256_add_ps(a[0], a[1])) + sm;              \
+} while (0)
+
+isa_target("avx2,fma,f16c")
+static fp64_t avx2_dot_q8(const q8_t* w, const quant_v_t* v, int64_t blocks) {
+    quant_dot_q8_body(avx2_dpbusd);
+}
+
+isa_target("avx2,fma,f16c")
+static fp64_t avx2_dot_q4(const q4_t* w, const quant_v_t* v, int64_t blocks) {
+    quant_dot_q4_body(avx2_dpbusd);
+}
+
+isa_target("avx2,fma,f16c,avxvnni")
+static fp64_t avx_vnni_dot_q8(const q8_t* w, const quant_v_t* v, int64_t blocks) {
+    quant_dot_q8_body(avx_vnni_dpbusd);
+}
+
+isa_target("avx2,fma,f16c,avxvnni")
+static fp64_t avx_vnni_dot_q4(const q4_t* w, const quant_v_t* v, int64_t blocks) {
+    quant_dot_q4_body(avx_vnni_dpbusd);
+}
+
+isa_target("avx2,fma,f16c,avx512vnni,avx512vl")
+static fp64_t avx512_vnni_dot_q8(const q8_t* w, const quant_v_t* v, int64_t blocks) {
+    quant_dot_q8_body(avx512_vnni_dpbusd);
+}
+
+isa_target("avx2,fma,f16c,avx512vnni,avx512vl")
+static fp64_t avx512_vnni_dot_q4(const q4_t* w, const quant_v_t* v, int64_t blocks) {
+    quant_dot_q4_body(avx512_vnni_dpbusd);
+}
+
+// fp8 weights are widened in registers by F16C: e5m2 is the upper byte
+// of fp16_t and e4m3 placed into fp16_t bits (sign to bit 15, exponent
+// and mantissa to bits 7..13) is its value scaled by pow(2, -8) because
+// fp16_t exponent bias is 15 vs 7. Sums are scaled back once. The e4m3
+// NaN patterns are set to all ones (NaN) after conversion. This is not
+// slower than _mm256_i32gather_ps() from the tables and does not depend
+// on gather performance that differs a lot between processors.
+// fp32_t sums of 4K elements blocks are accumulated in fp64_t.
+
+enum { quant_fp8_block = 4 * 1024 };
+
+isa_target("avx2,f16c")
+static inline f32x8_t avx2_e4m3x8(const fp8_e4m3_t* p) {
+    const __m128i b = _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i*)p));
+    const __m128i h = _mm_and_si128(_mm_slli_epi16(b, 7),
+                                    _mm_set1_epi16((int16_t)0xBF80));
+    const __m128i bits = _mm_set1_epi16(0x3F80);
+    const __m128i nan = _mm_cmpeq_epi16(_mm_and_si128(h, bits), bits);
+    return _mm256_or_ps(_mm256_cvtph_ps(h),
+                        _mm256_castsi256_ps(_mm256_cvtepi16_epi32(nan)));
+}
+
+isa_target("avx2,f16c")
+static inline f32x8_t avx2_e5m2x8(const fp8_e5m2_t* p) {
+    const __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)p));
+    return _mm256_cvtph_ps(_mm_slli_epi16(b, 8));
+}
+
+#define quant_dot_fp8_body(widen, table, scale) do {                    \
+    fp64_t sum = 0;                                                     \
+    while (n >= 16) {                                                   \
+        f32x8_t a[2] = { _mm256_setzero_ps(), _mm256_setzero_ps() };    \
+        int64_t k = min(n, (int64_t)quant_fp8_block) & ~15LL;           \
+        n -= k;                                                         \
+        while (k > 0) {                                                 \
+            a[0] = _mm256_fmadd_ps(widen(w), _mm256_loadu_ps(v), a[0]);  \
+            a[1] = _mm256_fmadd_ps(widen(w + 8), _mm256_loadu_ps(v + 8), a[1]); \
+            w += 16; v += 16; k -= 16;                                  \
+        }                                                               \
+        sum += avx2_quant_sum(_mm256_add_ps(a[0], a[1])) * (scale);     \
+    }                                                                   \
+    while (n > 0) { sum += table[(w++)->bytes] * *v++; n--; }           \
+    return sum;                                                         \
+} while (0)
+
+isa_target("avx2,fma,f16c")
+static fp64_t avx2_dot_e4m3(const fp8_e4m3_t* w, const fp32_t* v, int64_t n) {
+    quant_dot_fp8_body(avx2_e4m3x8, quant_e4m3, 256.0);
+}
+
+isa_target("avx2,fma,f16c")
+static fp64_t avx2_dot_e5m2(const fp8_e5m2_t* w, const fp32_t* v, int64_t n) {
+    quant_dot_fp8_body(avx2_e5m2x8, quant_e5m2, 1.0);
+}
+
+static void quant_init(void) {
+    static bool init;
+    if (!init) {
+        isa.init();
+        for (int i = 0; i < 256; i++) {
+            quant_e4m3[i] = e4m3to32(e4m3x((uint8_t)i));
+            quant_e5m2[i] = e5m2to32(e5m2x((uint8_t)i));
+        }
+        if (isa.avx2 && isa.fma && isa.f16c) {
+            if (isa.avx_vnni) {
+                quant_simd.dot_q8 = avx_vnni_dot_q8;
+                quant_simd.dot_q4 = avx_vnni_dot_q4;
+            } else if (isa.avx512vnni && isa.avx512vl) {
+                quant_simd.dot_q8 = avx512_vnni_dot_q8;
+                quant_simd.dot_q4 = avx512_vnni_dot_q4;
+            } else {
+                quant_simd.dot_q8 = avx2_dot_q8;
+                quant_simd.dot_q4 = avx2_dot_q4;
+            }
+            quant_simd.dot_e4m3 = avx2_dot_e4m3;
+            quant_simd.dot_e5m2 = avx2_dot_e5m2;
+        }
+        init = true;
+    }
+}
+
+static int8_t quant_round(fp32_t x) { // x in [-127.5..127.5]
+    return (int8_t)(x < 0 ? x - 0.5f : x + 0.5f);
+}
+
+static void quant_vector(const fp32_t* v, quant_v_t* q, int64_t n) {
+    for (int64_t b = 0; b < n / quant_block; b++) {
+        const fp32_t* x = v + b * quant_block;
+        fp32_t amax = 0;
+        for (int i = 0; i < quant_block; i++) { amax = max(amax, fabsf(x[i])); }
+        const fp32_t d = amax / 127;
+        const fp32_t id = d != 0 ? 1 / d : 0;
+        q[b].d = d;
+        q[b].s = 0;
+        for (int i = 0; i < quant_block; i++) {
+            q[b].q[i] = quant_round(x[i] * id);
+            q[b].s += q[b].q[i];
+        }
+    }
+}
+
+void quantize_q8(const fp32_t* v, q8_t* q, int64_t n) {
+    fatal_if(n % quant_block != 0, "n: %lld", n);
+    for (int64_t b = 0; b < n / quant_block; b++) {
+        const fp32_t* x = v + b * quant_block;
+        fp32_t amax = 0;
+        for (int i = 0; i < quant_block; i++) { amax = max(amax, fabsf(x[i])); }
+        q[b].d = fp32to16(amax / 127);
+        // divide by the rounded scale that dequantization will use:
+        const fp32_t d = fp16to32(q[b].d);
+        const fp32_t id = d != 0 ? 1 / d : 0;
+        for (int i = 0; i < quant_block; i++) {
+            const fp32_t y = x[i] * id;
+            q[b].q[i] = quant_round(max(-127.0f, min(y, 127.0f)));
+        }
+    }
+}
+
+void quantize_q4(const fp32_t* v, q4_t* q, int64_t n) {
+    enum { half = quant_block / 2 };
+    fatal_if(n % quant_block != 0, "n: %lld", n);
+    for (int64_t b = 0; b < n / quant_block; b++) {
+        const fp32_t* x = v + b * quant_block;
+        fp32_t lo = x[0];
+        fp32_t hi = x[0];
+        for (int i = 1; i < quant_block; i++) {
+            lo = min(lo, x[i]);
+            hi = max(hi, x[i]);
+        }
+        q[b].d = fp32to16((hi - lo) / 15);
+        q[b].m = fp32to16(lo);
+        const fp32_t d = fp16to32(q[b].d);
+        const fp32_t m = fp16to32(q[b].m);
+        const fp32_t id = d != 0 ? 1 / d : 0;
+        for (int i = 0; i < half; i++) {
+            int32_t q0 = (int32_t)((x[i] - m) * id + 0.5f);
+            int32_t q1 = (int32_t)((x[i + half] - m) * id + 0.5f);
+            q0 = max(0, min(q0, 15));
+            q1 = max(0, min(q1, 15));
+            q[b].q[i] = (uint8_t)(q0 | (q1 << 4));
+        }
+    }
+}
+
+void dequantize_q8(const q8_t* q, fp32_t* v, int64_t n) {
+    fatal_if(n % quant_block != 0, "n: %lld", n);
+    for (int64_t b = 0; b < n / quant_block; b++) {
+        const fp32_t d = fp16to32(q[b].d);
+        for (int i = 0; i < quant_block; i++) {
+            v[b * quant_block + i] = d * q[b].q[i];
+        }
+    }
+}
+
+void dequantize_q4(const q4_t* q, fp32_t* v, int64_t n) {
+    enum { half = quant_block / 2 };
+    fatal_if(n % quant_block != 0, "n: %lld", n);
+    for (int64_t b = 0; b < n / quant_block; b++) {
+        const fp32_t d = fp16to32(q[b].d);
+        const fp32_t m = fp16to32(q[b].m);
+        fp32_t* x = v + b * quant_block;
+        for (int i = 0; i < half; i++) {
+            x[i]        = d * (q[b].q[i] & 0xF) + m;
+            x[i + half] = d * (q[b].q[i] >> 4)  + m;
+        }
+    }
+}
+
+static quant_v_t* quant_vector_alloc(quant_v_t* stack, int64_t n) {
+    fatal_if(n % quant_block != 0, "n: %lld", n);
+    const int64_t blocks = n / quant_block;
+    quant_v_t* q = blocks <= quant_stack ? stack :
+        (quant_v_t*)malloc(blocks * sizeof(quant_v_t));
+    fatal_if(q == null, "out of memory n: %lld", n);
+    return q;
+}
+
+static void quant_vector_free(quant_v_t* stack, quant_v_t* q) {
+    if (q != stack) { free(q); }
+}
+
+fp64_t dot_q8(const q8_t* w, const fp32_t* v, int64_t n) {
+    quant_init();
+    quant_v_t stack[quant_stack];
+    quant_v_t* q = quant_vector_alloc(stack, n);
+    quant_vector(v, q, n);
+    fp64_t s = quant_simd.dot_q8(w, q, n / quant_block);
+    quant_vector_free(stack, q);
+    return s;
+}
+
+fp64_t dot_q4(const q4_t* w, const fp32_t* v, int64_t n) {
+    quant_init();
+    quant_v_t stack[quant_stack];
+    quant_v_t* q = quant_vector_alloc(stack, n);
+    quant_vector(v, q, n);
+    fp64_t s = quant_simd.dot_q4(w, q, n / quant_block);
+    quant_vector_free(stack, q);
+    return s;
+}
+
+void gemv_q8(const q8_t* matrix, int64_t stride_m, const fp32_t* vector,
+             fp32_t* result, int64_t m, int64_t n) {
+    fatal_if(stride_m < n || stride_m % quant_block != 0,
+             "stride_m: %lld n: %lld", stride_m, n);
+    quant_init();
+    quant_v_t stack[quant_stack];
+    quant_v_t* q = quant_vector_alloc(stack, n);
+    quant_vector(vector, q, n);
+    const int64_t blocks = n / quant_block;
+    const int64_t row = stride_m / quant_block;
+    for (int64_t i = 0; i < m; i++) {
+        result[i] = (fp32_t)quant_simd.dot_q8(matrix + i * row, q, blocks);
+    }
+    quant_vector_free(stack, q);
+}
+
+void gemv_q4(const q4_t* matrix, int64_t stride_m, const fp32_t* vector,
+             fp32_t* result, int64_t m, int64_t n) {
+    fatal_if(stride_m < n || stride_m % quant_block != 0,
+             "stride_m: %lld n: %lld", stride_m, n);
+    quant_init();
+    quant_v_t stack[quant_stack];
+    quant_v_t* q = quant_vector_alloc(stack, n);
+    quant_vector(vector, q, n);
+    const int64_t blocks = n / quant_block;
+    const int64_t row = stride_m / quant_block;
+    for (int64_t i = 0; i < m; i++) {
+        result[i] = (fp32_t)quant_simd.dot_q4(matrix + i * row, q, blocks);
+    }
+    quant_vector_free(stack, q);
+}
+
+void quantize_e4m3(const fp32_t* v, fp8_e4m3_t* q, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { q[i] = fp32toe4m3(v[i]); }
+}
+
+void quantize_e5m2(const fp32_t* v, fp8_e5m2_t* q, int64_t n) {
+    for (int64_t i = 0; i < n; i++) { q[i] = fp32toe5m2(v[i]); }
+}
+
+void dequantize_e4m3(const fp8_e4m3_t* q, fp32_t* v, int64_t n) {
+    quant_init();
+    for (int64_t i = 0; i < n; i++) { v[i] = quant_e4m3[q[i].bytes]; }
+}
+
+void dequantize_e5m2(const fp8_e5m2_t* q, fp32_t* v, int64_t n) {
+    quant_init();
+    for (int64_t i = 0; i < n; i++) { v[i] = quant_e5m2[q[i].bytes]; }
+}
+
+fp64_t dot_e4m3(const fp8_e4m3_t* w, const fp32_t* v, int64_t n) {
+    quant_init();
+    return quant_simd.dot_e4m3(w, v, n);
+}
+
+fp64_t dot_e5m2(const fp8_e5m2_t* w, const fp32_t* v, int64_t n) {
+    quant_init();
+    return quant_simd.dot_e5m2(w, v, n);
+}
+
+void gemv_e4m3(const fp8_e4m3_t* matrix, int64_t stride_m, const fp32_t* vector,
+               fp32_t* result, int64_t m, int64_t n) {
+    fatal_if(stride_m < n, "stride_m: %lld n: %lld", stride_m, n);
+    quant_init();
+    for (int64_t i = 0; i < m; i++) {
+        result[i] = (fp32_t)quant_simd.dot_e4m3(matrix + i * stride_m, vector, n);
+    }
+}
+
+void gemv_e5m2(const fp8_e5m2_t* matrix, int64_t stride_m, const fp32_t* vector,
+               fp32_t* result, int64_t m, int64_t n) {
+    fatal_if(stride_m < n, "stride_m: %lld n: %lld", stride_m, n);
+    quant_init();
+    for (int64_t i = 0; i < m; i++) {
+        result[i] = (fp32_t)quant_simd.dot_e5m2(matrix + i * stride_m, vector, n);
+    }
+}
+
+static void quant_test_exact() {
+    // integer weights and vectors with 127 (15 for q4_t) in every block
+    // quantize with unit scales, so all kernels must be exact:
+    enum { m = 5, n = 8 * quant_block, sm = n + quant_block };
+    static fp32_t mx[m * sm], v[n], x[n], r8[m], r4[m];
+    static q8_t w8[m * sm / quant_block];
+    static q4_t w4[m * sm / quant_block];
+    for (int j = 0; j < n; j++) {
+        v[j] = j % quant_block == 0 ? 127.0f : (fp32_t)(j * 7 % 255 - 127);
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        const bool q4 = pass == 1;
+        for (int i = 0; i < m * sm; i++) {
+            mx[i] = q4 ? (fp32_t)(i % quant_block == 0 ? 15 : (i * 5) % 16) :
+                         (fp32_t)(i % quant_block == 0 ? -127 : (i * 3) % 255 - 127);
+        }
+        if (q4) {
+            quantize_q4(mx, w4, m * sm);
+            dequantize_q4(w4, x, n);
+            gemv_q4(w4, sm, v, r4, m, n);
+        } else {
+            quantize_q8(mx, w8, m * sm);
+            dequantize_q8(w8, x, n);
+            gemv_q8(w8, sm, v, r8, m, n);
+        }
+        for (int j = 0; j < n; j++) {
+            fatal_if(x[j] != mx[j], "q%d x[%d]: %.1f expected: %.1f",
+                     q4 ? 4 : 8, j, x[j], mx[j]);
+        }
+        for (int i = 0; i < m; i++) {
+            fp64_t e = 0;
+            for (int j = 0; j < n; j++) { e += (fp64_t)mx[i * sm + j] * v[j]; }
+            const fp64_t r = q4 ? r4[i] : r8[i];
+            const fp64_t d = q4 ? dot_q4(w4 + i * sm / quant_block, v, n) :
+                                  dot_q8(w8 + i * sm / quant_block, v, n);
+            fatal_if(r != e || d != e, "q%d r[%d]: %.1f dot: %.1f expected: %.1f",
+                     q4 ? 4 : 8, i, r, d, e);
+        }
+    }
+}
+
+static void quant_test_error() {
+    // random weights: error is bounded by the quantization steps
+    enum { n = 64 * quant_block };
+    static fp32_t w[n], v[n], x8[n], x4[n];
+    static q8_t w8[n / quant_block];
+    static q4_t w4[n / quant_block];
+    uint32_t seed = 1;
+    for (int j = 0; j < n; j++) {
+        w[j] = (fp32_t)random32(&seed) / UINT32_MAX * 2 - 1;
+        v[j] = (fp32_t)random32(&seed) / UINT32_MAX * 2 - 1;
+    }
+    quantize_q8(w, w8, n);
+    quantize_q4(w, w4, n);
+    dequantize_q8(w8, x8, n);
+    dequantize_q4(w4, x4, n);
+    fp64_t e8 = 0, e4 = 0;
+    for (int j = 0; j < n; j++) {
+        fatal_if(fabsf(x8[j] - w[j]) > 1.0f / 127, "x8[%d]", j);
+        fatal_if(fabsf(x4[j] - w[j]) > 2.0f / 15,  "x4[%d]", j);
+        e8 += (fp64_t)x8[j] * v[j];
+        e4 += (fp64_t)x4[j] * v[j];
+    }
+    // vector quantization adds at most 1/254 of each |w * v| product
+    const fp64_t d8 = dot_q8(w8, v, n);
+    const fp64_t d4 = dot_q4(w4, v, n);
+    fatal_if(fabs(d8 - e8) > n / 254.0 || fabs(d4 - e4) > n / 254.0,
+             "dot_q8: %.6f %.6f dot_q4: %.6f %.6f", d8, e8, d4, e4);
+}
+
+// fp8 round trips of all 256 values and rounding of fp32_t values
+// against the nearest representable value found by exhaustive search.
+
+static void quant_test_fp8_convert() {
+    for (int i = 0; i < 256; i++) {
+        const fp32_t x4 = e4m3to32(e4m3x((uint8_t)i));
+        const fp32_t x5 = e5m2to32(e5m2x((uint8_t)i));
+        fatal_if(!isnan(x4) && fp32toe4m3(x4).bytes != i, "e4m3 0x%02X", i);
+        fatal_if(!isnan(x5) && fp32toe5m2(x5).bytes != i, "e5m2 0x%02X", i);
+        fatal_if(isnan(x4) != ((i & 0x7F) == 0x7F), "e4m3 NaN 0x%02X", i);
+    }
+    uint32_t seed = 1;
+    for (int k = 0; k < 20000; k++) {
+        const fp32_t f = ((fp32_t)random32(&seed) / UINT32_MAX * 2 - 1) *
+                         (fp32_t)pow(2, (int)(random32(&seed) % 40) - 22);
+        for (int e5 = 0; e5 < 2; e5++) {
+            fp32_t best = 0;
+            int q = 0;
+            for (int i = 0; i < 256; i++) { // nearest, ties to even
+                const fp32_t x = e5 ? e5m2to32(e5m2x((uint8_t)i)) :
+                                      e4m3to32(e4m3x((uint8_t)i));
+                if (!isfinite(x) || (x == 0 && i != 0)) { continue; }
+                const fp32_t d = fabsf(x - f), b = fabsf(best - f);
+                if (d < b || (d == b && (i & 1) == 0 && (q & 1) != 0)) {
+                    best = x;
+                    q = i;
+                }
+            }
+            const fp32_t r = e5 ? e5m2to32(fp32toe5m2(f)) : e4m3to32(fp32toe4m3(f));
+            const fp32_t x = e5 ? 57344.0f : 448.0f;
+            if (fabsf(f) <= x) {
+                fatal_if(r != best, "%s %.9e: %.9e expected %.9e",
+                         e5 ? "e5m2" : "e4m3", f, r, best);
+            }
+        }
+    }
+}
+
+static void quant_test_fp8() {
+    // small integers and halves are exact in both fp8 formats:
+    enum { m = 3, n = 1000, sm = n + 5 };
+    static fp32_t mx[m * sm], v[n], x[n], r[m];
+    static fp8_e4m3_t w4[m * sm];
+    static fp8_e5m2_t w5[m * sm];
+    for (int j = 0; j < n; j++) { v[j] = (fp32_t)(j % 7 - 3); }
+    for (int i = 0; i < m * sm; i++) { mx[i] = (fp32_t)(i % 9 - 4) / 2; }
+    quantize_e4m3(mx, w4, m * sm);
+    quantize_e5m2(mx, w5, m * sm);
+    for (int pass = 0; pass < 2; pass++) {
+        const bool e5 = pass == 1;
+        if (e5) {
+            dequantize_e5m2(w5, x, n);
+        } else {
+            dequantize_e4m3(w4, x, n);
+        }
+        for (int j = 0; j < n; j++) {
+            fatal_if(x[j] != mx[j], "x[%d]: %.1f expected: %.1f", j, x[j], mx[j]);
+        }
+        for (int k = 1; k <= n; k += (k < 40 ? 1 : 97)) {
+            if (e5) {
+                gemv_e5m2(w5, sm, v, r, m, k);
+            } else {
+                gemv_e4m3(w4, sm, v, r, m, k);
+            }
+            for (int i = 0; i < m; i++) {
+                fp64_t e = 0;
+                for (int j = 0; j < k; j++) { e += (fp64_t)mx[i * sm + j] * v[j]; }
+                const fp64_t d = e5 ? dot_e5m2(w5 + i * sm, v, k) :
+                                      dot_e4m3(w4 + i * sm, v, k);
+                fatal_if(r[i] != e || d != e, "%s k: %d r[%d]: %.1f dot: %.1f "
+                         "expected: %.1f", e5 ? "e5m2" : "e4m3", k, i, r[i], d, e);
+            }
+        }
+    }
+    // NaN weights stay NaN:
+    const fp8_e4m3_t nan[16] = { [5] = e4m3x(0xFF) };
+    const fp32_t ones[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+    fatal_if(!isnan(dot_e4m3(nan, ones, 16)), "e4m3 NaN");
+}
+
+void quant_test() {
+    quant_test_exact();
+    quant_test_fp8_convert();
+    quant_test_fp8();
+    // the same with portable scalar kernels:
+    quant_init();
+    quant_simd_t simd = quant_simd;
+    quant_simd.dot_q8 = cpu_dot_q8;
+    quant_simd.dot_q4 = cpu_dot_q4;
+    quant_simd.dot_e4m3 = cpu_dot_e4m3;
+    quant_simd.dot_e5m2 = cpu_dot_e5m2;
+    quant_test_exact();
+    quant_test_fp8();
+    quant_simd = simd;
+    quant_test_error();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "rt.h"
+
+#ifdef cplusplus
+extern "C" {
+#endif
+
+// Block quantized weights. Every block of quant_block consecutive
+// elements carries its own fp16_t scale:
+//   q8_t: x = d * q,     q in [-127..127]
+//   q4_t: x = d * q + m, q in [0..15]
+// q4_t packs elements i and i + 16 of a block into the low and high
+// nibbles of byte q[i]. Vector lengths, row lengths and row strides
+// are multiples of quant_block.
+
+enum { quant_block = 32 };
+
+typedef begin_packed struct q8_s {
+    fp16_t d;
+    int8_t q[quant_block];
+} end_packed q8_t; // 34 bytes: 8.5 bits per element
+
+typedef begin_packed struct q4_s {
+    fp16_t  d;
+    fp16_t  m;
+    uint8_t q[quant_block / 2];
+} end_packed q4_t; // 20 bytes: 5 bits per element
+
+void quantize_q8(const fp32_t* v, q8_t* q, int64_t n);
+void quantize_q4(const fp32_t* v, q4_t* q, int64_t n);
+void dequantize_q8(const q8_t* q, fp32_t* v, int64_t n);
+void dequantize_q4(const q4_t* q, fp32_t* v, int64_t n);
+
+// dot_q8() and dot_q4() quantize fp32_t vector v to int8_t blocks and
+// multiply them by the weights w with integer SIMD instructions (AVX2
+// maddubs or AVX-VNNI dpbusd), blocks are scaled and summed in fp32_t.
+
+fp64_t dot_q8(const q8_t* w, const fp32_t* v, int64_t n);
+fp64_t dot_q4(const q4_t* w, const fp32_t* v, int64_t n);
+
+// result[i] = sum(matrix[i * stride_m + j] * vector[j]) j in [0..n)
+// stride_m in elements. The vector is quantized once for all rows.
+
+void gemv_q8(const q8_t* matrix, int64_t stride_m, const fp32_t* vector,
+             fp32_t* result, int64_t m, int64_t n);
+void gemv_q4(const q4_t* matrix, int64_t stride_m, const fp32_t* vector,
+             fp32_t* result, int64_t m, int64_t n);
+
+// fp8 weights (fp8_e4m3_t, fp8_e5m2_t in fp16.h) are a single byte per
+// element without scales, n and stride_m are arbitrary. quantize_*()
+// round to nearest even, e4m3 saturates at +/-448.
+
+void quantize_e4m3(const fp32_t* v, fp8_e4m3_t* q, int64_t n);
+void quantize_e5m2(const fp32_t* v, fp8_e5m2_t* q, int64_t n);
+void dequantize_e4m3(const fp8_e4m3_t* q, fp32_t* v, int64_t n);
+void dequantize_e5m2(const fp8_e5m2_t* q, fp32_t* v, int64_t n);
+
+fp64_t dot_e4m3(const fp8_e4m3_t* w, const fp32_t* v, int64_t n);
+fp64_t dot_e5m2(const fp8_e5m2_t* w, const fp32_t* v, int64_t n);
+
+void gemv_e4m3(const fp8_e4m3_t* matrix, int64_t stride_m, const fp32_t* vector,
+               fp32_t* result, int64_t m, int64_t n);
+void gemv_e5m2(const fp8_e5m2_t* matrix, int64_t stride_m, const fp32_t* vector,
+               fp32_t* result, int64_t m, int64_t n);
+
+void quant_test();
+
+#ifdef cplusplus
+} // extern "C"
+#endif
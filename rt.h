@@ -32,6 +32,7 @@ int      memmap_resource(const char* label, void* *data, int64_t *bytes);
 void*    load_dl(const char* pathname); // dlopen | LoadLibrary
 void*    find_symbol(void* dl, const char* symbol); // dlsym | GetProcAddress
 void     sleep(double seconds);
+int32_t  cpu_count(void); // number of logical processors available
 
 #if defined(__GNUC__) || defined(__clang__)
 #define attribute_packed __attribute__((packed))
@@ -55,7 +56,18 @@ void     sleep(double seconds);
     #define fp64_t double
 #endif
 
+#if defined(_MSC_VER)
 #define thread_local __declspec(thread)
+#else
+#define thread_local _Thread_local
+#define __debugbreak() __builtin_trap()
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#endif
 
 #define traceln(...) traceline(__FILE__, __LINE__, __func__, "" __VA_ARGS__)
 
@@ -135,6 +147,7 @@ void*    __stdcall LoadResource(void* module, void* res);
 void*    __stdcall LockResource(void* res);
 void*    __stdcall LoadLibraryA(const char* pathname);
 void*    __stdcall GetProcAddress(void* module, const char* pathname);
+uint32_t __stdcall GetActiveProcessorCount(uint16_t group);
 
 
 double seconds() { // since_boot
@@ -222,7 +235,20 @@ void sleep(double seconds) {
     NtDelayExecution(false, &delay);
 }
 
+int32_t cpu_count(void) {
+    enum { all_processor_groups = 0xFFFF };
+    static int32_t count;
+    if (count == 0) {
+        count = (int32_t)GetActiveProcessorCount(all_processor_groups);
+        if (count < 1) { count = 1; }
+    }
+    return count;
+}
+
 /* POSIX:
+#include <unistd.h>
+int32_t cpu_count(void) { return (int32_t)sysconf(_SC_NPROCESSORS_ONLN); }
+
 #include <time.h>
 void sleep(double seconds) {
     struct timespec req = {
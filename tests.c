@@ -1,12 +1,17 @@
 #include "rt.h"
+#include "blas1.h"
 #include "blast.h"
 #include "dot.h"
+#include "gemv.h"
+#include "quant.h"
+#include <process.h>
 
 // TODO: test 1..16 all types, test permutations of offset and shift, test limited max_items = 4, max_groups = 2, test huge, test performance
 
 static uint32_t seed;
 
-static size_t sizes[] = { sizeof(fp16_t), sizeof(fp32_t), sizeof(fp64_t) };
+static size_t sizes[] = { sizeof(fp16_t), sizeof(fp32_t), sizeof(fp64_t),
+                           sizeof(bf16_t) };
 
 typedef struct test_dot_s {
     int64_t bytes0;
@@ -72,6 +77,9 @@ static void test_first_n(blast_t* b, int64_t n, int fpp,
         } else if (fpp == blast_fpp64) {
             *at0(fp64_t, i) = (fp64_t)(i + 1);
             *at1(fp64_t, i) = (fp64_t)(n - i);
+        } else if (fpp == blast_fppbf16) { // n <= 10: dot <= 220 is exact
+            *at0(bf16_t, i) = fp32tobf16((fp32_t)(i + 1));
+            *at1(bf16_t, i) = fp32tobf16((fp32_t)(n - i));
         } else {
             fatal_if("fpp", "%d", fpp);
         }
@@ -96,7 +104,7 @@ static void test_first_n(blast_t* b, int64_t n, int fpp,
 
 static void test_permutations(blast_t* b) {
     for (int n = 1; n < 7; n++) {
-        for (int fpp = blast_fpp16; fpp <= blast_fpp64; fpp++) {
+        for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
             if (b->dot[fpp] != null) {
                 for (int o0 = 0; o0 < 4; o0++) {
                     for (int o1 = 0; o1 < 4; o1++) {
@@ -110,11 +118,12 @@ static void test_permutations(blast_t* b) {
             }
         }
     }
+    // offsets 0 and 4 with unit strides are vec4 aligned (compact kernel)
     for (int n = 1; n < 11; n++) {
-        for (int fpp = blast_fpp16; fpp <= blast_fpp64; fpp++) {
+        for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
             if (b->dot[fpp] != null) {
-                for (int o0 = 0; o0 < 4; o0++) {
-                    for (int o1 = 0; o1 < 4; o1++) {
+                for (int o0 = 0; o0 < 6; o0++) {
+                    for (int o1 = 0; o1 < 6; o1++) {
                         for (int s0 = 1; s0 < 3; s0++) {
                             for (int s1 = 1; s1 < 3; s1++) {
                                 test_first_n(b, n, fpp, o0, s0, o1, s1, false);
@@ -127,6 +136,618 @@ static void test_permutations(blast_t* b) {
     }
 }
 
+static void test_set(void* a, int fpp, int64_t i, fp64_t v) {
+    switch (fpp) {
+        case blast_fpp16: ((fp16_t*)a)[i] = fp32to16((fp32_t)v); break;
+        case blast_fpp32: ((fp32_t*)a)[i] = (fp32_t)v; break;
+        case blast_fpp64: ((fp64_t*)a)[i] = v; break;
+        case blast_fppbf16: ((bf16_t*)a)[i] = fp32tobf16((fp32_t)v); break;
+        default: fatal_if("fpp", "%d", fpp);
+    }
+}
+
+static fp64_t test_get(const void* a, int fpp, int64_t i) {
+    switch (fpp) {
+        case blast_fpp16: return fp16to32(((const fp16_t*)a)[i]);
+        case blast_fpp32: return ((const fp32_t*)a)[i];
+        case blast_fpp64: return ((const fp64_t*)a)[i];
+        case blast_fppbf16: return bf16to32(((const bf16_t*)a)[i]);
+        default: fatal_if("fpp", "%d", fpp); return 0;
+    }
+}
+
+// bf16_t has 8 bits of precision: integer sums above 256 are compared
+// rounded to fpp like the results stored by the device
+
+static fp64_t test_round(int fpp, fp64_t v) {
+    fp64_t a = 0;
+    test_set(&a, fpp, 0, v);
+    return test_get(&a, fpp, 0);
+}
+
+// test_dot_batch() computes count short dot products of vectors that
+// share the same two memories and reads all results with a single map.
+
+static void test_dot_batch(blast_t* b, int fpp, int64_t count) {
+    enum { elements = 256 };
+    blast_dot_pair_t pairs[300];
+    fp64_t expected[countof(pairs)];
+    assert(1 <= count && count <= countof(pairs));
+    const int64_t offset_r = 1;
+    const int64_t bytes = elements * sizes[fpp];
+    const int64_t bytes_r = (offset_r + count) * sizes[fpp];
+    blast_memory_t m0 = blast.allocate(b, blast_access_write, bytes);
+    blast_memory_t m1 = blast.allocate(b, blast_access_write, bytes);
+    blast_memory_t r  = blast.allocate(b, blast_access_read,  bytes_r);
+    void* v0 = blast.map(&m0, blast_access_write, 0, bytes);
+    void* v1 = blast.map(&m1, blast_access_write, 0, bytes);
+    for (int64_t i = 0; i < elements; i++) {
+        test_set(v0, fpp, i, i % 7 - 3);
+        test_set(v1, fpp, i, i % 5 - 2);
+    }
+    for (int64_t k = 0; k < count; k++) {
+        blast_dot_pair_t* p = &pairs[k];
+        p->offset0 = k * 13 % 50;
+        p->stride0 = 1 + k % 3;
+        p->offset1 = k * 7 % 30;
+        p->stride1 = 1 + k % 2;
+        p->n = 1 + k * 11 % 60;
+        expected[k] = 0;
+        for (int64_t i = 0; i < p->n; i++) {
+            expected[k] += test_get(v0, fpp, p->offset0 + i * p->stride0) *
+                           test_get(v1, fpp, p->offset1 + i * p->stride1);
+        }
+    }
+    blast.unmap(&m1);
+    blast.unmap(&m0);
+    b->dot_batch[fpp](&m0, &m1, pairs, count, &r, offset_r);
+    const void* y = blast.map(&r, blast_access_read, 0, bytes_r);
+    for (int64_t k = 0; k < count; k++) {
+        const fp64_t rk = test_get(y, fpp, offset_r + k);
+        const fp64_t e = test_round(fpp, expected[k]);
+        fatal_if(rk != e, "%s count: %lld r[%lld]: %.17f expected: %.17f",
+            blast_fpp_names[fpp], count, k, rk, e);
+    }
+    blast.unmap(&r);
+    blast.deallocate(&r);
+    blast.deallocate(&m1);
+    blast.deallocate(&m0);
+}
+
+static void test_dot_batch_permutations(blast_t* b) {
+    static const int64_t counts[] = { 1, 2, 7, 300 };
+    for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+        if (b->dot_batch[fpp] != null) {
+            for (int i = 0; i < countof(counts); i++) {
+                test_dot_batch(b, fpp, counts[i]);
+            }
+        }
+    }
+}
+
+static void test_gemv(blast_t* b, int fpp, int64_t m, int64_t n,
+        int64_t om, int64_t sm, int64_t ov, int64_t sv) {
+    assert(1 <= m && m <= 16 && 1 <= n && sm >= n && sv >= 1);
+    const int64_t bytes_m = (om + m * sm) * sizes[fpp];
+    const int64_t bytes_v = (ov + n * sv) * sizes[fpp];
+    const int64_t bytes_r = m * sizes[fpp];
+    blast_memory_t mx = blast.allocate(b, blast_access_write, bytes_m);
+    blast_memory_t vc = blast.allocate(b, blast_access_write, bytes_v);
+    blast_memory_t r  = blast.allocate(b, blast_access_read,  bytes_r);
+    byte_t* a = (byte_t*)blast.map(&mx, blast_access_write, 0, bytes_m);
+    byte_t* x = (byte_t*)blast.map(&vc, blast_access_write, 0, bytes_v);
+    for (int i = 0; i < bytes_m; i++) { a[i] = (byte_t)random32(&seed); }
+    for (int i = 0; i < bytes_v; i++) { x[i] = (byte_t)random32(&seed); }
+    // small integers keep the products and sums exact even in fp16_t
+    fp64_t expected[16] = {0};
+    for (int64_t i = 0; i < m; i++) {
+        for (int64_t j = 0; j < n; j++) {
+            fp64_t mij = (fp64_t)((i * n + j) % 5 - 2);
+            fp64_t vj  = (fp64_t)(j % 3 - 1);
+            test_set(a, fpp, om + i * sm + j, mij);
+            test_set(x, fpp, ov + j * sv, vj);
+            expected[i] += mij * vj;
+        }
+    }
+    blast.unmap(&vc);
+    blast.unmap(&mx);
+    b->gemv[fpp](&mx, om, sm, &vc, ov, sv, &r, m, n);
+    const void* y = blast.map(&r, blast_access_read, 0, bytes_r);
+    for (int64_t i = 0; i < m; i++) {
+        fp64_t ri = test_get(y, fpp, i);
+        expected[i] = test_round(fpp, expected[i]);
+        fatal_if(ri != expected[i], "%s m: %lld n: %lld [o:%lld s:%lld] "
+            "[o:%lld s:%lld] r[%lld]: %.17f expected: %.17f",
+            blast_fpp_names[fpp], m, n, om, sm, ov, sv, i, ri, expected[i]);
+    }
+    blast.unmap(&r);
+    blast.deallocate(&r);
+    blast.deallocate(&vc);
+    blast.deallocate(&mx);
+}
+
+static void test_gemv_permutations(blast_t* b) {
+    static const int64_t ms[] = { 1, 3, 7, 16 };
+    static const int64_t ns[] = { 1, 4, 5, 17, 64, 259 };
+    for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+        if (b->gemv[fpp] != null) {
+            for (int i = 0; i < countof(ms); i++) {
+                for (int j = 0; j < countof(ns); j++) {
+                    const int64_t m = ms[i];
+                    const int64_t n = ns[j];
+                    for (int64_t om = 0; om < 4; om += 3) {
+                        for (int64_t sm = n; sm < n + 3; sm += 2) {
+                            for (int64_t ov = 0; ov < 2; ov++) {
+                                for (int64_t sv = 1; sv < 4; sv += 2) {
+                                    test_gemv(b, fpp, m, n, om, sm, ov, sv);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// test_gemv_variants() runs test_gemv_permutations() with each gemv()
+// kernel variant forced for all shape classes (see blast_gemv_select()).
+
+static void test_gemv_variants(blast_t* b) {
+    const blast_crossover_t saved = b->crossover;
+    for (int v = blast_gemv_wg; v <= blast_gemv_item16; v++) {
+        for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+            for (int k = 0; k < countof(b->crossover.gemv_variant[fpp]); k++) {
+                b->crossover.gemv_variant[fpp][k] = v;
+            }
+        }
+        test_gemv_permutations(b);
+    }
+    b->crossover = saved;
+}
+
+static void test_gemv_batch(blast_t* b, int fpp, int64_t m, int64_t n,
+        int64_t k, bool interleaved) {
+    assert(1 <= m && m <= 16 && 1 <= n && 1 <= k && k <= blast_batch_max);
+    const int64_t om = 1, sm = n + 1, ov = 2, sr = m + 3;
+    // V[n][k] or k consecutive vectors of n elements each:
+    const int64_t sv = interleaved ? k : 1;
+    const int64_t sb = interleaved ? 1 : n;
+    const int64_t bytes_m = (om + m * sm) * sizes[fpp];
+    const int64_t bytes_v = (ov + n * k) * sizes[fpp];
+    const int64_t bytes_r = k * sr * sizes[fpp];
+    blast_memory_t mx = blast.allocate(b, blast_access_write, bytes_m);
+    blast_memory_t vc = blast.allocate(b, blast_access_write, bytes_v);
+    blast_memory_t r  = blast.allocate(b, blast_access_read,  bytes_r);
+    void* a = blast.map(&mx, blast_access_write, 0, bytes_m);
+    void* x = blast.map(&vc, blast_access_write, 0, bytes_v);
+    for (int64_t i = 0; i < m; i++) {
+        for (int64_t j = 0; j < n; j++) {
+            test_set(a, fpp, om + i * sm + j, (fp64_t)((i * n + j) % 5 - 2));
+        }
+    }
+    for (int64_t v = 0; v < k; v++) {
+        for (int64_t j = 0; j < n; j++) {
+            test_set(x, fpp, ov + j * sv + v * sb, (fp64_t)((j + v) % 3 - 1));
+        }
+    }
+    blast.unmap(&vc);
+    blast.unmap(&mx);
+    b->gemv_batch[fpp](&mx, om, sm, &vc, ov, sv, sb, &r, sr, m, n, k);
+    const void* y = blast.map(&r, blast_access_read, 0, bytes_r);
+    for (int64_t v = 0; v < k; v++) {
+        for (int64_t i = 0; i < m; i++) {
+            // small integers keep the products and sums exact even in fp16_t
+            fp64_t e = 0;
+            for (int64_t j = 0; j < n; j++) {
+                e += (fp64_t)((i * n + j) % 5 - 2) * (fp64_t)((j + v) % 3 - 1);
+            }
+            fp64_t ri = test_get(y, fpp, v * sr + i);
+            e = test_round(fpp, e);
+            fatal_if(ri != e, "%s m: %lld n: %lld k: %lld r[%lld][%lld]: %.17f "
+                "expected: %.17f", blast_fpp_names[fpp], m, n, k, v, i, ri, e);
+        }
+    }
+    blast.unmap(&r);
+    blast.deallocate(&r);
+    blast.deallocate(&vc);
+    blast.deallocate(&mx);
+}
+
+static void test_gemv_batch_permutations(blast_t* b) {
+    static const int64_t ms[] = { 1, 3, 16 };
+    static const int64_t ns[] = { 1, 5, 17, 259 };
+    static const int64_t ks[] = { 1, 2, 7, blast_batch_max };
+    for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+        if (b->gemv_batch[fpp] != null) {
+            for (int i = 0; i < countof(ms); i++) {
+                for (int j = 0; j < countof(ns); j++) {
+                    for (int v = 0; v < countof(ks); v++) {
+                        test_gemv_batch(b, fpp, ms[i], ns[j], ks[v], false);
+                        test_gemv_batch(b, fpp, ms[i], ns[j], ks[v], true);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void test_gemv_q(blast_t* b, int format, int fpp, int64_t m,
+        int64_t n, int64_t sv) {
+    const int64_t block = blast_format_block[format];
+    assert(1 <= m && m <= 16 && n % block == 0 && sv >= 1);
+    const int64_t om = block, sm = n + block, ov = 1;
+    const int64_t blocks = (om + m * sm) / block;
+    const int64_t bytes_m = blocks * blast_format_bytes[format];
+    const int64_t bytes_v = (ov + n * sv) * sizes[fpp];
+    const int64_t bytes_r = m * sizes[fpp];
+    blast_memory_t mx = blast.allocate(b, blast_access_write, bytes_m);
+    blast_memory_t vc = blast.allocate(b, blast_access_write, bytes_v);
+    blast_memory_t r  = blast.allocate(b, blast_access_read,  bytes_r);
+    q8_t* q8 = (q8_t*)blast.map(&mx, blast_access_write, 0, bytes_m);
+    q4_t* q4 = (q4_t*)q8;
+    void* x = blast.map(&vc, blast_access_write, 0, bytes_v);
+    for (int64_t j = 0; j < n; j++) { test_set(x, fpp, ov + j * sv, j % 3 - 1); }
+    // small integer quants with scales 1 and 2 (and fp8 halves) keep
+    // results exact in fp16_t
+    fp64_t expected[16] = {0};
+    if (block == 1) { // fp8
+        uint8_t* f8 = (uint8_t*)q8;
+        for (int64_t i = 0; i < m; i++) {
+            for (int64_t j = 0; j < n; j++) {
+                const fp32_t w = (fp32_t)((i + j) % 9 - 4) / 2;
+                f8[om + i * sm + j] = format == blast_format_e4m3 ?
+                    fp32toe4m3(w).bytes : fp32toe5m2(w).bytes;
+                expected[i] += w * test_get(x, fpp, ov + j * sv);
+            }
+        }
+    } else {
+        for (int64_t i = 0; i < m; i++) {
+            for (int64_t k = 0; k < n / quant_block; k++) {
+                const int64_t bk = (om + i * sm) / quant_block + k;
+                const fp32_t d = (fp32_t)(k % 2 + 1);
+                fp32_t w[quant_block];
+                if (format == blast_format_q8) {
+                    q8[bk].d = fp32to16(d);
+                    for (int e = 0; e < quant_block; e++) {
+                        q8[bk].q[e] = (int8_t)((i * 7 + k + e) % 5 - 2);
+                        w[e] = d * q8[bk].q[e];
+                    }
+                } else {
+                    q4[bk].d = fp32to16(d);
+                    q4[bk].m = fp32to16(-1);
+                    for (int e = 0; e < quant_block / 2; e++) {
+                        const int q0 = (int)((i + k + e) % 3);
+                        const int q1 = (int)((i + e) % 4);
+                        q4[bk].q[e] = (uint8_t)(q0 | (q1 << 4));
+                        w[e] = d * q0 - 1;
+                        w[e + quant_block / 2] = d * q1 - 1;
+                    }
+                }
+                for (int e = 0; e < quant_block; e++) {
+                    const int64_t j = k * quant_block + e;
+                    expected[i] += w[e] * test_get(x, fpp, ov + j * sv);
+                }
+            }
+        }
+    }
+    blast.unmap(&vc);
+    blast.unmap(&mx);
+    b->gemv_q[format][fpp](&mx, om, sm, &vc, ov, sv, &r, m, n);
+    const void* y = blast.map(&r, blast_access_read, 0, bytes_r);
+    for (int64_t i = 0; i < m; i++) {
+        fp64_t ri = test_get(y, fpp, i);
+        expected[i] = test_round(fpp, expected[i]);
+        fatal_if(ri != expected[i], "%s %s m: %lld n: %lld sv: %lld "
+            "r[%lld]: %.17f expected: %.17f", blast_format_names[format],
+            blast_fpp_names[fpp], m, n, sv, i, ri, expected[i]);
+    }
+    blast.unmap(&r);
+    blast.deallocate(&r);
+    blast.deallocate(&vc);
+    blast.deallocate(&mx);
+}
+
+static void test_gemv_q_permutations(blast_t* b) {
+    static const int64_t ms[] = { 1, 3, 16 };
+    static const int64_t ns[] = { 32, 96, 320 };
+    for (int format = blast_format_q8; format <= blast_format_e5m2; format++) {
+        // fp8 rows are not blocked and can have any length:
+        const int64_t odd = blast_format_block[format] == 1 ? 1 : 0;
+        for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+            if (b->gemv_q[format][fpp] != null) {
+                for (int i = 0; i < countof(ms); i++) {
+                    for (int j = 0; j < countof(ns); j++) {
+                        for (int64_t sv = 1; sv < 3; sv++) {
+                            test_gemv_q(b, format, fpp, ms[i], ns[j] + odd, sv);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// test_gemv_q_short_vector() passes gemv_q() a vector one element short
+// of n. fatal_if() terminates the process and must not let it return, so
+// it runs in a child process started by test_gemv_q_bounds().
+
+static const char* test_short_vector = "gemv_q_short_vector";
+
+static void test_gemv_q_short_vector(void) {
+    ocl_context_t c = ocl.open(0, null);
+    blast_t b = { 0 };
+    blast.init(&b, &c);
+    const int format = blast_format_q8;
+    const int fpp = blast_fpp32;
+    const int64_t m = 1, n = quant_block;
+    blast_memory_t mx = blast.allocate(&b, blast_access_write,
+        blast_format_bytes[format]);
+    blast_memory_t vc = blast.allocate(&b, blast_access_write,
+        (n - 1) * sizes[fpp]);
+    blast_memory_t r  = blast.allocate(&b, blast_access_read, m * sizes[fpp]);
+    b.gemv_q[format][fpp](&mx, 0, n, &vc, 0, 1, &r, m, n);
+    ocl.finish(&c);
+    blast.deallocate(&r);
+    blast.deallocate(&vc);
+    blast.deallocate(&mx);
+    blast.fini(&b);
+    ocl.close(&c);
+}
+
+static void test_gemv_q_bounds(const char* self) {
+    if (ocl.count > 0) {
+        intptr_t exit_code = _spawnl(_P_WAIT, self, self,
+            test_short_vector, null);
+        fatal_if(exit_code == 0, "gemv_q() accepted short vector");
+    }
+}
+
+// test_level1() runs copy, axpy, scal, rot and swap on the same pair of
+// strided vectors with small dyadic values that are exact in all fpp
+// and checks that elements in between strides are left untouched.
+
+static void test_level1(blast_t* b, int fpp, int64_t n, int64_t sx, int64_t sy) {
+    enum { gap = 7 }; // untouched elements value
+    const int64_t ox = 1, oy = 3;
+    const int64_t nx = ox + n * sx, ny = oy + n * sy;
+    blast_memory_t mx = blast.allocate(b, blast_access_rw, nx * sizes[fpp]);
+    blast_memory_t my = blast.allocate(b, blast_access_rw, ny * sizes[fpp]);
+    fp64_t ex[1024]; // expected
+    fp64_t ey[1024];
+    assert(1 <= n && n <= countof(ex) && sx >= 1 && sy >= 1);
+    void* x = blast.map(&mx, blast_access_write, 0, nx * sizes[fpp]);
+    void* y = blast.map(&my, blast_access_write, 0, ny * sizes[fpp]);
+    for (int64_t i = 0; i < nx; i++) { test_set(x, fpp, i, gap); }
+    for (int64_t i = 0; i < ny; i++) { test_set(y, fpp, i, gap); }
+    for (int64_t i = 0; i < n; i++) {
+        ex[i] = (fp64_t)(i % 7 - 3) / 2;
+        ey[i] = (fp64_t)(i % 5 - 2);
+        test_set(x, fpp, ox + i * sx, ex[i]);
+        test_set(y, fpp, oy + i * sy, ey[i]);
+    }
+    blast.unmap(&my);
+    blast.unmap(&mx);
+    b->copy[fpp](&mx, ox, sx, &my, oy, sy, n);
+    for (int64_t i = 0; i < n; i++) { ey[i] = ex[i]; }
+    b->axpy[fpp](2, &mx, ox, sx, &my, oy, sy, n);
+    for (int64_t i = 0; i < n; i++) { ey[i] = 2 * ex[i] + ey[i]; }
+    b->scal[fpp](-0.5, &mx, ox, sx, n);
+    for (int64_t i = 0; i < n; i++) { ex[i] = -0.5 * ex[i]; }
+    b->rot[fpp](0.5, 0.25, &mx, ox, sx, &my, oy, sy, n);
+    for (int64_t i = 0; i < n; i++) {
+        const fp64_t xi = ex[i], yi = ey[i];
+        ex[i] = 0.5 * xi + 0.25 * yi;
+        ey[i] = 0.5 * yi - 0.25 * xi;
+    }
+    b->swap[fpp](&mx, ox, sx, &my, oy, sy, n);
+    for (int64_t i = 0; i < n; i++) {
+        const fp64_t t = ex[i]; ex[i] = ey[i]; ey[i] = t;
+    }
+    x = blast.map(&mx, blast_access_read, 0, nx * sizes[fpp]);
+    y = blast.map(&my, blast_access_read, 0, ny * sizes[fpp]);
+    for (int64_t i = 0; i < nx; i++) {
+        const bool element = i >= ox && (i - ox) % sx == 0;
+        const fp64_t e = element ? test_round(fpp, ex[(i - ox) / sx]) : gap;
+        fatal_if(test_get(x, fpp, i) != e, "%s n: %lld sx: %lld "
+            "x[%lld]: %.17f expected: %.17f", blast_fpp_names[fpp],
+            n, sx, i, test_get(x, fpp, i), e);
+    }
+    for (int64_t i = 0; i < ny; i++) {
+        const bool element = i >= oy && (i - oy) % sy == 0;
+        const fp64_t e = element ? test_round(fpp, ey[(i - oy) / sy]) : gap;
+        fatal_if(test_get(y, fpp, i) != e, "%s n: %lld sy: %lld "
+            "y[%lld]: %.17f expected: %.17f", blast_fpp_names[fpp],
+            n, sy, i, test_get(y, fpp, i), e);
+    }
+    blast.unmap(&my);
+    blast.unmap(&mx);
+    blast.deallocate(&my);
+    blast.deallocate(&mx);
+}
+
+static void test_level1_permutations(blast_t* b) {
+    static const int64_t ns[] = { 1, 3, 4, 7, 64, 1023 };
+    for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+        if (b->axpy[fpp] != null) {
+            for (int i = 0; i < countof(ns); i++) {
+                test_level1(b, fpp, ns[i], 1, 1); // compact
+                test_level1(b, fpp, ns[i], 2, 1);
+                test_level1(b, fpp, ns[i], 1, 3);
+            }
+        }
+    }
+}
+
+// test_reduce() stores all reductions of the same strided vector into
+// a single result memory (and iamax(), iamin() into another) and maps
+// each of them once.
+
+static void test_reduce(blast_t* b, int fpp, int64_t n, int64_t sx) {
+    const int64_t ox = 2, nx = ox + n * sx;
+    blast_memory_t mx = blast.allocate(b, blast_access_write, nx * sizes[fpp]);
+    blast_memory_t mr = blast.allocate(b, blast_access_rw, 3 * sizes[fpp]);
+    blast_memory_t mk = blast.allocate(b, blast_access_rw, 2 * sizeof(int32_t));
+    void* x = blast.map(&mx, blast_access_write, 0, nx * sizes[fpp]);
+    fp64_t sum = 0, asum = 0, ssq = 0;
+    int64_t imax = 0, imin = 0;
+    for (int64_t i = 0; i < n; i++) {
+        const fp64_t v = i == n / 2 ? 3 : (fp64_t)((i * 7) % 11 - 5) / 4;
+        test_set(x, fpp, ox + i * sx, v);
+        sum += v;
+        asum += fabs(v);
+        ssq += v * v;
+        if (fabs(v) > fabs(test_get(x, fpp, ox + imax * sx))) { imax = i; }
+        if (fabs(v) < fabs(test_get(x, fpp, ox + imin * sx))) { imin = i; }
+    }
+    blast.unmap(&mx);
+    b->sum[fpp](&mx, ox, sx, n, &mr, 0);
+    b->asum[fpp](&mx, ox, sx, n, &mr, 1);
+    b->nrm2[fpp](&mx, ox, sx, n, &mr, 2);
+    b->iamax[fpp](&mx, ox, sx, n, &mk, 0);
+    b->iamin[fpp](&mx, ox, sx, n, &mk, 1);
+    const void* r = blast.map(&mr, blast_access_read, 0, 3 * sizes[fpp]);
+    // sums of quarters are exact, scaled sums of squares are not:
+    const fp64_t nrm2 = sqrt(ssq);
+    const fp64_t eps = fpp == blast_fpp64 ? 1e-12 :
+                       fpp == blast_fpp32 ? 1e-5 : 1e-2;
+    fatal_if(test_get(r, fpp, 0) != test_round(fpp, sum) ||
+             test_get(r, fpp, 1) != test_round(fpp, asum) ||
+             fabs(test_get(r, fpp, 2) - nrm2) > nrm2 * eps,
+        "%s n: %lld sx: %lld sum: %.17f asum: %.17f nrm2: %.17f "
+        "expected: %.17f %.17f %.17f", blast_fpp_names[fpp], n, sx,
+        test_get(r, fpp, 0), test_get(r, fpp, 1), test_get(r, fpp, 2),
+        sum, asum, nrm2);
+    blast.unmap(&mr);
+    const int32_t* k = (const int32_t*)blast.map(&mk, blast_access_read, 0,
+        2 * sizeof(int32_t));
+    fatal_if(k[0] != imax || k[1] != imin, "%s n: %lld sx: %lld "
+        "iamax: %d iamin: %d expected: %lld %lld", blast_fpp_names[fpp],
+        n, sx, k[0], k[1], imax, imin);
+    blast.unmap(&mk);
+    blast.deallocate(&mk);
+    blast.deallocate(&mr);
+    blast.deallocate(&mx);
+}
+
+static void test_reduce_permutations(blast_t* b) {
+    static const int64_t ns[] = { 1, 2, 5, 64, 1023, 4097 };
+    for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+        if (b->sum[fpp] != null) {
+            for (int i = 0; i < countof(ns); i++) {
+                test_reduce(b, fpp, ns[i], 1);
+                test_reduce(b, fpp, ns[i], 3);
+            }
+        }
+    }
+}
+
+static void test_pool(blast_t* b) {
+    // both sizes fall into the same smallest size class:
+    blast_memory_t m0 = blast.allocate(b, blast_access_rw, 100);
+    void* h = m0.h;
+    blast.deallocate(&m0);
+    blast_memory_t m1 = blast.allocate(b, blast_access_rw, 200);
+    fatal_if(m1.h != h, "pool did not recycle the buffer");
+    blast.deallocate(&m1);
+}
+
+static void test_async_done(void* that) {
+    *(volatile int32_t*)that = 1;
+}
+
+static void test_async(blast_t* b) {
+    enum { n = 1024, m = 8 };
+    for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+        if (b->dot_async[fpp] == null) { continue; }
+        const int64_t bytes = n * sizes[fpp];
+        blast_memory_t v = blast.allocate(b, blast_access_write, bytes);
+        blast_memory_t r = blast.allocate(b, blast_access_read, 2 * sizes[fpp]);
+        void* a = blast.map(&v, blast_access_write, 0, bytes);
+        for (int64_t i = 0; i < n; i++) { test_set(a, fpp, i, (fp64_t)(i % 3 - 1)); }
+        blast.unmap(&v);
+        // two thirds of elements are +/-1: sum of squares is exact
+        const fp64_t expected = test_round(fpp, (fp64_t)(n - (n + 2) / 3));
+        blast_event_t e = b->dot_async[fpp](&v, 0, 1, &v, 0, 1, n, &r, 1);
+        volatile int32_t done = 0;
+        blast.then(&e, test_async_done, (void*)&done);
+        while (!blast.poll(&e)) { sleep(0.001); }
+        blast.wait(&e);
+        for (int i = 0; i < 1000 && !done; i++) { sleep(0.001); }
+        fatal_if(!done, "blast.then() callback was not called");
+        const void* y = blast.map(&r, blast_access_read, 0, 2 * sizes[fpp]);
+        fp64_t d = test_get(y, fpp, 1);
+        fatal_if(d != expected, "%s dot_async: %.17f expected: %.17f",
+            blast_fpp_names[fpp], d, expected);
+        blast.unmap(&r);
+        blast.deallocate(&r);
+        // gemv_async() of m rows of n / m columns each, row i starts at i * n / m:
+        blast_memory_t g = blast.allocate(b, blast_access_read, m * sizes[fpp]);
+        e = b->gemv_async[fpp](&v, 0, n / m, &v, 0, 1, &g, m, n / m);
+        blast.wait(&e);
+        y = blast.map(&g, blast_access_read, 0, m * sizes[fpp]);
+        for (int64_t i = 0; i < m; i++) {
+            fp64_t s = 0;
+            for (int64_t j = 0; j < n / m; j++) {
+                s += (fp64_t)(((i * (n / m) + j) % 3 - 1) * (j % 3 - 1));
+            }
+            fp64_t gi = test_get(y, fpp, i);
+            s = test_round(fpp, s);
+            fatal_if(gi != s, "%s gemv_async r[%lld]: %.17f expected: %.17f",
+                blast_fpp_names[fpp], i, gi, s);
+        }
+        blast.unmap(&g);
+        blast.deallocate(&g);
+        blast.deallocate(&v);
+    }
+}
+
+static void test_auto(blast_t* b) {
+    enum { n = 300, m = 6 };
+    const blast_crossover_t crossover = b->crossover;
+    for (int fpp = blast_fpp16; fpp <= blast_fppbf16; fpp++) {
+        const int64_t bytes = n * sizes[fpp];
+        blast_memory_t v = blast.allocate(b, blast_access_rw, bytes);
+        blast_memory_t r = blast.allocate(b, blast_access_rw, m * sizes[fpp]);
+        void* a = blast.map(&v, blast_access_write, 0, bytes);
+        for (int64_t i = 0; i < n; i++) { test_set(a, fpp, i, (fp64_t)(i % 5 - 2)); }
+        blast.unmap(&v);
+        fp64_t expected = 0; // v[0..n/2 - 1] . v[n/2..n - 1]
+        for (int64_t i = 0; i < n / 2; i++) {
+            expected += (fp64_t)((i % 5 - 2) * ((i + n / 2) % 5 - 2));
+        }
+        expected = test_round(fpp, expected);
+        // 0: host, 1: device (if present), 2: host with caller mapped memory
+        for (int route = 0; route < 3; route++) {
+            const int64_t x = route == 1 ? 0 : INT64_MAX;
+            b->crossover.dot[fpp]  = x;
+            b->crossover.gemv[fpp] = x;
+            if (route == 2) { blast.map(&v, blast_access_read, 0, bytes); }
+            fp64_t d = b->dot_auto[fpp](&v, 0, 1, &v, n / 2, 1, n / 2);
+            fatal_if(d != expected, "%s route %d dot_auto: %.17f expected: %.17f",
+                blast_fpp_names[fpp], route, d, expected);
+            if (route == 2) { blast.unmap(&v); }
+            // m rows of n / m columns times the first n / m elements:
+            b->gemv_auto[fpp](&v, 0, n / m, &v, 0, 1, &r, m, n / m);
+            const void* y = blast.map(&r, blast_access_read, 0, m * sizes[fpp]);
+            for (int64_t i = 0; i < m; i++) {
+                fp64_t s = 0;
+                for (int64_t j = 0; j < n / m; j++) {
+                    s += (fp64_t)(((i * (n / m) + j) % 5 - 2) * (j % 5 - 2));
+                }
+                fp64_t gi = test_get(y, fpp, i);
+                s = test_round(fpp, s);
+                fatal_if(gi != s, "%s route %d gemv_auto r[%lld]: %.17f "
+                    "expected: %.17f", blast_fpp_names[fpp], route, i, gi, s);
+            }
+            blast.unmap(&r);
+        }
+        blast.deallocate(&r);
+        blast.deallocate(&v);
+    }
+    b->crossover = crossover;
+}
+
 static void test_performance(blast_t* b, const int32_t n) {
     const int64_t bytes = n * sizeof(fp32_t);
     blast_memory_t m0 = blast.allocate(b, blast_access_write, bytes);
@@ -188,7 +809,11 @@ static void test_dot_compare_gpu_avx(blast_t* b) {
 }
 
 static void dot_tests() {
+    fp16_n_test();
     dot_test();
+    gemv_test();
+    quant_test();
+    blas1_test();
     for (int d = 0; d < ocl.count; d++) {
 //      ocl.dump(i);
         static ocl_override_t ov[2] = {
@@ -199,7 +824,16 @@ static void dot_tests() {
             ocl_context_t c = ocl.open(d, &ov[i]);
             blast_t b = { 0 };
             blast.init(&b, &c);
+            test_pool(&b);
             test_permutations(&b);
+            test_dot_batch_permutations(&b);
+            test_gemv_variants(&b);
+            test_gemv_batch_permutations(&b);
+            test_gemv_q_permutations(&b);
+            test_level1_permutations(&b);
+            test_reduce_permutations(&b);
+            test_async(&b);
+            test_auto(&b);
             blast.fini(&b);
             ocl.close(&c);
         }
@@ -242,9 +876,13 @@ static void dot_tests() {
 }
 
 int32_t main(int32_t argc, const char* argv[]) {
-    (void)argc; (void)argv;
     ocl.init();
+    if (argc > 1 && strcmp(argv[1], test_short_vector) == 0) {
+        test_gemv_q_short_vector();
+        return 0; // not reached unless gemv_q() misses the bounds check
+    }
     dot_tests();
+    test_gemv_q_bounds(argv[0]);
     return 0;
 }
 
@@ -0,0 +1,109 @@
+#include "workers.h"
+#include <threads.h>
+
+typedef struct workers_pool_s {
+    thrd_t  thread[workers_max];
+    int32_t threads; // number of started worker threads
+    mtx_t   serial;  // serializes run() calls
+    mtx_t   lock;    // protects everything below
+    cnd_t   wake;    // work available or quit
+    cnd_t   done;    // all jobs of the current run() finished
+    void  (*job)(void* that, int32_t i);
+    void*   that;
+    int32_t n;
+    int32_t next;     // next job index to take
+    int32_t finished; // number of jobs returned
+    bool    quit;
+} workers_pool_t;
+
+static workers_pool_t workers_pool;
+
+// takes and runs jobs until none left, called with lock held
+static void workers_drain(workers_pool_t* p) {
+    while (p->next < p->n) {
+        int32_t i = p->next++;
+        mtx_unlock(&p->lock);
+        p->job(p->that, i);
+        mtx_lock(&p->lock);
+        p->finished++;
+        if (p->finished == p->n) { cnd_broadcast(&p->done); }
+    }
+}
+
+static int workers_thread(void* that) {
+    workers_pool_t* p = (workers_pool_t*)that;
+    mtx_lock(&p->lock);
+    while (!p->quit) {
+        workers_drain(p);
+        if (!p->quit) { cnd_wait(&p->wake, &p->lock); }
+    }
+    mtx_unlock(&p->lock);
+    return 0;
+}
+
+static void workers_init(void) {
+    workers_pool_t* p = &workers_pool;
+    static bool init;
+    if (!init) {
+        init = true;
+        fatal_if(mtx_init(&p->serial, mtx_plain) != thrd_success);
+        fatal_if(mtx_init(&p->lock, mtx_plain) != thrd_success);
+        fatal_if(cnd_init(&p->wake) != thrd_success);
+        fatal_if(cnd_init(&p->done) != thrd_success);
+        int32_t threads = min(cpu_count() - 1, workers_max);
+        for (int32_t i = 0; i < threads; i++) {
+            fatal_if(thrd_create(&p->thread[i], workers_thread, p) !=
+                     thrd_success);
+            p->threads++;
+        }
+    }
+}
+
+static int32_t workers_count(void) {
+    workers_init();
+    return workers_pool.threads + 1;
+}
+
+static void workers_run(void (*job)(void* that, int32_t i), void* that,
+        int32_t n) {
+    workers_init();
+    workers_pool_t* p = &workers_pool;
+    if (n <= 1 || p->threads == 0) {
+        for (int32_t i = 0; i < n; i++) { job(that, i); }
+    } else {
+        mtx_lock(&p->serial);
+        mtx_lock(&p->lock);
+        p->job = job;
+        p->that = that;
+        p->n = n;
+        p->next = 0;
+        p->finished = 0;
+        cnd_broadcast(&p->wake);
+        workers_drain(p); // calling thread works too
+        while (p->finished < p->n) { cnd_wait(&p->done, &p->lock); }
+        p->n = 0;
+        mtx_unlock(&p->lock);
+        mtx_unlock(&p->serial);
+    }
+}
+
+static void workers_fini(void) {
+    workers_pool_t* p = &workers_pool;
+    if (p->threads > 0) {
+        mtx_lock(&p->lock);
+        p->quit = true;
+        cnd_broadcast(&p->wake);
+        mtx_unlock(&p->lock);
+        for (int32_t i = 0; i < p->threads; i++) {
+            thrd_join(p->thread[i], null);
+        }
+        p->threads = 0;
+    }
+}
+
+workers_if workers = {
+    .init  = workers_init,
+    .count = workers_count,
+    .run   = workers_run,
+    .fini  = workers_fini
+};
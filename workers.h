@@ -0,0 +1,27 @@
+#pragma once
+#include "rt.h"
+
+#ifdef cplusplus
+extern "C" {
+#endif
+
+// Persistent pool of worker threads started once by workers.init().
+// run() calls job(that, i) for every i in [0..n) distributing calls
+// over the workers and the calling thread and returns when all calls
+// have returned. Calls to run() from different threads are serialized;
+// run() must not be called from inside a job.
+
+enum { workers_max = 64 };
+
+typedef struct workers_if {
+    void (*init)(void); // cpu_count() - 1 workers, idempotent
+    int32_t (*count)(void); // number of threads including the caller
+    void (*run)(void (*job)(void* that, int32_t i), void* that, int32_t n);
+    void (*fini)(void);
+} workers_if;
+
+extern workers_if workers;
+
+#ifdef cplusplus
+} // extern "C"
+#endif